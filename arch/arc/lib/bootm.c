@@ -72,6 +72,7 @@ static void boot_jump_linux(bootm_headers_t *images, int flag)
 	printf("\nStarting kernel ...%s\n\n", fake ?
 	       "(fake run for tracing)" : "");
 	bootstage_mark_name(BOOTSTAGE_ID_BOOTM_HANDOFF, "start_kernel");
+	serial_flush();
 
 	cleanup_before_linux();
 
@@ -0,0 +1,55 @@
+/*
+ * Glue for the ARMv8 Crypto Extensions SHA-1 and SHA-256 block functions
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+
+/* ID_AA64ISAR0_EL1 fields */
+#define ISAR0_SHA1_SHIFT	8
+#define ISAR0_SHA2_SHIFT	12
+
+void sha1_ce_transform(uint32_t state[5], const uint8_t *data,
+		       unsigned int blocks);
+void sha256_ce_transform(uint32_t state[8], const uint8_t *data,
+			 unsigned int blocks);
+
+/* The SHA instructions are optional, so check what this CPU implements */
+static int sha_ce_supported(int shift)
+{
+	uint64_t isar0;
+
+	asm("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> shift) & 0xf;
+}
+
+#ifdef CONFIG_SHA1
+int sha1_arch_process(uint32_t state[5], const uint8_t *data,
+		      unsigned int blocks)
+{
+	if (!sha_ce_supported(ISAR0_SHA1_SHIFT))
+		return -ENOSYS;
+
+	sha1_ce_transform(state, data, blocks);
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_SHA256
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks)
+{
+	if (!sha_ce_supported(ISAR0_SHA2_SHIFT))
+		return -ENOSYS;
+
+	sha256_ce_transform(state, data, blocks);
+
+	return 0;
+}
+#endif
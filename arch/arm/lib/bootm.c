@@ -80,6 +80,7 @@ static void announce_and_cleanup(int fake)
 #ifdef CONFIG_BOOTSTAGE_REPORT
 	bootstage_report();
 #endif
+	serial_flush();
 
 #ifdef CONFIG_USB_DEVICE
 	udc_disconnect();
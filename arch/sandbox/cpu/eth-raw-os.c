@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <arpa/inet.h>
@@ -234,6 +235,42 @@ int sandbox_eth_raw_os_recv(void *packet, int *length,
 	return -errno;
 }
 
+int sandbox_eth_raw_os_recv_split(void *packet, int hdr_len, void *data,
+				  int data_len, int *length,
+				  const struct eth_sandbox_raw_priv *priv)
+{
+	struct iovec iov[3];
+	struct msghdr msg;
+	int retval;
+
+	if (!priv->sd || !priv->device)
+		return -EINVAL;
+	iov[0].iov_base = packet;
+	iov[0].iov_len = hdr_len;
+	iov[1].iov_base = data;
+	iov[1].iov_len = data_len;
+	/* Anything beyond goes where it would have been in the packet */
+	iov[2].iov_base = packet + hdr_len + data_len;
+	iov[2].iov_len = hdr_len + data_len < 1536 ?
+		1536 - hdr_len - data_len : 0;
+
+	memset(&msg, '\0', sizeof(msg));
+	msg.msg_name = priv->device;
+	msg.msg_namelen = sizeof(struct sockaddr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 3;
+	retval = recvmsg(priv->sd, &msg, 0);
+	*length = 0;
+	if (retval >= 0) {
+		*length = retval;
+		return 0;
+	}
+	/* The socket is non-blocking, so expect EAGAIN when there is no data */
+	if (errno == EAGAIN)
+		return 0;
+	return -errno;
+}
+
 void sandbox_eth_raw_os_stop(struct eth_sandbox_raw_priv *priv)
 {
 	free(priv->device);
@@ -35,6 +35,24 @@ int sandbox_eth_raw_os_send(void *packet, int length,
 			    struct eth_sandbox_raw_priv *priv);
 int sandbox_eth_raw_os_recv(void *packet, int *length,
 			    const struct eth_sandbox_raw_priv *priv);
+/**
+ * sandbox_eth_raw_os_recv_split() - Receive a packet in two pieces
+ *
+ * The first @hdr_len bytes go to @packet and up to @data_len bytes after
+ * that to @data. Anything left over goes to @packet at the offset it
+ * would have had if the whole packet had been received there.
+ *
+ * @packet:	Packet buffer, at least 1536 bytes
+ * @hdr_len:	Number of bytes to put at the start of @packet
+ * @data:	Buffer for the bytes which follow
+ * @data_len:	Size of @data
+ * @length:	Returns the total number of bytes received, 0 if none
+ * @priv:	Raw socket session
+ * @return 0 if OK, -ve on error
+ */
+int sandbox_eth_raw_os_recv_split(void *packet, int hdr_len, void *data,
+				  int data_len, int *length,
+				  const struct eth_sandbox_raw_priv *priv);
 void sandbox_eth_raw_os_stop(struct eth_sandbox_raw_priv *priv);
 
 #endif /* __ETH_RAW_OS_H */
@@ -14,4 +14,10 @@ void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+void sandbox_eth_tftp_serve(int size, ulong bad_block);
+
+u8 sandbox_eth_tftp_byte(ulong offset);
+
+int sandbox_eth_tftp_placed(void);
+
 #endif /* __ETH_H */
@@ -86,4 +86,34 @@ long sandbox_i2c_rtc_set_offset(struct udevice *dev, bool use_system_time,
  */
 long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
+/**
+ * sandbox_mmc_get_stats() - get statistics on queued MMC transfers
+ *
+ * @dev:		MMC device to check
+ * @started:		Returns number of transfers started in the background
+ * @prepared:		Returns how many of those were prepared in advance
+ */
+void sandbox_mmc_get_stats(struct udevice *dev, int *started, int *prepared);
+
+/**
+ * sandbox_mmc_get_tuning() - get the result of tuning the MMC host
+ *
+ * @dev:		MMC device to check
+ * @tap:		Returns the sampling point the host is using
+ * @return number of times the host has been tuned
+ */
+int sandbox_mmc_get_tuning(struct udevice *dev, int *tap);
+
+/**
+ * sandbox_mmc_set_tap_window() - set the sampling points which work
+ *
+ * This takes effect at the tuned timings (SDR50 and faster). Set @first
+ * above @last to make tuning fail.
+ *
+ * @dev:		MMC device to change
+ * @first:		First working sampling point
+ * @last:		Last working sampling point
+ */
+void sandbox_mmc_set_tap_window(struct udevice *dev, int first, int last);
+
 #endif
@@ -436,6 +436,7 @@ int init_cache(void) __attribute__((weak, alias("x86_init_cache")));
 int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	printf("resetting ...\n");
+	serial_flush();
 
 	/* wait 50 ms */
 	udelay(50000);
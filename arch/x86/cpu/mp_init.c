@@ -11,7 +11,9 @@
 #include <dm.h>
 #include <errno.h>
 #include <malloc.h>
+#include <mp_job.h>
 #include <asm/atomic.h>
+#include <asm/control_regs.h>
 #include <asm/cpu.h>
 #include <asm/interrupt.h>
 #include <asm/lapic.h>
@@ -19,6 +21,7 @@
 #include <asm/msr.h>
 #include <asm/mtrr.h>
 #include <asm/processor.h>
+#include <asm/processor-flags.h>
 #include <asm/sipi.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
@@ -44,6 +47,38 @@ struct mp_flight_plan {
 
 static struct mp_flight_plan mp_info;
 
+#ifdef CONFIG_MP_JOBS
+/*
+ * Work handed out by mp_run_jobs(). Once the flight plan is done the APs
+ * wait for gen to change, then claim jobs by bumping next until none are
+ * left. Each AP bumps acked when it has finished with a batch, so the BSP
+ * knows that no AP is still looking at it before starting the next one.
+ */
+static struct mp_work {
+	struct mp_job *jobs;
+	int count;
+	atomic_t next;		/* index of the next unclaimed job */
+	atomic_t done;		/* number of jobs completed */
+	atomic_t acked;		/* number of APs finished with this batch */
+	atomic_t gen;		/* incremented for each new batch */
+	atomic_t idle_aps;	/* number of APs waiting for work */
+	atomic_t parked;	/* number of APs stopped by mp_park_aps() */
+	int stop;		/* set with gen to make the APs stop for good */
+	int num_aps;		/* APs taking part, set once they are all idle */
+} mp_work;
+
+/*
+ * What the boot CPU looks like to code which only checks its features once,
+ * such as sha_ni_usable(). APs only take jobs if they match.
+ */
+static struct mp_cpu_state {
+	unsigned long cr4_sse;	/* CR4.OSFXSR/OSXMMEXCPT of the boot CPU */
+	unsigned int ecx1;	/* CPUID leaf 1 ECX */
+	unsigned int edx1;	/* CPUID leaf 1 EDX */
+	unsigned int ebx7;	/* CPUID leaf 7 EBX, or 0 */
+} mp_bsp_state;
+#endif
+
 struct cpu_map {
 	struct udevice *dev;
 	int apic_id;
@@ -70,6 +105,95 @@ static inline void stop_this_cpu(void)
 		cpu_hlt();
 }
 
+#ifdef CONFIG_MP_JOBS
+static void mp_get_cpu_state(struct mp_cpu_state *state)
+{
+	state->cr4_sse = read_cr4() & (X86_CR4_OSFXSR | X86_CR4_OSXMMEXCPT);
+	state->ecx1 = cpuid_ecx(1);
+	state->edx1 = cpuid_edx(1);
+	state->ebx7 = cpuid_eax(0) >= 7 ? cpuid_ext(7, 0).ebx : 0;
+}
+
+/*
+ * Set up SSE on an AP as it is on the boot CPU, since jobs may use it (e.g.
+ * SHA-NI or PCLMULQDQ). sipi_vector.S leaves CR4 clear. Returns 0 if the AP
+ * can run the same code as the boot CPU, -ENODEV if not.
+ */
+static int ap_setup_cpu_state(void)
+{
+	struct mp_cpu_state state;
+
+	mp_get_cpu_state(&state);
+	if (state.ecx1 != mp_bsp_state.ecx1 ||
+	    state.edx1 != mp_bsp_state.edx1 ||
+	    state.ebx7 != mp_bsp_state.ebx7)
+		return -ENODEV;
+	if (mp_bsp_state.cr4_sse)
+		write_cr4(read_cr4() | mp_bsp_state.cr4_sse);
+
+	return 0;
+}
+
+/* Run jobs from the current batch until there are none left */
+static void mp_work_claim_jobs(void)
+{
+	struct mp_job *job;
+	int i;
+
+	while ((i = atomic_inc_return(&mp_work.next) - 1) < mp_work.count) {
+		job = &mp_work.jobs[i];
+		job->ret = job->func(job->arg);
+		atomic_inc(&mp_work.done);
+	}
+}
+
+static void ap_wait_for_jobs(void)
+{
+	int gen = atomic_read(&mp_work.gen);
+
+	atomic_inc(&mp_work.idle_aps);
+	for (;;) {
+		while (atomic_read(&mp_work.gen) == gen)
+			asm("pause");
+		mfence();
+		gen = atomic_read(&mp_work.gen);
+		if (mp_work.stop)
+			break;
+
+		mp_work_claim_jobs();
+		atomic_inc(&mp_work.acked);
+	}
+
+	/* Stay out of memory which the OS is about to reuse */
+	disable_interrupts();
+	atomic_inc(&mp_work.parked);
+	stop_this_cpu();
+}
+
+void mp_run_jobs(struct mp_job *jobs, int count)
+{
+	if (count < 2 || !(gd->flags & GD_FLG_RELOC) || !mp_work.num_aps) {
+		mp_run_jobs_serial(jobs, count);
+		return;
+	}
+
+	mp_work.jobs = jobs;
+	mp_work.count = count;
+	atomic_set(&mp_work.next, 0);
+	atomic_set(&mp_work.done, 0);
+	atomic_set(&mp_work.acked, 0);
+	mfence();
+	atomic_inc(&mp_work.gen);
+
+	/* Lend a hand, then wait for the APs to finish */
+	mp_work_claim_jobs();
+	while (atomic_read(&mp_work.done) != count ||
+	       atomic_read(&mp_work.acked) != mp_work.num_aps)
+		asm("pause");
+	mfence();
+}
+#endif
+
 /* Returns 1 if timeout waiting for APs. 0 if target APs found */
 static int wait_for_aps(atomic_t *val, int target, int total_delay,
 			int delay_step)
@@ -149,6 +273,14 @@ static void ap_init(unsigned int cpu_index)
 	/* Walk the flight plan */
 	ap_do_flight_plan(dev);
 
+#ifdef CONFIG_MP_JOBS
+	/* Wait for mp_run_jobs() instead of parking */
+	if (!ap_setup_cpu_state()) {
+		debug("waiting for jobs\n");
+		ap_wait_for_jobs();
+	}
+#endif
+
 	/* Park the AP */
 	debug("parking\n");
 done:
@@ -297,6 +429,46 @@ static int apic_wait_timeout(int total_delay, int delay_step)
 	return timeout;
 }
 
+#ifdef CONFIG_MP_JOBS
+void mp_park_aps(void)
+{
+	int idle = atomic_read(&mp_work.idle_aps);
+	int ret;
+
+	if (!idle || mp_work.stop)
+		return;
+
+	/* No more jobs: tell the APs to halt */
+	mp_work.num_aps = 0;
+	mp_work.count = 0;
+	mp_work.stop = 1;
+	mfence();
+	atomic_inc(&mp_work.gen);
+	ret = wait_for_aps(&mp_work.parked, idle, 10000, 50);
+
+	/*
+	 * The halt loop is in memory that the OS may reuse, and an NMI or SMI
+	 * would return there. Put the APs back into wait-for-SIPI instead, as
+	 * the OS expects to find them anyway.
+	 */
+	if (apic_wait_timeout(1000, 50)) {
+		printf("Cannot park APs: ICR busy\n");
+		return;
+	}
+	lapic_write(LAPIC_ICR2, SET_LAPIC_DEST_FIELD(0));
+	lapic_write(LAPIC_ICR, LAPIC_DEST_ALLBUT | LAPIC_INT_ASSERT |
+		    LAPIC_DM_INIT);
+	if (apic_wait_timeout(1000, 50) || ret)
+		debug("APs may not have parked: %d/%d halted\n",
+		      atomic_read(&mp_work.parked), idle);
+}
+
+void arch_park_cpus(void)
+{
+	mp_park_aps();
+}
+#endif
+
 static int start_aps(int ap_count, atomic_t *num_aps)
 {
 	int sipi_vector;
@@ -493,6 +665,10 @@ int mp_init(struct mp_params *p)
 	 */
 	wbinvd();
 
+#ifdef CONFIG_MP_JOBS
+	mp_get_cpu_state(&mp_bsp_state);
+#endif
+
 	/* Start the APs providing number of APs and the cpus_entered field */
 	num_aps = num_cpus - 1;
 	ret = start_aps(num_aps, ap_count);
@@ -510,6 +686,15 @@ int mp_init(struct mp_params *p)
 		return ret;
 	}
 
+#ifdef CONFIG_MP_JOBS
+	/* Only hand out jobs once every AP is known to be listening */
+	if (wait_for_aps(&mp_work.idle_aps, num_aps, 100000, 50))
+		debug("Only %d/%d APs waiting for jobs\n",
+		      atomic_read(&mp_work.idle_aps), num_aps);
+	else
+		mp_work.num_aps = num_aps;
+#endif
+
 	return 0;
 }
 
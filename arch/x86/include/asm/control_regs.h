@@ -57,6 +57,11 @@ static inline unsigned long read_cr4(void)
 	return val;
 }
 
+static inline void write_cr4(unsigned long val)
+{
+	asm volatile("mov %0,%%cr4\n\t" : : "r" (val) : "memory");
+}
+
 static inline unsigned long get_debugreg(int regno)
 {
 	unsigned long val = 0;  /* Damn you, gcc! */
@@ -90,4 +90,19 @@ int mp_init(struct mp_params *params);
 /* Probes the CPU device */
 int mp_init_cpu(struct udevice *cpu, void *unused);
 
+#ifdef CONFIG_MP_JOBS
+/**
+ * mp_park_aps() - Stop the APs waiting for jobs before booting an image
+ *
+ * The APs are halted and then sent an INIT IPI, so that they no longer run
+ * code or read data in U-Boot's memory. mp_run_jobs() runs jobs on the boot
+ * CPU only after this. The boot commands call it through arch_park_cpus().
+ */
+void mp_park_aps(void);
+#else
+static inline void mp_park_aps(void)
+{
+}
+#endif
+
 #endif /* _X86_MP_H_ */
@@ -45,6 +45,9 @@ void bootm_announce_and_cleanup(void)
 #ifdef CONFIG_BOOTSTAGE_REPORT
 	bootstage_report();
 #endif
+	serial_flush();
+	/* Already done by bootm, but zboot comes here directly */
+	arch_park_cpus();
 	board_final_cleanup();
 }
 
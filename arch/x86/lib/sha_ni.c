@@ -0,0 +1,325 @@
+/*
+ * SHA-1 and SHA-256 block functions using the x86 SHA extensions
+ *
+ * The instruction scheduling follows Intel's "Intel SHA Extensions" white
+ * paper (2013).
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <asm/control_regs.h>
+#include <asm/cpu.h>
+#include <asm/processor-flags.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* CPUID bits needed by this file */
+#define CPUID1_ECX_SSSE3	(1 << 9)
+#define CPUID1_ECX_SSE41	(1 << 19)
+#define CPUID7_EBX_SHA		(1 << 29)
+
+typedef int sha_v4si __attribute__((vector_size(16)));
+typedef long long sha_v2di __attribute__((vector_size(16)));
+typedef char sha_v16qi __attribute__((vector_size(16)));
+typedef short sha_v8hi __attribute__((vector_size(16)));
+typedef int sha_v4si_u __attribute__((vector_size(16), aligned(1)));
+
+#define SHA_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+
+#define PSHUFB(a, m)	((sha_v4si)__builtin_ia32_pshufb128((sha_v16qi)(a), \
+							    (sha_v16qi)(m)))
+#define PSHUFD(a, imm)	__builtin_ia32_pshufd(a, imm)
+#define PALIGNR(a, b, n) ((sha_v4si)__builtin_ia32_palignr128((sha_v2di)(a), \
+							(sha_v2di)(b), (n) * 8))
+#define PBLENDW(a, b, imm) ((sha_v4si)__builtin_ia32_pblendw128( \
+					(sha_v8hi)(a), (sha_v8hi)(b), imm))
+
+/*
+ * SSE needs CR4.OSFXSR to have been set up by whoever initialised the CPU.
+ * The CPUID result is only cached once we can write to our data section.
+ * The result also holds on the APs which run mp_run_jobs() jobs, since
+ * mp_init() only lets in APs with the same CPUID bits and CR4 set the same.
+ */
+static int sha_ni_usable(void)
+{
+	static int usable = -1;
+	struct cpuid_result leaf7;
+	unsigned int ecx1;
+	int ret = 0;
+
+	if (usable >= 0)
+		return usable;
+
+	if ((read_cr4() & X86_CR4_OSFXSR) && cpuid_eax(0) >= 7) {
+		ecx1 = cpuid_ecx(1);
+		leaf7 = cpuid_ext(7, 0);
+		ret = (ecx1 & CPUID1_ECX_SSSE3) && (ecx1 & CPUID1_ECX_SSE41) &&
+		      (leaf7.ebx & CPUID7_EBX_SHA);
+	}
+	if (gd->flags & GD_FLG_RELOC)
+		usable = ret;
+
+	return ret;
+}
+
+#ifdef CONFIG_SHA256
+static const uint32_t sha256_k[64] __aligned(16) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Four rounds using message words @m and round constants @g */
+#define SHA256_ROUNDS(g, m) do {					\
+	msg = (m) + ((const sha_v4si *)sha256_k)[g];			\
+	state1 = __builtin_ia32_sha256rnds2(state1, state0, msg);	\
+	msg = PSHUFD(msg, 0x0e);					\
+	state0 = __builtin_ia32_sha256rnds2(state0, state1, msg);	\
+} while (0)
+
+/* Finish the next message words @next from @prev and @cur */
+#define SHA256_MSG2(next, prev, cur)					\
+	next = __builtin_ia32_sha256msg2((next) + PALIGNR(cur, prev, 4), cur)
+
+#define SHA256_MSG1(prev, cur)						\
+	prev = __builtin_ia32_sha256msg1(prev, cur)
+
+SHA_TARGET
+static void sha256_ni_blocks(uint32_t state[8], const uint8_t *data,
+			     unsigned int blocks)
+{
+	const sha_v16qi mask = { 3, 2, 1, 0, 7, 6, 5, 4,
+				 11, 10, 9, 8, 15, 14, 13, 12 };
+	const sha_v4si_u *in = (const sha_v4si_u *)data;
+	sha_v4si state0, state1, save0, save1, msg, tmp;
+	sha_v4si m0, m1, m2, m3;
+
+	/* Rearrange the state into ABEF / CDGH as the instructions need */
+	tmp = PSHUFD(*(const sha_v4si_u *)&state[0], 0xb1);
+	state1 = PSHUFD(*(const sha_v4si_u *)&state[4], 0x1b);
+	state0 = PALIGNR(tmp, state1, 8);
+	state1 = PBLENDW(state1, tmp, 0xf0);
+
+	for (; blocks; blocks--, in += 4) {
+		save0 = state0;
+		save1 = state1;
+
+		m0 = PSHUFB(in[0], mask);
+		SHA256_ROUNDS(0, m0);
+		m1 = PSHUFB(in[1], mask);
+		SHA256_ROUNDS(1, m1);
+		SHA256_MSG1(m0, m1);
+		m2 = PSHUFB(in[2], mask);
+		SHA256_ROUNDS(2, m2);
+		SHA256_MSG1(m1, m2);
+		m3 = PSHUFB(in[3], mask);
+		SHA256_ROUNDS(3, m3);
+		SHA256_MSG2(m0, m2, m3);
+		SHA256_MSG1(m2, m3);
+
+		SHA256_ROUNDS(4, m0);
+		SHA256_MSG2(m1, m3, m0);
+		SHA256_MSG1(m3, m0);
+		SHA256_ROUNDS(5, m1);
+		SHA256_MSG2(m2, m0, m1);
+		SHA256_MSG1(m0, m1);
+		SHA256_ROUNDS(6, m2);
+		SHA256_MSG2(m3, m1, m2);
+		SHA256_MSG1(m1, m2);
+		SHA256_ROUNDS(7, m3);
+		SHA256_MSG2(m0, m2, m3);
+		SHA256_MSG1(m2, m3);
+
+		SHA256_ROUNDS(8, m0);
+		SHA256_MSG2(m1, m3, m0);
+		SHA256_MSG1(m3, m0);
+		SHA256_ROUNDS(9, m1);
+		SHA256_MSG2(m2, m0, m1);
+		SHA256_MSG1(m0, m1);
+		SHA256_ROUNDS(10, m2);
+		SHA256_MSG2(m3, m1, m2);
+		SHA256_MSG1(m1, m2);
+		SHA256_ROUNDS(11, m3);
+		SHA256_MSG2(m0, m2, m3);
+		SHA256_MSG1(m2, m3);
+
+		SHA256_ROUNDS(12, m0);
+		SHA256_MSG2(m1, m3, m0);
+		SHA256_MSG1(m3, m0);
+		SHA256_ROUNDS(13, m1);
+		SHA256_MSG2(m2, m0, m1);
+		SHA256_ROUNDS(14, m2);
+		SHA256_MSG2(m3, m1, m2);
+		SHA256_ROUNDS(15, m3);
+
+		state0 += save0;
+		state1 += save1;
+	}
+
+	tmp = PSHUFD(state0, 0x1b);
+	state1 = PSHUFD(state1, 0xb1);
+	*(sha_v4si_u *)&state[0] = PBLENDW(tmp, state1, 0xf0);
+	*(sha_v4si_u *)&state[4] = PALIGNR(state1, tmp, 8);
+}
+
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks)
+{
+	if (!sha_ni_usable())
+		return -ENOSYS;
+
+	sha256_ni_blocks(state, data, blocks);
+
+	return 0;
+}
+#endif /* CONFIG_SHA256 */
+
+#ifdef CONFIG_SHA1
+/*
+ * Four rounds with function @f, feeding message words @m into the E value
+ * @e and saving the current ABCD as the next E value @e_next
+ */
+#define SHA1_ROUNDS(f, e, e_next, m) do {				\
+	e = __builtin_ia32_sha1nexte(e, m);				\
+	e_next = abcd;							\
+	abcd = __builtin_ia32_sha1rnds4(abcd, e, f);			\
+} while (0)
+
+#define SHA1_MSG1(a, b)		a = __builtin_ia32_sha1msg1(a, b)
+#define SHA1_MSG2(a, b)		a = __builtin_ia32_sha1msg2(a, b)
+
+SHA_TARGET
+static void sha1_ni_blocks(uint32_t state[5], const uint8_t *data,
+			   unsigned int blocks)
+{
+	const sha_v16qi mask = { 15, 14, 13, 12, 11, 10, 9, 8,
+				 7, 6, 5, 4, 3, 2, 1, 0 };
+	const sha_v4si_u *in = (const sha_v4si_u *)data;
+	sha_v4si abcd, e0, e1, save_abcd, save_e0;
+	sha_v4si m0, m1, m2, m3;
+
+	abcd = PSHUFD(*(const sha_v4si_u *)state, 0x1b);
+	e0 = (sha_v4si){ 0, 0, 0, state[4] };
+
+	for (; blocks; blocks--, in += 4) {
+		save_abcd = abcd;
+		save_e0 = e0;
+
+		/* Rounds 0-15 also load the message */
+		m0 = PSHUFB(in[0], mask);
+		e0 += m0;
+		e1 = abcd;
+		abcd = __builtin_ia32_sha1rnds4(abcd, e0, 0);
+		m1 = PSHUFB(in[1], mask);
+		SHA1_ROUNDS(0, e1, e0, m1);
+		SHA1_MSG1(m0, m1);
+		m2 = PSHUFB(in[2], mask);
+		SHA1_ROUNDS(0, e0, e1, m2);
+		SHA1_MSG1(m1, m2);
+		m0 ^= m2;
+		m3 = PSHUFB(in[3], mask);
+		SHA1_MSG2(m0, m3);
+		SHA1_ROUNDS(0, e1, e0, m3);
+		SHA1_MSG1(m2, m3);
+		m1 ^= m3;
+
+		/* Rounds 16-63 */
+		SHA1_MSG2(m1, m0);
+		SHA1_ROUNDS(0, e0, e1, m0);
+		SHA1_MSG1(m3, m0);
+		m2 ^= m0;
+		SHA1_MSG2(m2, m1);
+		SHA1_ROUNDS(1, e1, e0, m1);
+		SHA1_MSG1(m0, m1);
+		m3 ^= m1;
+		SHA1_MSG2(m3, m2);
+		SHA1_ROUNDS(1, e0, e1, m2);
+		SHA1_MSG1(m1, m2);
+		m0 ^= m2;
+		SHA1_MSG2(m0, m3);
+		SHA1_ROUNDS(1, e1, e0, m3);
+		SHA1_MSG1(m2, m3);
+		m1 ^= m3;
+
+		SHA1_MSG2(m1, m0);
+		SHA1_ROUNDS(1, e0, e1, m0);
+		SHA1_MSG1(m3, m0);
+		m2 ^= m0;
+		SHA1_MSG2(m2, m1);
+		SHA1_ROUNDS(1, e1, e0, m1);
+		SHA1_MSG1(m0, m1);
+		m3 ^= m1;
+		SHA1_MSG2(m3, m2);
+		SHA1_ROUNDS(2, e0, e1, m2);
+		SHA1_MSG1(m1, m2);
+		m0 ^= m2;
+		SHA1_MSG2(m0, m3);
+		SHA1_ROUNDS(2, e1, e0, m3);
+		SHA1_MSG1(m2, m3);
+		m1 ^= m3;
+
+		SHA1_MSG2(m1, m0);
+		SHA1_ROUNDS(2, e0, e1, m0);
+		SHA1_MSG1(m3, m0);
+		m2 ^= m0;
+		SHA1_MSG2(m2, m1);
+		SHA1_ROUNDS(2, e1, e0, m1);
+		SHA1_MSG1(m0, m1);
+		m3 ^= m1;
+		SHA1_MSG2(m3, m2);
+		SHA1_ROUNDS(2, e0, e1, m2);
+		SHA1_MSG1(m1, m2);
+		m0 ^= m2;
+		SHA1_MSG2(m0, m3);
+		SHA1_ROUNDS(3, e1, e0, m3);
+		SHA1_MSG1(m2, m3);
+		m1 ^= m3;
+
+		/* Rounds 64-79 */
+		SHA1_MSG2(m1, m0);
+		SHA1_ROUNDS(3, e0, e1, m0);
+		SHA1_MSG1(m3, m0);
+		m2 ^= m0;
+		SHA1_MSG2(m2, m1);
+		SHA1_ROUNDS(3, e1, e0, m1);
+		m3 ^= m1;
+		SHA1_MSG2(m3, m2);
+		SHA1_ROUNDS(3, e0, e1, m2);
+		SHA1_ROUNDS(3, e1, e0, m3);
+
+		e0 = __builtin_ia32_sha1nexte(e0, save_e0);
+		abcd += save_abcd;
+	}
+
+	*(sha_v4si_u *)state = PSHUFD(abcd, 0x1b);
+	state[4] = e0[3];
+}
+
+int sha1_arch_process(uint32_t state[5], const uint8_t *data,
+		      unsigned int blocks)
+{
+	if (!sha_ni_usable())
+		return -ENOSYS;
+
+	sha1_ni_blocks(state, data, blocks);
+
+	return 0;
+}
+#endif /* CONFIG_SHA1 */
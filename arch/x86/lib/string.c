@@ -14,6 +14,41 @@
 
 typedef uint32_t op_t;
 
+#define	OP_T_THRES	8
+#define OPSIZ	(sizeof(op_t))
+
+#ifdef CONFIG_X86_ERMS_STRING
+/*
+ * With Enhanced REP MOVSB/STOSB the microcode deals with alignment and
+ * moves whole cache lines, so a single byte-sized string instruction is
+ * the fastest way to handle any length.
+ */
+void *memset(void *dstpp, int c, size_t len)
+{
+	void *dstp = dstpp;
+
+	asm volatile("cld\n"
+		     "rep stosb"
+		     : "+D" (dstp), "+c" (len)
+		     : "a" (c)
+		     : "memory");
+
+	return dstpp;
+}
+
+void *memcpy(void *dstpp, const void *srcpp, size_t len)
+{
+	void *dstp = dstpp;
+
+	asm volatile("cld\n"
+		     "rep movsb"
+		     : "+D" (dstp), "+S" (srcpp), "+c" (len)
+		     :
+		     : "memory");
+
+	return dstpp;
+}
+#else
 void *memset(void *dstpp, int c, size_t len)
 {
 	int d0;
@@ -70,9 +105,6 @@ void *memset(void *dstpp, int c, size_t len)
 	return dstpp;
 }
 
-#define	OP_T_THRES	8
-#define OPSIZ	(sizeof(op_t))
-
 #define BYTE_COPY_FWD(dst_bp, src_bp, nbytes)				  \
 do {									  \
 	int __d0;							  \
@@ -130,3 +162,41 @@ void *memcpy(void *dstpp, const void *srcpp, size_t len)
 
 	return dstpp;
 }
+#endif /* CONFIG_X86_ERMS_STRING */
+
+void *memmove(void *dstpp, const void *srcpp, size_t len)
+{
+	char *dstp = dstpp;
+	const char *srcp = srcpp;
+	int d0, d1, d2;
+
+	/* memcpy() copies forwards, which is fine unless dstp is above srcp */
+	if (dstp <= srcp || dstp >= srcp + len)
+		return memcpy(dstpp, srcpp, len);
+
+	/*
+	 * Copy backwards from the end. Fast strings only apply going
+	 * forwards, so use whole longwords where the alignment allows.
+	 */
+	if (!(((unsigned long)dstp | (unsigned long)srcp | len) % OPSIZ)) {
+		asm volatile("std\n"
+			     "rep\n"
+			     "movsl\n"
+			     "cld"
+			     : "=D" (d0), "=S" (d1), "=c" (d2)
+			     : "0" (dstp + len - OPSIZ),
+			       "1" (srcp + len - OPSIZ), "2" (len / OPSIZ)
+			     : "memory");
+	} else {
+		asm volatile("std\n"
+			     "rep\n"
+			     "movsb\n"
+			     "cld"
+			     : "=D" (d0), "=S" (d1), "=c" (d2)
+			     : "0" (dstp + len - 1), "1" (srcp + len - 1),
+			       "2" (len)
+			     : "memory");
+	}
+
+	return dstpp;
+}
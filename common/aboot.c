@@ -37,38 +37,178 @@
 #include <config.h>
 #include <common.h>
 #include <aboot.h>
+#include <errno.h>
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
 
-void write_sparse_image(block_dev_desc_t *dev_desc,
-		disk_partition_t *info, const char *part_name,
-		void *data, unsigned sz)
+/* Number of blocks written at a time for a FILL chunk */
+#define FILL_BUF_BLKS	64
+
+enum {
+	SPARSE_STREAM_FILE_HDR,		/* reading the sparse header */
+	SPARSE_STREAM_FILE_HDR_REST,	/* skipping the rest of it */
+	SPARSE_STREAM_CHUNK_HDR,	/* reading a chunk header */
+	SPARSE_STREAM_FILL_VALUE,	/* reading the value of a FILL chunk */
+	SPARSE_STREAM_RAW,		/* writing the data of a RAW chunk */
+	SPARSE_STREAM_SKIP,		/* skipping the data of a chunk */
+	SPARSE_STREAM_RAW_IMAGE,	/* writing an image which is not sparse */
+	SPARSE_STREAM_DONE,
+	SPARSE_STREAM_ERROR,
+};
+
+static int sparse_stream_fail(struct sparse_stream *s, const char *msg)
+{
+	fastboot_fail(msg);
+	s->state = SPARSE_STREAM_ERROR;
+
+	return -EIO;
+}
+
+/*
+ * Collect header bytes until there are s->hdr_need of them. Only the first
+ * sizeof(s->hdr) bytes are kept. Returns true when the header is complete.
+ */
+static bool sparse_stream_gather(struct sparse_stream *s, const uchar **datap,
+				 uint *lenp)
+{
+	uint len = min(*lenp, s->hdr_need - s->hdr_len);
+
+	if (s->hdr_len < sizeof(s->hdr))
+		memcpy(s->hdr + s->hdr_len, *datap,
+		       min_t(uint, len, sizeof(s->hdr) - s->hdr_len));
+	s->hdr_len += len;
+	*datap += len;
+	*lenp -= len;
+
+	return s->hdr_len == s->hdr_need;
+}
+
+static void sparse_stream_expect(struct sparse_stream *s, int state,
+				 uint need)
+{
+	s->state = state;
+	s->hdr_len = 0;
+	s->hdr_need = need;
+}
+
+static int sparse_stream_write_blocks(struct sparse_stream *s,
+				      const void *data, lbaint_t blkcnt)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
+
+	if (s->blk + blkcnt > s->info.start + s->info.size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_stream_fail(s,
+					  "Request would exceed partition size!");
+	}
+
+	blks = s->dev_desc->block_write(s->dev_desc->dev, s->blk, blkcnt,
+					data);
+	if (blks != blkcnt) {
+		printf("%s: Write failed " LBAFU "\n", __func__, blks);
+		return sparse_stream_fail(s, "flash write failure");
+	}
+	s->blk += blkcnt;
+	s->bytes_written += blkcnt * s->info.blksz;
+
+	return 0;
+}
+
+/*
+ * Write raw data, which may start and end part way through a block. Whole
+ * blocks are written straight from @data and the pieces either side are
+ * collected in s->blkbuf.
+ */
+static int sparse_stream_write_raw(struct sparse_stream *s, const uchar *data,
+				   uint len)
+{
+	ulong blksz = s->info.blksz;
+	lbaint_t blkcnt;
+	uint part;
+	int ret;
+
+	if (s->blkbuf_len) {
+		part = min_t(uint, len, blksz - s->blkbuf_len);
+		memcpy(s->blkbuf + s->blkbuf_len, data, part);
+		s->blkbuf_len += part;
+		data += part;
+		len -= part;
+		if (s->blkbuf_len < blksz)
+			return 0;
+		ret = sparse_stream_write_blocks(s, s->blkbuf, 1);
+		if (ret)
+			return ret;
+		s->blkbuf_len = 0;
+	}
+
+	blkcnt = len / blksz;
+	if (blkcnt) {
+		ret = sparse_stream_write_blocks(s, data, blkcnt);
+		if (ret)
+			return ret;
+		data += blkcnt * blksz;
+		len -= blkcnt * blksz;
+	}
+
+	memcpy(s->blkbuf, data, len);
+	s->blkbuf_len = len;
+
+	return 0;
+}
+
+static int sparse_stream_fill(struct sparse_stream *s, uint32_t fill_val,
+			      lbaint_t blkcnt)
+{
+	lbaint_t count;
+	uint32_t *fill_buf;
+	int ret = 0;
 	int i;
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *) data;
-
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t))
-	{
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	fill_buf = memalign(ARCH_DMA_MINALIGN,
+			    ROUNDUP(s->info.blksz * FILL_BUF_BLKS,
+				    ARCH_DMA_MINALIGN));
+	if (!fill_buf)
+		return sparse_stream_fail(s,
+					  "Malloc failed for: CHUNK_TYPE_FILL");
+
+	for (i = 0; i < s->info.blksz * FILL_BUF_BLKS / sizeof(fill_val); i++)
+		fill_buf[i] = fill_val;
+
+	for (; blkcnt && !ret; blkcnt -= count) {
+		count = min_t(lbaint_t, blkcnt, FILL_BUF_BLKS);
+		ret = sparse_stream_write_blocks(s, fill_buf, count);
+	}
+	free(fill_buf);
+
+	return ret;
+}
+
+static void sparse_stream_expect_chunk(struct sparse_stream *s)
+{
+	if (s->chunk_num == s->sparse.total_chunks)
+		s->state = SPARSE_STREAM_DONE;
+	else
+		sparse_stream_expect(s, SPARSE_STREAM_CHUNK_HDR,
+				     s->sparse.chunk_hdr_sz);
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *s)
+{
+	s->chunk_num++;
+	sparse_stream_expect_chunk(s);
+}
+
+static int sparse_stream_file_header(struct sparse_stream *s)
+{
+	sparse_header_t *sparse_header = &s->sparse;
+
+	memcpy(sparse_header, s->hdr, sizeof(*sparse_header));
+	if (!is_sparse_image(sparse_header)) {
+		/* Not sparse, so write what we have so far as it is */
+		puts("Flashing Raw Image\n");
+		s->state = SPARSE_STREAM_RAW_IMAGE;
+		return sparse_stream_write_raw(s, s->hdr, s->hdr_len);
 	}
 
 	debug("=== Sparse Image Header ===\n");
@@ -82,163 +222,210 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
 	/* verify sparse_header->blk_sz is an exact multiple of info->blksz */
-	if (sparse_header->blk_sz !=
-	    (sparse_header->blk_sz & ~(info->blksz - 1))) {
+	if (!sparse_header->blk_sz || sparse_header->blk_sz !=
+	    (sparse_header->blk_sz & ~(s->info.blksz - 1))) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		fastboot_fail("sparse image block size issue");
-		return;
+		return sparse_stream_fail(s, "sparse image block size issue");
 	}
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_stream_fail(s, "sparse image header size issue");
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk=0; chunk<sparse_header->total_chunks; chunk++)
-	{
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *) data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/* Skip the remaining bytes of a header longer than we expected */
+	if (sparse_header->file_hdr_sz > s->hdr_len) {
+		s->state = SPARSE_STREAM_FILE_HDR_REST;
+		s->hdr_need = sparse_header->file_hdr_sz;
+	} else {
+		sparse_stream_expect_chunk(s);
+	}
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t))
-		{
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+	return 0;
+}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type)
-		{
-			case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz))
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Raw");
-				return;
-			}
+static int sparse_stream_chunk_header(struct sparse_stream *s)
+{
+	chunk_header_t *chunk_header = &s->chunk;
+	unsigned int chunk_data_sz;
+	unsigned int data_sz;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	memcpy(chunk_header, s->hdr, sizeof(*chunk_header));
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
 
-			blks = dev_desc->block_write(dev_desc->dev, blk, blkcnt,
-						     data);
-			if (blks != blkcnt) {
-				printf("%s: Write failed " LBAFU "\n",
-				       __func__, blks);
-				fastboot_fail("flash write failure");
-				return;
-			}
-			blk += blkcnt;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	if (chunk_header->total_sz < s->sparse.chunk_hdr_sz)
+		return sparse_stream_fail(s, "Bogus chunk size");
+	chunk_data_sz = s->sparse.blk_sz * chunk_header->chunk_sz;
+	data_sz = chunk_header->total_sz - s->sparse.chunk_hdr_sz;
 
-			case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
-			{
-				fastboot_fail(
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (data_sz != chunk_data_sz)
+			return sparse_stream_fail(s,
+					"Bogus chunk size for chunk type Raw");
+		s->state = SPARSE_STREAM_RAW;
+		s->left = data_sz;
+		break;
+	case CHUNK_TYPE_FILL:
+		if (data_sz != sizeof(uint32_t))
+			return sparse_stream_fail(s,
 					"Bogus chunk size for chunk type FILL");
-				return;
-			}
+		sparse_stream_expect(s, SPARSE_STREAM_FILL_VALUE, data_sz);
+		return 0;
+	case CHUNK_TYPE_DONT_CARE:
+		s->blk += chunk_data_sz / s->info.blksz;
+		/* fall through */
+	case CHUNK_TYPE_CRC32:
+		s->state = SPARSE_STREAM_SKIP;
+		s->left = data_sz;
+		break;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_stream_fail(s, "Unknown chunk type");
+	}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(info->blksz,
-						    ARCH_DMA_MINALIGN));
-			if (!fill_buf)
-			{
-				fastboot_fail(
-					"Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
+	s->total_blocks += chunk_header->chunk_sz;
+	if (!s->left)
+		sparse_stream_next_chunk(s);
 
-			fill_val = *(uint32_t *)data;
-			data = (char *) data + sizeof(uint32_t);
+	return 0;
+}
 
-			for (i = 0; i < (info->blksz / sizeof(fill_val)); i++)
-				fill_buf[i] = fill_val;
+int sparse_stream_start(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+			disk_partition_t *info, const char *part_name)
+{
+	memset(s, '\0', sizeof(*s));
+	s->blkbuf = memalign(ARCH_DMA_MINALIGN,
+			     ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!s->blkbuf) {
+		s->state = SPARSE_STREAM_ERROR;
+		fastboot_fail("Malloc failed for block buffer");
+		return -ENOMEM;
+	}
+	s->dev_desc = dev_desc;
+	s->info = *info;
+	strlcpy(s->part_name, part_name, sizeof(s->part_name));
+	s->blk = info->start;
+	sparse_stream_expect(s, SPARSE_STREAM_FILE_HDR,
+			     sizeof(sparse_header_t));
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				fastboot_fail(
-				    "Request would exceed partition size!");
-				return;
-			}
+	return 0;
+}
 
-			for (i = 0; i < blkcnt; i++) {
-				blks = dev_desc->block_write(dev_desc->dev,
-							     blk, 1, fill_buf);
-				if (blks != 1) {
-					printf(
-					    "%s: Write failed, block # " LBAFU "\n",
-					    __func__, blkcnt);
-					fastboot_fail("flash write failure");
-					free(fill_buf);
-					return;
-				}
-				blk++;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
+int sparse_stream_write(struct sparse_stream *s, const void *buf, uint len)
+{
+	const uchar *data = buf;
+	uint part;
+	int ret = 0;
 
-			free(fill_buf);
+	while (len && !ret) {
+		switch (s->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (sparse_stream_gather(s, &data, &len))
+				ret = sparse_stream_file_header(s);
 			break;
-
-			case CHUNK_TYPE_DONT_CARE:
-			blk += blkcnt;
-			total_blocks += chunk_header->chunk_sz;
+		case SPARSE_STREAM_FILE_HDR_REST:
+			if (sparse_stream_gather(s, &data, &len))
+				sparse_stream_expect_chunk(s);
 			break;
-
-			case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz)
-			{
-				fastboot_fail(
-					"Bogus chunk size for chunk type Dont Care");
-				return;
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (sparse_stream_gather(s, &data, &len))
+				ret = sparse_stream_chunk_header(s);
+			break;
+		case SPARSE_STREAM_FILL_VALUE:
+			if (sparse_stream_gather(s, &data, &len)) {
+				ret = sparse_stream_fill(s,
+					*(uint32_t *)s->hdr,
+					s->sparse.blk_sz * s->chunk.chunk_sz /
+					s->info.blksz);
+				s->total_blocks += s->chunk.chunk_sz;
+				if (!ret)
+					sparse_stream_next_chunk(s);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
 			break;
-
-			default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
+		case SPARSE_STREAM_RAW:
+		case SPARSE_STREAM_SKIP:
+			part = min_t(u64, len, s->left);
+			if (s->state == SPARSE_STREAM_RAW)
+				ret = sparse_stream_write_raw(s, data, part);
+			data += part;
+			len -= part;
+			s->left -= part;
+			if (!ret && !s->left)
+				sparse_stream_next_chunk(s);
+			break;
+		case SPARSE_STREAM_RAW_IMAGE:
+			ret = sparse_stream_write_raw(s, data, len);
+			len = 0;
+			break;
+		case SPARSE_STREAM_DONE:
+			/* Ignore anything after the last chunk */
+			len = 0;
+			break;
+		case SPARSE_STREAM_ERROR:
+			return -EIO;
 		}
 	}
 
-	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	return ret;
+}
+
+int sparse_stream_finish(struct sparse_stream *s)
+{
+	int ret = 0;
+
+	/* Anything shorter than a sparse header is a raw image */
+	if (s->state == SPARSE_STREAM_FILE_HDR) {
+		puts("Flashing Raw Image\n");
+		s->state = SPARSE_STREAM_RAW_IMAGE;
+		ret = sparse_stream_write_raw(s, s->hdr, s->hdr_len);
+	}
+
+	if (!ret && s->state == SPARSE_STREAM_RAW_IMAGE && s->blkbuf_len) {
+		/* Pad the last block */
+		memset(s->blkbuf + s->blkbuf_len, '\0',
+		       s->info.blksz - s->blkbuf_len);
+		ret = sparse_stream_write_blocks(s, s->blkbuf, 1);
+	}
+
+	free(s->blkbuf);
+	s->blkbuf = NULL;
+	if (ret || s->state == SPARSE_STREAM_ERROR)
+		return -EIO;
+
+	printf("........ wrote %llu bytes to '%s'\n", s->bytes_written,
+	       s->part_name);
 
-	if (total_blocks != sparse_header->total_blks)
-		fastboot_fail("sparse image write failure");
+	if (s->state != SPARSE_STREAM_RAW_IMAGE) {
+		debug("Wrote %d blocks, expected to write %d blocks\n",
+		      s->total_blocks, s->sparse.total_blks);
+		if (s->state != SPARSE_STREAM_DONE ||
+		    s->total_blocks != s->sparse.total_blks) {
+			fastboot_fail("sparse image write failure");
+			return -EIO;
+		}
+	}
 
 	fastboot_okay("");
-	return;
+
+	return 0;
+}
+
+void write_sparse_image(block_dev_desc_t *dev_desc,
+		disk_partition_t *info, const char *part_name,
+		void *data, unsigned sz)
+{
+	struct sparse_stream s;
+
+	if (sparse_stream_start(&s, dev_desc, info, part_name))
+		return;
+	sparse_stream_write(&s, data, sz);
+	sparse_stream_finish(&s);
 }
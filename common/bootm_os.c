@@ -474,6 +474,9 @@ __weak void arch_preboot_os(void)
 int boot_selected_os(int argc, char * const argv[], int state,
 		     bootm_headers_t *images, boot_os_fn *boot_fn)
 {
+	/* Send what is left of the console output while we still can */
+	serial_flush();
+	arch_park_cpus();
 	arch_preboot_os();
 	boot_fn(state, argc, argv, images);
 
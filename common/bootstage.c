@@ -13,8 +13,10 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <libfdt.h>
 #include <malloc.h>
+#include <version.h>
 #include <linux/compiler.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -25,13 +27,28 @@ struct bootstage_record {
 	const char *name;
 	int flags;		/* see enum bootstage_flags */
 	enum bootstage_id id;
+	uint32_t first_us;	/* start of the first accumulated interval */
+	uint32_t count;		/* number of accumulated intervals */
+	ulong bytes;		/* bytes transferred, see bootstage_add_bytes() */
+};
+
+/* A single timed interval, e.g. from bootstage_start() to bootstage_accum() */
+struct bootstage_interval {
+	const char *name;
+	uint32_t start_us;
+	uint32_t duration_us;
 };
 
 static struct bootstage_record record[BOOTSTAGE_ID_COUNT] = { {1} };
 static int next_id = BOOTSTAGE_ID_USER;
 
+/* These are written before relocation, so keep them out of .bss */
+static struct bootstage_interval interval[CONFIG_BOOTSTAGE_INTERVAL_COUNT]
+	__attribute__((section(".data")));
+static int interval_count __attribute__((section(".data")));
+
 enum {
-	BOOTSTAGE_VERSION	= 0,
+	BOOTSTAGE_VERSION	= 1,
 	BOOTSTAGE_MAGIC		= 0xb00757a3,
 	BOOTSTAGE_DIGITS	= 9,
 };
@@ -54,6 +71,9 @@ int bootstage_relocate(void)
 	for (i = 0; i < BOOTSTAGE_ID_COUNT; i++)
 		if (record[i].name)
 			record[i].name = strdup(record[i].name);
+	for (i = 0; i < interval_count && i < ARRAY_SIZE(interval); i++)
+		if (interval[i].name)
+			interval[i].name = strdup(interval[i].name);
 
 	return 0;
 }
@@ -137,6 +157,9 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name)
 
 	rec->start_us = timer_get_boot_us();
 	rec->name = name;
+	rec->id = id;
+	if (!rec->count)
+		rec->first_us = rec->start_us;
 	return rec->start_us;
 }
 
@@ -145,11 +168,35 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	struct bootstage_record *rec = &record[id];
 	uint32_t duration;
 
-	duration = (uint32_t)timer_get_boot_us() - rec->start_us;
+	duration = bootstage_add_interval(rec->name, rec->start_us);
 	rec->time_us += duration;
+	rec->count++;
+	return duration;
+}
+
+uint32_t bootstage_add_interval(const char *name, uint32_t start_us)
+{
+	uint32_t duration = (uint32_t)timer_get_boot_us() - start_us;
+	struct bootstage_interval *iv;
+
+	/* Keep counting when full, so that the export can report it */
+	if (interval_count < ARRAY_SIZE(interval)) {
+		iv = &interval[interval_count];
+		iv->name = name;
+		iv->start_us = start_us;
+		iv->duration_us = duration;
+	}
+	interval_count++;
+
 	return duration;
 }
 
+void bootstage_add_bytes(enum bootstage_id id, ulong bytes)
+{
+	if (id < BOOTSTAGE_ID_COUNT)
+		record[id].bytes += bytes;
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -331,6 +378,168 @@ static void append_data(char **ptrp, char *end, const void *data, int size)
 	memcpy(ptr, data, size);
 }
 
+/* Append formatted text, which must fit in a short line, to a buffer */
+static void append_fmt(char **ptrp, char *end, const char *fmt, ...)
+{
+	char buf[80];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vscnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	append_data(ptrp, end, buf, len);
+}
+
+/* Append a record name as a quoted JSON string or CSV field */
+static void append_name(char **ptrp, char *end, const char *name, bool csv)
+{
+	append_data(ptrp, end, "\"", 1);
+	for (; *name; name++) {
+		if (*name == '"')
+			append_data(ptrp, end, csv ? "\"\"" : "\\\"", 2);
+		else if (*name == '\\' && !csv)
+			append_data(ptrp, end, "\\\\", 2);
+		else if ((uchar)*name < ' ')
+			append_data(ptrp, end, " ", 1);
+		else
+			append_data(ptrp, end, name, 1);
+	}
+	append_data(ptrp, end, "\"", 1);
+}
+
+static int is_accum_record(const struct bootstage_record *rec)
+{
+	return rec->start_us || rec->count;
+}
+
+static void export_json(char **ptrp, char *end)
+{
+	struct bootstage_record *rec;
+	struct bootstage_interval *iv;
+	const char *sep;
+	char buf[20];
+	int id, i;
+
+	append_fmt(ptrp, end, "{\"traceEvents\":[\n");
+
+	/*
+	 * Marks are instant events, errors are flagged in the category. As
+	 * with bootstage_report(), the first record stands for reset.
+	 */
+	append_fmt(ptrp, end,
+		   "{\"name\":\"reset\",\"cat\":\"mark\",\"ph\":\"i\",\"s\":\"g\",");
+	append_fmt(ptrp, end, "\"ts\":0,\"pid\":0,\"tid\":0,\"args\":{\"id\":0}}");
+	sep = ",\n";
+	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (!rec->time_us || rec->id == BOOTSTAGE_ID_START ||
+		    is_accum_record(rec))
+			continue;
+		append_fmt(ptrp, end, "%s{\"name\":", sep);
+		append_name(ptrp, end, get_record_name(buf, sizeof(buf), rec),
+			    false);
+		append_fmt(ptrp, end,
+			   ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%lu,",
+			   rec->flags & BOOTSTAGEF_ERROR ? "error" : "mark",
+			   rec->time_us);
+		append_fmt(ptrp, end,
+			   "\"pid\":0,\"tid\":0,\"args\":{\"id\":%d}}",
+			   rec->id);
+		sep = ",\n";
+	}
+
+	/* Intervals nest according to their start time and duration */
+	for (i = 0, iv = interval;
+	     i < interval_count && i < ARRAY_SIZE(interval); i++, iv++) {
+		append_fmt(ptrp, end, "%s{\"name\":", sep);
+		append_name(ptrp, end, iv->name ? iv->name : "?", false);
+		append_fmt(ptrp, end,
+			   ",\"cat\":\"interval\",\"ph\":\"X\",\"ts\":%u,",
+			   iv->start_us);
+		append_fmt(ptrp, end, "\"dur\":%u,\"pid\":0,\"tid\":0}",
+			   iv->duration_us);
+		sep = ",\n";
+	}
+
+	/* Accumulated totals and byte counts go in the metadata */
+	append_fmt(ptrp, end, "\n],\n\"otherData\":{\"version\":");
+	append_name(ptrp, end, U_BOOT_VERSION_STRING, false);
+	append_fmt(ptrp, end, ",\n\"dropped_intervals\":\"%d\"",
+		   max(interval_count - (int)ARRAY_SIZE(interval), 0));
+	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if (!is_accum_record(rec))
+			continue;
+		append_fmt(ptrp, end, ",\n");
+		append_name(ptrp, end, get_record_name(buf, sizeof(buf), rec),
+			    false);
+		append_fmt(ptrp, end,
+			   ":\"total_us=%lu count=%u bytes=%lu\"",
+			   rec->time_us, rec->count, rec->bytes);
+	}
+	append_fmt(ptrp, end, "}}\n");
+}
+
+static void export_csv(char **ptrp, char *end)
+{
+	struct bootstage_record *rec;
+	struct bootstage_interval *iv;
+	char buf[20];
+	int id, i;
+
+	append_fmt(ptrp, end, "type,id,name,start_us,duration_us,count,bytes\n");
+	append_fmt(ptrp, end, "mark,0,\"reset\",0,,,\n");
+	for (rec = record, id = 0; id < BOOTSTAGE_ID_COUNT; id++, rec++) {
+		if ((!rec->time_us && !is_accum_record(rec)) ||
+		    rec->id == BOOTSTAGE_ID_START)
+			continue;
+		if (is_accum_record(rec)) {
+			append_fmt(ptrp, end, "accum,%d,", rec->id);
+			append_name(ptrp, end,
+				    get_record_name(buf, sizeof(buf), rec),
+				    true);
+			append_fmt(ptrp, end, ",%u,%lu,%u,%lu\n",
+				   rec->first_us, rec->time_us, rec->count,
+				   rec->bytes);
+		} else {
+			append_fmt(ptrp, end, "%s,%d,",
+				   rec->flags & BOOTSTAGEF_ERROR ?
+				   "error" : "mark", rec->id);
+			append_name(ptrp, end,
+				    get_record_name(buf, sizeof(buf), rec),
+				    true);
+			append_fmt(ptrp, end, ",%lu,,,\n", rec->time_us);
+		}
+	}
+
+	for (i = 0, iv = interval;
+	     i < interval_count && i < ARRAY_SIZE(interval); i++, iv++) {
+		append_fmt(ptrp, end, "interval,,");
+		append_name(ptrp, end, iv->name ? iv->name : "?", true);
+		append_fmt(ptrp, end, ",%u,%u,,\n", iv->start_us,
+			   iv->duration_us);
+	}
+	if (interval_count > ARRAY_SIZE(interval))
+		append_fmt(ptrp, end, "dropped,,,,,%d,\n",
+			   interval_count - (int)ARRAY_SIZE(interval));
+}
+
+int bootstage_export(void *base, int size, enum bootstage_format format)
+{
+	char *ptr = base, *end = ptr + size;
+
+	if (format == BOOTSTAGE_FORMAT_CSV)
+		export_csv(&ptr, end);
+	else
+		export_json(&ptr, end);
+
+	if (ptr > end) {
+		debug("%s: Not enough space for bootstage export\n", __func__);
+		return -ENOSPC;
+	}
+
+	return ptr - (char *)base;
+}
+
 int bootstage_stash(void *base, int size)
 {
 	struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
@@ -12,6 +12,11 @@
 #include <command.h>
 #include <net.h>
 
+/* Allow ports with secondary CPUs running U-Boot code to stop them */
+__weak void arch_park_cpus(void)
+{
+}
+
 #ifdef CONFIG_CMD_GO
 
 /* Allow ports to override the default behavior */
@@ -34,6 +39,10 @@ static int do_go(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 	printf ("## Starting application at 0x%08lX ...\n", addr);
 
+	/* The application may take over the UART and U-Boot's memory */
+	serial_flush();
+	arch_park_cpus();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
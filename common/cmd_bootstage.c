@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <mapmem.h>
 
 static int do_bootstage_report(cmd_tbl_t *cmdtp, int flag, int argc,
 			       char * const argv[])
@@ -58,10 +59,51 @@ static int do_bootstage_stash(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_bootstage_export(cmd_tbl_t *cmdtp, int flag, int argc,
+			       char * const argv[])
+{
+	enum bootstage_format format = BOOTSTAGE_FORMAT_JSON;
+	ulong base, size = 0x10000;
+	char *endp;
+	void *buf;
+	int ret;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	base = simple_strtoul(argv[1], &endp, 16);
+	if (*argv[1] == 0 || *endp != 0)
+		return CMD_RET_USAGE;
+	if (argc > 2) {
+		if (!strcmp(argv[2], "csv"))
+			format = BOOTSTAGE_FORMAT_CSV;
+		else if (strcmp(argv[2], "json"))
+			return CMD_RET_USAGE;
+	}
+	if (argc > 3) {
+		size = simple_strtoul(argv[3], &endp, 16);
+		if (*argv[3] == 0 || *endp != 0)
+			return CMD_RET_USAGE;
+	}
+
+	buf = map_sysmem(base, size);
+	ret = bootstage_export(buf, size, format);
+	unmap_sysmem(buf);
+	if (ret < 0) {
+		printf("Not enough space for bootstage export (%#lx bytes)\n",
+		       size);
+		return 1;
+	}
+	printf("Exported %d bytes\n", ret);
+	setenv_hex("filesize", ret);
+
+	return 0;
+}
+
 static cmd_tbl_t cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
+	U_BOOT_CMD_MKENT(export, 4, 0, do_bootstage_export, "", ""),
 };
 
 /*
@@ -86,10 +128,13 @@ static int do_boostage(cmd_tbl_t *cmdtp, int flag, int argc,
 }
 
 
-U_BOOT_CMD(bootstage, 4, 1, do_boostage,
+U_BOOT_CMD(bootstage, 5, 1, do_boostage,
 	"Boot stage command",
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
-	"unstash [<start> [<size>]]  - Unstash data from memory"
+	"unstash [<start> [<size>]]  - Unstash data from memory\n"
+	"export <start> [json|csv [<size>]]\n"
+	"                            - Write timings as a Chrome trace (json)\n"
+	"                              or CSV, setting 'filesize'"
 );
@@ -117,6 +117,10 @@ static unsigned long do_bootelf_exec(ulong (*entry)(int, char * const[]),
 	if (dcache)
 		dcache_disable();
 
+	/* The image may take over the UART and U-Boot's memory */
+	serial_flush();
+	arch_park_cpus();
+
 	/*
 	 * pass address parameter as argv[0] (aka command name),
 	 * and all remaining args
@@ -378,6 +382,8 @@ int do_bootvx(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		puts("## Not an ELF image, assuming binary\n");
 
 	printf("## Starting vxWorks at 0x%08lx ...\n", addr);
+	serial_flush();
+	arch_park_cpus();
 
 	dcache_disable();
 #ifdef CONFIG_X86
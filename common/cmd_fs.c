@@ -51,6 +51,25 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#ifdef CONFIG_GZIP
+static int do_gzload_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	return do_gzload(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	gzload,	6,	0,	do_gzload_wrapper,
+	"load and decompress a gzip file from a filesystem",
+	"<interface> <dev[:part]> <addr> <filename> [maxsize]\n"
+	"    - Read gzip-compressed file 'filename' from partition 'part' on\n"
+	"      device type 'interface' instance 'dev' in chunks and\n"
+	"      decompress it to address 'addr' while reading.\n"
+	"      'maxsize' limits the uncompressed size in bytes.\n"
+	"      The uncompressed size is stored in 'filesize'."
+);
+#endif
+
 static int do_save_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
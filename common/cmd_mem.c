@@ -18,9 +18,13 @@
 #ifdef CONFIG_HAS_DATAFLASH
 #include <dataflash.h>
 #endif
+#include <div64.h>
+#include <errno.h>
 #include <hash.h>
 #include <inttypes.h>
+#include <malloc.h>
 #include <mapmem.h>
+#include <memtest.h>
 #include <watchdog.h>
 #include <asm/io.h>
 #include <linux/compiler.h>
@@ -991,10 +995,70 @@ static ulong mem_test_quick(vu_long *buf, ulong start_addr, ulong end_addr,
 	return 0;
 }
 
+#ifdef CONFIG_CMD_MEMTEST_FAST
+/* Print a transfer rate in GB/s with two decimal places */
+static void mem_test_print_rate(ulong bytes, ulong us)
+{
+	ulong rate = bytes / 10 / max(us, 1UL);	/* 1/100ths of GB/s */
+
+	printf("%3lu.%02lu GB/s", rate / 100, rate % 100);
+}
+
+static ulong mem_test_fast(void *buf, ulong start_addr, ulong end_addr,
+			   ulong seed)
+{
+	struct memtest_run run;
+	ulong errs = 0;
+	int pattern, ret;
+
+	memset(&run, '\0', sizeof(run));
+	run.addr = start_addr;
+	run.buf = buf;
+	run.size = end_addr - start_addr;
+	run.seed = seed;
+
+	for (pattern = 0; pattern < MEMTEST_PATTERN_COUNT; pattern++) {
+		WATCHDOG_RESET();
+		if (ctrlc())
+			return -1;
+
+		ret = memtest_fill(&run, pattern);
+		if (!ret)
+			ret = memtest_check(&run, pattern);
+		if (ret && ret != -EIO) {
+			printf("\nMemory test failed (err=%d)\n", ret);
+			return -1;
+		}
+
+		printf("\n%-16s write ", memtest_pattern_name(pattern));
+		mem_test_print_rate(run.size, run.fill_us);
+		puts("  read ");
+		mem_test_print_rate(run.size, run.check_us);
+		if (run.errors) {
+			printf("\nMem error @ 0x%08lX: found %08lX, expected %08lX (%lu bad words)",
+			       run.bad_addr, run.found, run.expected,
+			       run.errors);
+			errs += run.errors;
+		}
+	}
+	putc('\n');
+
+	return errs;
+}
+#endif
+
+enum {
+	MEM_TEST_QUICK,
+	MEM_TEST_ALT,
+	MEM_TEST_FAST,
+};
+
 /*
  * Perform a memory test. A more complete alternative test can be
- * configured using CONFIG_SYS_ALT_MEMTEST. The complete test loops until
- * interrupted by ctrl-c or by a failure of one of the sub-tests.
+ * configured using CONFIG_SYS_ALT_MEMTEST, and a faster test using all
+ * CPUs with CONFIG_CMD_MEMTEST_FAST. Either can also be selected with a
+ * flag. The complete test loops until interrupted by ctrl-c or by a
+ * failure of one of the sub-tests.
  */
 static int do_mem_mtest(cmd_tbl_t *cmdtp, int flag, int argc,
 			char * const argv[])
@@ -1006,12 +1070,29 @@ static int do_mem_mtest(cmd_tbl_t *cmdtp, int flag, int argc,
 	ulong errs = 0;	/* number of errors, or -1 if interrupted */
 	ulong pattern = 0;
 	int iteration;
-#if defined(CONFIG_SYS_ALT_MEMTEST)
-	const int alt_test = 1;
+#if defined(CONFIG_CMD_MEMTEST_FAST)
+	int mode = MEM_TEST_FAST;
+#elif defined(CONFIG_SYS_ALT_MEMTEST)
+	int mode = MEM_TEST_ALT;
 #else
-	const int alt_test = 0;
+	int mode = MEM_TEST_QUICK;
 #endif
 
+	if (argc > 1 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-q"))
+			mode = MEM_TEST_QUICK;
+		else if (!strcmp(argv[1], "-a"))
+			mode = MEM_TEST_ALT;
+#ifdef CONFIG_CMD_MEMTEST_FAST
+		else if (!strcmp(argv[1], "-f"))
+			mode = MEM_TEST_FAST;
+#endif
+		else
+			return CMD_RET_USAGE;
+		argc--;
+		argv++;
+	}
+
 	start = CONFIG_SYS_MEMTEST_START;
 	end = CONFIG_SYS_MEMTEST_END;
 
@@ -1052,11 +1133,21 @@ static int do_mem_mtest(cmd_tbl_t *cmdtp, int flag, int argc,
 
 		printf("Iteration: %6d\r", iteration + 1);
 		debug("\n");
-		if (alt_test) {
+		switch (mode) {
+		case MEM_TEST_ALT:
 			errs = mem_test_alt(buf, start, end, dummy);
-		} else {
+			break;
+#ifdef CONFIG_CMD_MEMTEST_FAST
+		case MEM_TEST_FAST:
+			/* Vary the random pattern between iterations */
+			errs = mem_test_fast((void *)buf, start, end,
+					     pattern + iteration);
+			break;
+#endif
+		default:
 			errs = mem_test_quick(buf, start, end, pattern,
 					      iteration);
+			break;
 		}
 		if (errs == -1UL)
 			break;
@@ -1340,6 +1431,98 @@ static int do_mem_info(cmd_tbl_t *cmdtp, int flag, int argc,
 }
 #endif
 
+#ifdef CONFIG_CMD_MEMBENCH
+#define MEMBENCH_DEFAULT_SIZE	(1 << 20)
+#define MEMBENCH_MS		250
+
+enum {
+	MEMBENCH_MEMSET,
+	MEMBENCH_MEMCPY,
+	MEMBENCH_MEMMOVE,
+
+	MEMBENCH_COUNT,
+};
+
+static const char *const membench_name[MEMBENCH_COUNT] = {
+	"memset", "memcpy", "memmove",
+};
+
+/*
+ * Run one function repeatedly for about MEMBENCH_MS and print the rate.
+ * memmove() shifts the destination up by 64 bytes, so it takes the
+ * overlapping, backwards path.
+ */
+static void membench_run(int func, void *dst, const void *src, ulong size)
+{
+	ulong start, us;
+	u64 bytes = 0;
+
+	start = timer_get_us();
+	do {
+		switch (func) {
+		case MEMBENCH_MEMSET:
+			memset(dst, (u8)bytes, size);
+			break;
+		case MEMBENCH_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case MEMBENCH_MEMMOVE:
+			memmove(dst + 64, dst, size - 64);
+			break;
+		}
+		bytes += size;
+		us = timer_get_us() - start;
+	} while (us < MEMBENCH_MS * 1000);
+
+	printf("%-8s %6llu MB/s\n", membench_name[func],
+	       lldiv(bytes, us));	/* bytes per us is MB/s */
+}
+
+static int do_mem_bench(cmd_tbl_t *cmdtp, int flag, int argc,
+			char * const argv[])
+{
+	ulong size = MEMBENCH_DEFAULT_SIZE;
+	void *dst, *src, *buf = NULL;
+	int func;
+
+	if (argc > 1)
+		size = simple_strtoul(argv[1], NULL, 16);
+	if (argc == 3 || size <= 64)
+		return CMD_RET_USAGE;
+
+	if (argc > 3) {
+		src = map_sysmem(simple_strtoul(argv[2], NULL, 16), size);
+		dst = map_sysmem(simple_strtoul(argv[3], NULL, 16), size);
+	} else {
+		buf = memalign(ARCH_DMA_MINALIGN, size * 2);
+		if (!buf) {
+			printf("Cannot allocate %#lx bytes\n", size * 2);
+			return CMD_RET_FAILURE;
+		}
+		src = buf;
+		dst = buf + size;
+		memset(src, 0xa5, size);
+	}
+
+	printf("Size %#lx, src %p, dst %p\n", size, src, dst);
+	for (func = 0; func < MEMBENCH_COUNT; func++) {
+		membench_run(func, dst, src, size);
+		WATCHDOG_RESET();
+		if (ctrlc())
+			break;
+	}
+
+	if (buf) {
+		free(buf);
+	} else {
+		unmap_sysmem(src);
+		unmap_sysmem(dst);
+	}
+
+	return CMD_RET_SUCCESS;
+}
+#endif
+
 U_BOOT_CMD(
 	base,	2,	1,	do_mem_base,
 	"print or set address offset",
@@ -1371,9 +1554,17 @@ U_BOOT_CMD(
 
 #ifdef CONFIG_CMD_MEMTEST
 U_BOOT_CMD(
-	mtest,	5,	1,	do_mem_mtest,
+	mtest,	6,	1,	do_mem_mtest,
 	"simple RAM read/write test",
-	"[start [end [pattern [iterations]]]]"
+#ifdef CONFIG_CMD_MEMTEST_FAST
+	"[-f|-q|-a] [start [end [pattern [iterations]]]]\n"
+	"    -f - fast test on all CPUs, showing the write/read rates\n"
+	"         (default); 'pattern' seeds the random pattern\n"
+#else
+	"[-q|-a] [start [end [pattern [iterations]]]]\n"
+#endif
+	"    -q - quick test with an incrementing pattern\n"
+	"    -a - more complete test, including address lines"
 );
 #endif	/* CONFIG_CMD_MEMTEST */
 
@@ -1406,3 +1597,13 @@ U_BOOT_CMD(
 	""
 );
 #endif
+
+#ifdef CONFIG_CMD_MEMBENCH
+U_BOOT_CMD(
+	membench,	4,	0,	do_mem_bench,
+	"measure memset/memcpy/memmove bandwidth",
+	"[size [src dst]]\n"
+	"    - time each function on 'size' bytes (default 1MiB), using\n"
+	"      buffers from malloc() or at the given addresses"
+);
+#endif
@@ -87,6 +87,7 @@ void scsi_scan(int mode)
 		printf("scanning bus for devices...\n");
 	}
 	for(i=0;i<CONFIG_SYS_SCSI_MAX_DEVICE;i++) {
+		blkcache_invalidate(IF_TYPE_SCSI, i);
 		scsi_dev_desc[i].target=0xff;
 		scsi_dev_desc[i].lun=0xff;
 		scsi_dev_desc[i].lba=0;
@@ -370,7 +371,11 @@ static ulong scsi_read(int device, lbaint_t blknr, lbaint_t blkcnt,
 	uintptr_t buf_addr;
 	unsigned short smallblks = 0;
 	ccb* pccb=(ccb *)&tempccb;
+	bool failed = false;
 	device&=0xff;
+	if (blkcache_read(IF_TYPE_SCSI, device, blknr, blkcnt,
+			  scsi_dev_desc[device].blksz, buffer))
+		return blkcnt;
 	/* Setup  device
 	 */
 	pccb->target=scsi_dev_desc[device].target;
@@ -413,12 +418,16 @@ static ulong scsi_read(int device, lbaint_t blknr, lbaint_t blkcnt,
 		if (scsi_exec(pccb) != true) {
 			scsi_print_error(pccb);
 			blkcnt-=blks;
+			failed = true;
 			break;
 		}
 		buf_addr+=pccb->datalen;
 	} while(blks!=0);
 	debug("scsi_read_ext: end startblk " LBAF
 	      ", blccnt %x buffer %" PRIXPTR "\n", start, smallblks, buf_addr);
+	if (!failed)
+		blkcache_fill(IF_TYPE_SCSI, device, blknr, blkcnt,
+			      scsi_dev_desc[device].blksz, buffer);
 	return(blkcnt);
 }
 
@@ -437,6 +446,7 @@ static ulong scsi_write(int device, lbaint_t blknr,
 	unsigned short smallblks;
 	ccb* pccb = (ccb *)&tempccb;
 	device &= 0xff;
+	blkcache_invalidate(IF_TYPE_SCSI, device);
 	/* Setup  device
 	 */
 	pccb->target = scsi_dev_desc[device].target;
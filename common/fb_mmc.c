@@ -10,7 +10,9 @@
 #include <part.h>
 #include <aboot.h>
 #include <sparse_format.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <linux/sizes.h>
 
 #ifndef CONFIG_FASTBOOT_GPT_NAME
 #define CONFIG_FASTBOOT_GPT_NAME GPT_ENTRY_NAME
@@ -134,6 +136,119 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 				download_bytes);
 }
 
+#ifdef CONFIG_FASTBOOT_STREAM
+enum {
+	STREAM_IDLE,
+	STREAM_ARMED,		/* the next download goes to fb_stream */
+	STREAM_BUSY,		/* the download is being written */
+	STREAM_DONE,		/* waiting for the flash command */
+};
+
+static struct sparse_stream fb_stream;
+static int fb_stream_state;
+static unsigned int fb_stream_size;
+static char fb_stream_response[RESPONSE_LEN];
+
+void fb_mmc_stream_start(const char *cmd, char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+
+	/* initialize the response buffer */
+	response_str = response;
+
+	/* Drop anything left from a download which did not finish */
+	free(fb_stream.blkbuf);
+	fb_stream.blkbuf = NULL;
+	fb_stream_state = STREAM_IDLE;
+	fb_stream_response[0] = '\0';
+	if (!*cmd) {
+		fastboot_okay("");
+		return;
+	}
+
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
+		error("invalid mmc device\n");
+		fastboot_fail("invalid mmc device");
+		return;
+	}
+
+	if (strcmp(cmd, CONFIG_FASTBOOT_GPT_NAME) == 0) {
+		fastboot_fail("cannot stream partition table");
+		return;
+	} else if (get_partition_info_efi_by_name_or_alias(dev_desc, cmd, &info)) {
+		error("cannot find partition: '%s'\n", cmd);
+		fastboot_fail("cannot find partition");
+		return;
+	}
+
+	if (sparse_stream_start(&fb_stream, dev_desc, &info, cmd))
+		return;
+
+	/* Allow for the headers of a sparse image of the whole partition */
+	fb_stream_size = min_t(u64, (u64)info.size * info.blksz + SZ_1M,
+			       0xfffff000);
+	fb_stream_state = STREAM_ARMED;
+	printf("Next download is written to '%s'\n", cmd);
+	fastboot_okay("");
+}
+
+unsigned int fb_mmc_stream_size(void)
+{
+	return fb_stream_state == STREAM_ARMED ? fb_stream_size : 0;
+}
+
+void fb_mmc_stream_reset(void)
+{
+	switch (fb_stream_state) {
+	case STREAM_BUSY:
+		printf("Streamed download to '%s' did not finish\n",
+		       fb_stream.part_name);
+		free(fb_stream.blkbuf);
+		fb_stream.blkbuf = NULL;
+		break;
+	case STREAM_DONE:
+		printf("Streamed download to '%s' was not flashed\n",
+		       fb_stream.part_name);
+		break;
+	default:
+		return;
+	}
+	fb_stream_state = STREAM_IDLE;
+}
+
+void fb_mmc_stream_write(const void *buf, unsigned int len)
+{
+	fb_stream_state = STREAM_BUSY;
+	response_str = fb_stream_response;
+	sparse_stream_write(&fb_stream, buf, len);
+}
+
+void fb_mmc_stream_finish(void)
+{
+	response_str = fb_stream_response;
+	sparse_stream_finish(&fb_stream);
+	fb_stream_state = STREAM_DONE;
+}
+
+bool fb_mmc_stream_result(const char *cmd, char *response)
+{
+	if (fb_stream_state != STREAM_DONE)
+		return false;
+
+	fb_stream_state = STREAM_IDLE;
+	if (strcmp(cmd, fb_stream.part_name)) {
+		snprintf(response, RESPONSE_LEN, "FAILimage was written to %s",
+			 fb_stream.part_name);
+		return true;
+	}
+	strcpy(response, fb_stream_response);
+
+	return true;
+}
+#endif
+
 void fb_mmc_erase(const char *cmd, char *response)
 {
 	int ret;
@@ -341,6 +341,8 @@ int boot_get_fdt(int flag, int argc, char * const argv[], uint8_t arch,
 			memmove((void *)load,
 				(void *)image_data,
 				image_get_data_size(fdt_hdr));
+			fit_forget_hashes(images, load,
+					  image_get_data_size(fdt_hdr));
 
 			fdt_addr = load;
 			break;
@@ -22,6 +22,7 @@ DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
 #include <bootstage.h>
+#include <mp_job.h>
 #include <u-boot/crc.h>
 #include <u-boot/md5.h>
 #include <u-boot/sha1.h>
@@ -926,10 +927,27 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* Look for a hash node value which was calculated ahead of time */
+static const struct fit_hash_result *fit_find_hash(const void *fit,
+		int noffset, const void *data, size_t size,
+		const struct fit_hash_result *hashes, int count)
+{
+	for (; count > 0; count--, hashes++) {
+		if (hashes->fit == fit && hashes->noffset == noffset &&
+		    hashes->data == data && hashes->size == size)
+			return hashes;
+	}
+
+	return NULL;
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const struct fit_hash_result *hashes,
+				int count, char **err_msgp)
 {
+	const struct fit_hash_result *hash;
 	uint8_t value[FIT_MAX_HASH_LEN];
+	const uint8_t *calc_value;
 	int value_len;
 	char *algo;
 	uint8_t *fit_value;
@@ -958,15 +976,26 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
-		*err_msgp = "Unsupported hash algorithm";
-		return -1;
+	hash = fit_find_hash(fit, noffset, data, size, hashes, count);
+	if (hash) {
+		if (hash->err) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		calc_value = hash->value;
+		value_len = hash->value_len;
+	} else {
+		if (calculate_hash(data, size, algo, value, &value_len)) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		calc_value = value;
 	}
 
 	if (value_len != fit_value_len) {
 		*err_msgp = "Bad hash value len";
 		return -1;
-	} else if (memcmp(value, fit_value, value_len) != 0) {
+	} else if (memcmp(calc_value, fit_value, value_len) != 0) {
 		*err_msgp = "Bad hash value";
 		return -1;
 	}
@@ -974,20 +1003,149 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
+#if IMAGE_ENABLE_PARALLEL_HASH
+static int fit_hash_job(void *arg)
+{
+	struct fit_hash_result *hash = arg;
+
+	hash->err = calculate_hash(hash->data, hash->size, hash->algo,
+				   hash->value, &hash->value_len);
+
+	return hash->err;
+}
+
 /**
- * fit_image_verify - verify data intergity
+ * fit_image_add_hashes - add the hash nodes of an image to a batch
  * @fit: pointer to the FIT format image header
  * @image_noffset: component image node offset
+ * @hashes: batch of hashes to calculate, FIT_HASH_BATCH_MAX entries
+ * @count: number of entries already used in @hashes
  *
- * fit_image_verify() goes over component image hash nodes,
- * re-calculates each data hash and compares with the value stored in hash
- * node.
+ * Hash nodes which are ignored, or which do not fit in the batch, are
+ * left out. fit_image_check_hash() calculates those itself.
+ *
+ * returns:
+ *     new number of entries used in @hashes
+ */
+static int fit_image_add_hashes(const void *fit, int image_noffset,
+				struct fit_hash_result *hashes, int count)
+{
+	struct fit_hash_result *hash;
+	const void *data;
+	size_t size;
+	int noffset;
+	char *algo;
+	int ignore;
+
+	if (fit_image_get_data(fit, image_noffset, &data, &size))
+		return count;
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)) ||
+		    fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+
+		ignore = 0;
+		if (IMAGE_ENABLE_IGNORE)
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+		if (ignore)
+			continue;
+
+		if (count == FIT_HASH_BATCH_MAX)
+			break;
+
+		hash = &hashes[count++];
+		hash->fit = fit;
+		hash->noffset = noffset;
+		hash->algo = algo;
+		hash->data = data;
+		hash->size = size;
+	}
+
+	return count;
+}
+
+/* Calculate a batch of hashes, sharing them out between the CPUs */
+static void fit_calc_hashes(struct fit_hash_result *hashes, int count)
+{
+	struct mp_job jobs[FIT_HASH_BATCH_MAX];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		jobs[i].func = fit_hash_job;
+		jobs[i].arg = &hashes[i];
+	}
+	mp_run_jobs(jobs, count);
+}
+
+/* Hash all images used by a configuration, ready for fit_image_select() */
+static void fit_conf_calc_hashes(const void *fit, int cfg_noffset,
+				 bootm_headers_t *images)
+{
+	static const char * const props[] = {
+		FIT_KERNEL_PROP, FIT_RAMDISK_PROP, FIT_FDT_PROP,
+		FIT_SETUP_PROP, FIT_LOADABLE_PROP,
+	};
+	const char *uname;
+	int count = 0;
+	int noffset;
+	int i, index;
+
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		for (index = 0;
+		     !fdt_get_string_index(fit, cfg_noffset, props[i], index,
+					   &uname);
+		     index++) {
+			noffset = fit_image_get_node(fit, uname);
+			if (noffset >= 0)
+				count = fit_image_add_hashes(fit, noffset,
+						images->fit_hashes, count);
+		}
+	}
+
+	fit_calc_hashes(images->fit_hashes, count);
+	images->fit_hash_count = count;
+}
+
+void fit_forget_hashes(bootm_headers_t *images, ulong start, ulong len)
+{
+	const char *buf = map_sysmem(start, len);
+	int i;
+
+	for (i = 0; i < images->fit_hash_count; i++) {
+		const char *data = images->fit_hashes[i].data;
+
+		if (buf < data + images->fit_hashes[i].size &&
+		    data < buf + len) {
+			images->fit_hash_count = 0;
+			break;
+		}
+	}
+	unmap_sysmem(buf);
+}
+#endif /* IMAGE_ENABLE_PARALLEL_HASH */
+
+/**
+ * fit_image_verify_hashes - verify data intergity
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @hashes: hash node values calculated ahead of time, or NULL
+ * @count: number of entries in @hashes
+ *
+ * fit_image_verify_hashes() goes over component image hash nodes and
+ * compares each data hash with the value stored in hash node. Hashes not
+ * found in @hashes are calculated here.
  *
  * returns:
  *     1, if all hashes are valid
  *     0, otherwise (or on error)
  */
-int fit_image_verify(const void *fit, int image_noffset)
+static int fit_image_verify_hashes(const void *fit, int image_noffset,
+				   const struct fit_hash_result *hashes,
+				   int count)
 {
 	const void	*data;
 	size_t		size;
@@ -1022,7 +1180,7 @@ int fit_image_verify(const void *fit, int image_noffset)
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
+						 hashes, count, &err_msg))
 				goto error;
 			puts("+ ");
 		} else if (IMAGE_ENABLE_VERIFY && verify_all &&
@@ -1053,6 +1211,37 @@ error:
 	return 0;
 }
 
+/**
+ * fit_image_verify - verify data intergity
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ *
+ * fit_image_verify() goes over component image hash nodes,
+ * re-calculates each data hash and compares with the value stored in hash
+ * node. Where an image has several hash nodes they may be calculated in
+ * parallel.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+int fit_image_verify(const void *fit, int image_noffset)
+{
+#if IMAGE_ENABLE_PARALLEL_HASH
+	struct fit_hash_result hashes[FIT_HASH_BATCH_MAX];
+	int count;
+
+	count = fit_image_add_hashes(fit, image_noffset, hashes, 0);
+	if (count > 1) {
+		fit_calc_hashes(hashes, count);
+		return fit_image_verify_hashes(fit, image_noffset, hashes,
+					       count);
+	}
+#endif
+
+	return fit_image_verify_hashes(fit, image_noffset, NULL, 0);
+}
+
 /**
  * fit_all_image_verify - verify data intergity for all images
  * @fit: pointer to the FIT format image header
@@ -1066,10 +1255,15 @@ error:
  */
 int fit_all_image_verify(const void *fit)
 {
+	struct fit_hash_result *hashes = NULL;
+	int nhashes = 0;
 	int images_noffset;
 	int noffset;
 	int ndepth;
 	int count;
+#if IMAGE_ENABLE_PARALLEL_HASH
+	struct fit_hash_result batch[FIT_HASH_BATCH_MAX];
+#endif
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
@@ -1079,6 +1273,14 @@ int fit_all_image_verify(const void *fit)
 		return 0;
 	}
 
+#if IMAGE_ENABLE_PARALLEL_HASH
+	/* Calculate the hashes of all images at once */
+	fdt_for_each_subnode(fit, noffset, images_noffset)
+		nhashes = fit_image_add_hashes(fit, noffset, batch, nhashes);
+	fit_calc_hashes(batch, nhashes);
+	hashes = batch;
+#endif
+
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
@@ -1094,7 +1296,8 @@ int fit_all_image_verify(const void *fit)
 			printf("   Hash(es) for Image %u (%s): ", count++,
 			       fit_get_name(fit, noffset, NULL));
 
-			if (!fit_image_verify(fit, noffset))
+			if (!fit_image_verify_hashes(fit, noffset, hashes,
+						     nhashes))
 				return 0;
 			printf("\n");
 		}
@@ -1481,13 +1684,21 @@ void fit_conf_print(const void *fit, int noffset, const char *p)
 	}
 }
 
-static int fit_image_select(const void *fit, int rd_noffset, int verify)
+static int fit_image_select(const void *fit, int rd_noffset, int verify,
+			    const struct fit_hash_result *hashes, int nhashes)
 {
+	int ok;
+
 	fit_image_print(fit, rd_noffset, "   ");
 
 	if (verify) {
 		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
+		if (nhashes)
+			ok = fit_image_verify_hashes(fit, rd_noffset, hashes,
+						     nhashes);
+		else
+			ok = fit_image_verify(fit, rd_noffset);
+		if (!ok) {
 			puts("Bad Data Hash\n");
 			return -EACCES;
 		}
@@ -1568,6 +1779,8 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	ulong load, data, len;
 	uint8_t os;
 	const char *prop_name;
+	const struct fit_hash_result *hashes = NULL;
+	int nhashes = 0;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -1621,6 +1834,10 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 				}
 				puts("OK\n");
 			}
+#if IMAGE_ENABLE_PARALLEL_HASH
+			if (images->verify)
+				fit_conf_calc_hashes(fit, cfg_noffset, images);
+#endif
 			bootstage_mark(BOOTSTAGE_ID_FIT_CONFIG);
 		}
 
@@ -1636,7 +1853,11 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+#if IMAGE_ENABLE_PARALLEL_HASH
+	hashes = images->fit_hashes;
+	nhashes = images->fit_hash_count;
+#endif
+	ret = fit_image_select(fit, noffset, images->verify, hashes, nhashes);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -1743,6 +1964,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 		dst = map_sysmem(load, len);
 		memmove(dst, buf, len);
+		fit_forget_hashes(images, load, len);
 		data = load;
 	}
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_LOAD);
@@ -26,6 +26,7 @@
 #include <command.h>
 #include <dm.h>
 #include <errno.h>
+#include <malloc.h>
 #include <memalign.h>
 #include <asm/processor.h>
 #include <asm/unaligned.h>
@@ -33,6 +34,7 @@
 #include <asm/byteorder.h>
 #include <asm/unaligned.h>
 #include <dm/root.h>
+#include <linux/list.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -43,10 +45,49 @@ DECLARE_GLOBAL_DATA_PTR;
 
 #define USB_BUFSIZ	512
 
+/*
+ * A connection must be seen to be stable for HUB_DEBOUNCE_STABLE ms
+ * before the port is reset, and give up if it has not settled after
+ * HUB_DEBOUNCE_TIMEOUT ms (USB 2.0 section 7.1.7.3, as Linux does)
+ */
+#define HUB_DEBOUNCE_STABLE	100
+#define HUB_DEBOUNCE_TIMEOUT	2000
+
+/* Polling interval and timeout while a port reset is in progress */
+#define HUB_RESET_POLL		10
+#define HUB_RESET_TIMEOUT	200
+
+/* Reset recovery time: TRSTRCY is 10 ms; allow a little more */
+#define HUB_RESET_RECOVERY	50
+
 /* TODO(sjg@chromium.org): Remove this when CONFIG_DM_USB is defined */
 static struct usb_hub_device hub_dev[USB_MAX_HUB];
 static int usb_hub_index;
 
+/**
+ * struct usb_device_scan - a hub port waiting for a device
+ *
+ * @dev:	Hub device
+ * @hub:	Hub information
+ * @port:	Port number on the hub, from 0
+ * @connected:	A connection has been seen and is being debounced
+ * @stable_since: Time (in ms) since which the connection has been stable
+ * @deadline:	Time (in ms) at which to give up on the port
+ * @list:	Entry in usb_scan_list
+ */
+struct usb_device_scan {
+	struct usb_device *dev;
+	struct usb_hub_device *hub;
+	int port;
+	bool connected;
+	ulong stable_since;
+	ulong deadline;
+	struct list_head list;
+};
+
+/* Ports of all the hubs found so far which are still being scanned */
+static LIST_HEAD(usb_scan_list);
+
 __weak void usb_hub_reset_devices(int port)
 {
 	return;
@@ -114,7 +155,18 @@ static void usb_hub_power_on(struct usb_hub_device *hub)
 		pgood_delay = max(pgood_delay,
 			          (unsigned)simple_strtol(env, NULL, 0));
 	debug("pgood_delay=%dms\n", pgood_delay);
-	mdelay(pgood_delay + 1000);
+
+	/*
+	 * Rather than waiting here, record when the ports may first be
+	 * queried (once power is good, and at least 100ms) and when to give
+	 * up waiting for a device to connect. The ports of all hubs are then
+	 * polled together by usb_device_list_scan().
+	 */
+	hub->query_delay = get_timer(0) + max(100U, pgood_delay);
+	hub->connect_timeout = hub->query_delay + 1000;
+	debug("devnum=%d poweron: query_delay=%d connect_timeout=%d\n",
+	      dev->devnum, max(100U, pgood_delay),
+	      max(100U, pgood_delay) + 1000);
 }
 
 void usb_hub_reset(void)
@@ -169,19 +221,26 @@ int legacy_hub_port_reset(struct usb_device *dev, int port,
 	debug("%s: resetting port %d...\n", __func__, port + 1);
 #endif
 	for (tries = 0; tries < MAX_TRIES; tries++) {
+		ulong start;
+
 		err = usb_set_port_feature(dev, port + 1, USB_PORT_FEAT_RESET);
 		if (err < 0)
 			return err;
 
-		mdelay(200);
-
-		if (usb_get_port_status(dev, port + 1, portsts) < 0) {
-			debug("get_port_status failed status %lX\n",
-			      dev->status);
-			return -1;
-		}
-		portstatus = le16_to_cpu(portsts->wPortStatus);
-		portchange = le16_to_cpu(portsts->wPortChange);
+		/* Wait for the hub to say that the reset is over */
+		start = get_timer(0);
+		do {
+			mdelay(HUB_RESET_POLL);
+			if (usb_get_port_status(dev, port + 1, portsts) < 0) {
+				debug("get_port_status failed status %lX\n",
+				      dev->status);
+				return -1;
+			}
+			portstatus = le16_to_cpu(portsts->wPortStatus);
+			portchange = le16_to_cpu(portsts->wPortChange);
+		} while (!(portchange & USB_PORT_STAT_C_RESET) &&
+			 (portstatus & USB_PORT_STAT_RESET) &&
+			 get_timer(start) < HUB_RESET_TIMEOUT);
 
 		debug("portstatus %x, change %x, %s\n", portstatus, portchange,
 							portspeed(portstatus));
@@ -236,39 +295,15 @@ int hub_port_reset(struct udevice *dev, int port, unsigned short *portstat)
 }
 #endif
 
-int usb_hub_port_connect_change(struct usb_device *dev, int port)
+/*
+ * Reset a port on which a device is connected and set the device up. The
+ * connection must already have been debounced.
+ */
+static int usb_hub_port_configure(struct usb_device *dev, int port)
 {
-	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
 	unsigned short portstatus;
 	int ret, speed;
 
-	/* Check status */
-	ret = usb_get_port_status(dev, port + 1, portsts);
-	if (ret < 0) {
-		debug("get_port_status failed\n");
-		return ret;
-	}
-
-	portstatus = le16_to_cpu(portsts->wPortStatus);
-	debug("portstatus %x, change %x, %s\n",
-	      portstatus,
-	      le16_to_cpu(portsts->wPortChange),
-	      portspeed(portstatus));
-
-	/* Clear the connection change status */
-	usb_clear_port_feature(dev, port + 1, USB_PORT_FEAT_C_CONNECTION);
-
-	/* Disconnect any existing devices under this port */
-	if (((!(portstatus & USB_PORT_STAT_CONNECTION)) &&
-	     (!(portstatus & USB_PORT_STAT_ENABLE))) ||
-	    usb_device_has_child_on_port(dev, port)) {
-		debug("usb_disconnect(&hub->children[port]);\n");
-		/* Return now if nothing is connected */
-		if (!(portstatus & USB_PORT_STAT_CONNECTION))
-			return -ENOTCONN;
-	}
-	mdelay(200);
-
 	/* Reset the port */
 	ret = legacy_hub_port_reset(dev, port, &portstatus);
 	if (ret < 0) {
@@ -277,7 +312,7 @@ int usb_hub_port_connect_change(struct usb_device *dev, int port)
 		return ret;
 	}
 
-	mdelay(200);
+	mdelay(HUB_RESET_RECOVERY);
 
 	switch (portstatus & USB_PORT_STAT_SPEED_MASK) {
 	case USB_PORT_STAT_SUPER_SPEED:
@@ -327,6 +362,184 @@ int usb_hub_port_connect_change(struct usb_device *dev, int port)
 	return ret;
 }
 
+int usb_hub_port_connect_change(struct usb_device *dev, int port)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
+	unsigned short portstatus;
+	int ret;
+
+	/* Check status */
+	ret = usb_get_port_status(dev, port + 1, portsts);
+	if (ret < 0) {
+		debug("get_port_status failed\n");
+		return ret;
+	}
+
+	portstatus = le16_to_cpu(portsts->wPortStatus);
+	debug("portstatus %x, change %x, %s\n",
+	      portstatus,
+	      le16_to_cpu(portsts->wPortChange),
+	      portspeed(portstatus));
+
+	/* Clear the connection change status */
+	usb_clear_port_feature(dev, port + 1, USB_PORT_FEAT_C_CONNECTION);
+
+	/* Disconnect any existing devices under this port */
+	if (((!(portstatus & USB_PORT_STAT_CONNECTION)) &&
+	     (!(portstatus & USB_PORT_STAT_ENABLE))) ||
+	    usb_device_has_child_on_port(dev, port)) {
+		debug("usb_disconnect(&hub->children[port]);\n");
+		/* Return now if nothing is connected */
+		if (!(portstatus & USB_PORT_STAT_CONNECTION))
+			return -ENOTCONN;
+	}
+	/* Callers outside the hub scan have not debounced the connection */
+	mdelay(200);
+
+	return usb_hub_port_configure(dev, port);
+}
+
+/* Deal with the change bits left once a port has been scanned */
+static void usb_hub_port_changes(struct usb_device_scan *usb_scan,
+				 unsigned short portstatus,
+				 unsigned short portchange)
+{
+	struct usb_device *dev = usb_scan->dev;
+	int i = usb_scan->port;
+
+	if (portchange & USB_PORT_STAT_C_ENABLE) {
+		debug("port %d enable change, status %x\n", i + 1, portstatus);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_C_ENABLE);
+		/*
+		 * The following hack causes a ghost device problem
+		 * to Faraday EHCI
+		 */
+#ifndef CONFIG_USB_EHCI_FARADAY
+		/* EM interference sometimes causes bad shielded USB
+		 * devices to be shutdown by the hub, this hack enables
+		 * them again. Works at least with mouse driver */
+		if (!(portstatus & USB_PORT_STAT_ENABLE) &&
+		    (portstatus & USB_PORT_STAT_CONNECTION) &&
+		    usb_device_has_child_on_port(dev, i)) {
+			debug("already running port %i "  \
+			      "disabled by hub (EMI?), " \
+			      "re-enabling...\n", i + 1);
+			usb_hub_port_connect_change(dev, i);
+		}
+#endif
+	}
+	if (portstatus & USB_PORT_STAT_SUSPEND) {
+		debug("port %d suspend change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_SUSPEND);
+	}
+
+	if (portchange & USB_PORT_STAT_C_OVERCURRENT) {
+		debug("port %d over-current change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1,
+				       USB_PORT_FEAT_C_OVER_CURRENT);
+		usb_hub_power_on(usb_scan->hub);
+	}
+
+	if (portchange & USB_PORT_STAT_C_RESET) {
+		debug("port %d reset change\n", i + 1);
+		usb_clear_port_feature(dev, i + 1, USB_PORT_FEAT_C_RESET);
+	}
+}
+
+/*
+ * Take one look at a port. Once a device on it has debounced, it is set up
+ * and the port is dropped from the list, as it is if nothing connects
+ * before its deadline.
+ *
+ * @return true if the port is finished with
+ */
+static bool usb_scan_port(struct usb_device_scan *usb_scan)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
+	struct usb_device *dev = usb_scan->dev;
+	unsigned short portstatus, portchange;
+	int i = usb_scan->port;
+	ulong now = get_timer(0);
+
+	/* Don't talk to the port until its power is good */
+	if (now < usb_scan->hub->query_delay)
+		return false;
+
+	if (usb_get_port_status(dev, i + 1, portsts) < 0) {
+		debug("get_port_status failed\n");
+		return now >= usb_scan->deadline;
+	}
+	portstatus = le16_to_cpu(portsts->wPortStatus);
+	portchange = le16_to_cpu(portsts->wPortChange);
+
+	if (!(portstatus & USB_PORT_STAT_CONNECTION)) {
+		/* Nothing there yet, or it has gone again */
+		usb_scan->connected = false;
+		if (now < usb_scan->deadline)
+			return false;
+		debug("devnum=%d port=%d: timeout\n", dev->devnum, i + 1);
+		if (portchange & USB_PORT_STAT_C_CONNECTION)
+			usb_clear_port_feature(dev, i + 1,
+					       USB_PORT_FEAT_C_CONNECTION);
+		usb_hub_port_changes(usb_scan, portstatus, portchange);
+		return true;
+	}
+
+	/* Start the debounce timer again on every connection change */
+	if (!usb_scan->connected || (portchange & USB_PORT_STAT_C_CONNECTION)) {
+		if (portchange & USB_PORT_STAT_C_CONNECTION)
+			usb_clear_port_feature(dev, i + 1,
+					       USB_PORT_FEAT_C_CONNECTION);
+		if (!usb_scan->connected)
+			usb_scan->deadline = now + HUB_DEBOUNCE_TIMEOUT;
+		usb_scan->connected = true;
+		usb_scan->stable_since = now;
+	}
+
+	if (now - usb_scan->stable_since < HUB_DEBOUNCE_STABLE) {
+		if (now < usb_scan->deadline)
+			return false;
+		debug("devnum=%d port=%d: connection not stable\n",
+		      dev->devnum, i + 1);
+		return true;
+	}
+
+	debug("devnum=%d port=%d: Port %d Status %X Change %X\n",
+	      dev->devnum, i + 1, i + 1, portstatus, portchange);
+	usb_hub_port_configure(dev, i);
+	usb_hub_port_changes(usb_scan, portstatus,
+			     portchange & ~USB_PORT_STAT_C_CONNECTION);
+
+	return true;
+}
+
+/*
+ * Poll all the ports on the list until each has a device set up or has
+ * timed out. Hubs found along the way add their ports to the list while
+ * this runs, so only the outermost call does the scanning.
+ */
+static int usb_device_list_scan(void)
+{
+	struct usb_device_scan *usb_scan, *tmp;
+	static int running;
+
+	if (running)
+		return 0;
+	running = 1;
+
+	while (!list_empty(&usb_scan_list)) {
+		list_for_each_entry_safe(usb_scan, tmp, &usb_scan_list, list) {
+			if (usb_scan_port(usb_scan)) {
+				list_del(&usb_scan->list);
+				free(usb_scan);
+			}
+		}
+	}
+
+	running = 0;
+
+	return 0;
+}
 
 static int usb_hub_configure(struct usb_device *dev)
 {
@@ -461,99 +674,26 @@ static int usb_hub_configure(struct usb_device *dev)
 	for (i = 0; i < dev->maxchild; i++)
 		usb_hub_reset_devices(i + 1);
 
+	/*
+	 * Add the ports to the list of those being scanned, and scan them
+	 * along with the ports of any other hubs which are still settling.
+	 */
 	for (i = 0; i < dev->maxchild; i++) {
-		ALLOC_CACHE_ALIGN_BUFFER(struct usb_port_status, portsts, 1);
-		unsigned short portstatus, portchange;
-		int ret;
-		ulong start = get_timer(0);
-
-#ifdef CONFIG_DM_USB
-		debug("\n\nScanning '%s' port %d\n", dev->dev->name, i + 1);
-#else
-		debug("\n\nScanning port %d\n", i + 1);
-#endif
-		/*
-		 * Wait for (whichever finishes first)
-		 *  - A maximum of 10 seconds
-		 *    This is a purely observational value driven by connecting
-		 *    a few broken pen drives and taking the max * 1.5 approach
-		 *  - connection_change and connection state to report same
-		 *    state
-		 */
-		do {
-			ret = usb_get_port_status(dev, i + 1, portsts);
-			if (ret < 0) {
-				debug("get_port_status failed\n");
-				break;
-			}
-
-			portstatus = le16_to_cpu(portsts->wPortStatus);
-			portchange = le16_to_cpu(portsts->wPortChange);
+		struct usb_device_scan *usb_scan;
 
-			/* No connection change happened, wait a bit more. */
-			if (!(portchange & USB_PORT_STAT_C_CONNECTION))
-				continue;
-
-			/* Test if the connection came up, and if so, exit. */
-			if (portstatus & USB_PORT_STAT_CONNECTION)
-				break;
-
-		} while (get_timer(start) < CONFIG_SYS_HZ * 1);
-
-		if (ret < 0)
-			continue;
-
-		debug("Port %d Status %X Change %X\n",
-		      i + 1, portstatus, portchange);
-
-		if (portchange & USB_PORT_STAT_C_CONNECTION) {
-			debug("port %d connection change\n", i + 1);
-			usb_hub_port_connect_change(dev, i);
-		}
-		if (portchange & USB_PORT_STAT_C_ENABLE) {
-			debug("port %d enable change, status %x\n",
-			      i + 1, portstatus);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_ENABLE);
-			/*
-			 * The following hack causes a ghost device problem
-			 * to Faraday EHCI
-			 */
-#ifndef CONFIG_USB_EHCI_FARADAY
-			/* EM interference sometimes causes bad shielded USB
-			 * devices to be shutdown by the hub, this hack enables
-			 * them again. Works at least with mouse driver */
-			if (!(portstatus & USB_PORT_STAT_ENABLE) &&
-			     (portstatus & USB_PORT_STAT_CONNECTION) &&
-			     usb_device_has_child_on_port(dev, i)) {
-				debug("already running port %i "  \
-				      "disabled by hub (EMI?), " \
-				      "re-enabling...\n", i + 1);
-				      usb_hub_port_connect_change(dev, i);
-			}
-#endif
+		usb_scan = calloc(1, sizeof(*usb_scan));
+		if (!usb_scan) {
+			printf("Can't allocate memory for USB device!\n");
+			return -ENOMEM;
 		}
-		if (portstatus & USB_PORT_STAT_SUSPEND) {
-			debug("port %d suspend change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_SUSPEND);
-		}
-
-		if (portchange & USB_PORT_STAT_C_OVERCURRENT) {
-			debug("port %d over-current change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_OVER_CURRENT);
-			usb_hub_power_on(hub);
-		}
-
-		if (portchange & USB_PORT_STAT_C_RESET) {
-			debug("port %d reset change\n", i + 1);
-			usb_clear_port_feature(dev, i + 1,
-						USB_PORT_FEAT_C_RESET);
-		}
-	} /* end for i all ports */
+		usb_scan->dev = dev;
+		usb_scan->hub = hub;
+		usb_scan->port = i;
+		usb_scan->deadline = hub->connect_timeout;
+		list_add_tail(&usb_scan->list, &usb_scan_list);
+	}
 
-	return 0;
+	return usb_device_list_scan();
 }
 
 static int usb_hub_check(struct usb_device *dev, int ifnum)
@@ -191,6 +191,7 @@ static int usb_stor_probe_device(struct usb_device *dev)
 			struct block_dev_desc *blkdev;
 
 			blkdev = &usb_dev_desc[usb_max_devs];
+			blkcache_invalidate(IF_TYPE_USB, usb_max_devs);
 			memset(blkdev, '\0', sizeof(block_dev_desc_t));
 			blkdev->if_type = IF_TYPE_USB;
 			blkdev->dev = usb_max_devs;
@@ -1051,6 +1052,10 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	}
 	ss = (struct us_data *)dev->privptr;
 
+	if (blkcache_read(IF_TYPE_USB, device, blknr, blkcnt,
+			  usb_dev_desc[device].blksz, buffer))
+		return blkcnt;
+
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 	srb->lun = usb_dev_desc[device].lun;
 	buf_addr = (uintptr_t)buffer;
@@ -1094,6 +1099,9 @@ retry_it:
 	usb_disable_asynch(0); /* asynch transfer allowed */
 	if (blkcnt >= USB_MAX_XFER_BLK)
 		debug("\n");
+	if (!blks)
+		blkcache_fill(IF_TYPE_USB, device, blknr, blkcnt,
+			      usb_dev_desc[device].blksz, buffer);
 	return blkcnt;
 }
 
@@ -1119,6 +1127,8 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		return 0;
 	ss = (struct us_data *)dev->privptr;
 
+	blkcache_invalidate(IF_TYPE_USB, device);
+
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
 	srb->lun = usb_dev_desc[device].lun;
@@ -20,6 +20,7 @@
 #include <libata.h>
 #include <linux/ctype.h>
 #include <ahci.h>
+#include <watchdog.h>
 
 static int ata_io_flush(u8 port);
 
@@ -29,20 +30,29 @@ u16 *ataid[AHCI_MAX_PORTS];
 #define writel_with_flush(a,b)	do { writel(a,b); readl(b); } while (0)
 
 /*
- * Some controllers limit number of blocks they can read/write at once.
- * Contemporary SSD devices work much faster if the read/write size is aligned
- * to a power of 2.  Let's set default to 128 and allowing to be overwritten if
- * needed.
+ * Some controllers limit number of blocks they can read/write at once, and
+ * may set this lower. Otherwise use the most an LBA48 command can carry.
  */
 #ifndef MAX_SATA_BLOCKS_READ_WRITE
-#define MAX_SATA_BLOCKS_READ_WRITE	0x80
+#define MAX_SATA_BLOCKS_READ_WRITE	0xffff
 #endif
 
+/*
+ * With NCQ, transfers are split into commands of this many blocks so that
+ * the drive always has several queued. Contemporary SSD devices work much
+ * faster if the read/write size is aligned to a power of 2.
+ */
+#define AHCI_NCQ_BLOCKS		min(0x800, MAX_SATA_BLOCKS_READ_WRITE)
+
+/* IDENTIFY word 76 (ATA_ID_SATA_CAP): device supports NCQ */
+#define ATA_ID_SATA_CAP_NCQ	(1 << 8)
+
 /* Maximum timeouts for each event */
 #define WAIT_MS_SPINUP	20000
 #define WAIT_MS_DATAIO	10000
 #define WAIT_MS_FLUSH	5000
 #define WAIT_MS_LINKUP	200
+#define MAX_COMINIT_RETRIES	5
 
 static inline void __iomem *ahci_port_base(void __iomem *base, u32 port)
 {
@@ -89,45 +99,46 @@ static void ahci_dcache_invalidate_range(unsigned long begin, unsigned long len)
  * Ensure data for SATA controller is flushed out of dcache and
  * written to physical memory.
  */
-static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp)
+static void ahci_dcache_flush_sata_cmd(struct ahci_ioports *pp, int tag)
 {
 	ahci_dcache_flush_range((unsigned long)pp->cmd_slot,
-				AHCI_PORT_PRIV_DMA_SZ);
+				AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT);
+	ahci_dcache_flush_range(pp->cmd_tbl + tag * AHCI_CMD_TBL_SZ,
+				AHCI_CMD_TBL_SZ);
 }
 
+/*
+ * Poll until the bits in @sign are clear, without sleeping in between, so
+ * that the next command can follow as soon as one is done
+ */
 static int waiting_for_cmd_completed(void __iomem *offset,
 				     int timeout_msec,
 				     u32 sign)
 {
-	int i;
-	u32 status;
+	ulong start = get_timer(0);
 
-	for (i = 0; ((status = readl(offset)) & sign) && i < timeout_msec; i++)
-		msleep(1);
+	while (readl(offset) & sign) {
+		if (get_timer(start) >= timeout_msec)
+			return -1;
+		WATCHDOG_RESET();
+	}
 
-	return (i < timeout_msec) ? 0 : -1;
+	return 0;
 }
 
+/*
+ * Check whether the SATA link on a port is up. This must not wait: the
+ * caller polls all ports together until each one is up or has taken
+ * WAIT_MS_LINKUP. Boards may override this to drive the PHY themselves.
+ */
 int __weak ahci_link_up(struct ahci_probe_ent *probe_ent, u8 port)
 {
-	u32 tmp;
-	int j = 0;
 	void __iomem *port_mmio = probe_ent->port[port].port_mmio;
+	u32 tmp;
 
-	/*
-	 * Bring up SATA link.
-	 * SATA link bringup time is usually less than 1 ms; only very
-	 * rarely has it taken between 1-2 ms. Never seen it above 2 ms.
-	 */
-	while (j < WAIT_MS_LINKUP) {
-		tmp = readl(port_mmio + PORT_SCR_STAT);
-		tmp &= PORT_SCR_STAT_DET_MASK;
-		if (tmp == PORT_SCR_STAT_DET_PHYRDY)
-			return 0;
-		udelay(1000);
-		j++;
-	}
-	return 1;
+	tmp = readl(port_mmio + PORT_SCR_STAT) & PORT_SCR_STAT_DET_MASK;
+
+	return tmp != PORT_SCR_STAT_DET_PHYRDY;
 }
 
 #ifdef CONFIG_SUNXI_AHCI
@@ -165,6 +176,78 @@ int ahci_reset(void __iomem *base)
 	return 0;
 }
 
+/* Clear the status left by link-up and register the port as usable */
+static void ahci_port_linked(struct ahci_probe_ent *probe_ent, int port)
+{
+	void __iomem *mmio = probe_ent->mmio_base;
+	void __iomem *port_mmio = probe_ent->port[port].port_mmio;
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_SCR_ERR);
+	debug("PORT_SCR_ERR 0x%x\n", tmp);
+	writel(tmp, port_mmio + PORT_SCR_ERR);
+
+	/* ack any pending irq events for this port */
+	tmp = readl(port_mmio + PORT_IRQ_STAT);
+	debug("PORT_IRQ_STAT 0x%x\n", tmp);
+	if (tmp)
+		writel(tmp, port_mmio + PORT_IRQ_STAT);
+
+	writel(1 << port, mmio + HOST_IRQ_STAT);
+
+	/* register linkup ports */
+	tmp = readl(port_mmio + PORT_SCR_STAT);
+	debug("SATA port %d status: 0x%x\n", port, tmp);
+	if ((tmp & PORT_SCR_STAT_DET_MASK) == PORT_SCR_STAT_DET_PHYRDY)
+		probe_ent->link_port_map |= (0x01 << port);
+}
+
+/* Add the spinup command to whatever mode bits are already set on a port */
+static void ahci_port_spin_up(struct ahci_probe_ent *probe_ent, int port)
+{
+	void __iomem *port_mmio = probe_ent->port[port].port_mmio;
+	u32 cmd;
+
+#ifdef CONFIG_SUNXI_AHCI
+	sunxi_dma_init(port_mmio);
+#endif
+
+	cmd = readl(port_mmio + PORT_CMD);
+	cmd |= PORT_CMD_SPIN_UP;
+	writel_with_flush(cmd, port_mmio + PORT_CMD);
+}
+
+/*
+ * Poll the ports in @pending together until each one's link is up or it
+ * has taken WAIT_MS_LINKUP from its entry in @start. Returns the ports
+ * whose link came up.
+ */
+static u32 ahci_wait_links(struct ahci_probe_ent *probe_ent, u32 pending,
+			   ulong *start)
+{
+	u32 linked = 0;
+	int i;
+
+	while (pending) {
+		for (i = 0; i < probe_ent->n_ports; i++) {
+			if (!(pending & (1 << i)))
+				continue;
+
+			if (!ahci_link_up(probe_ent, i)) {
+				debug("SATA link %d ok after %lu ms.\n", i,
+				      get_timer(start[i]));
+				pending &= ~(1 << i);
+				linked |= 1 << i;
+			} else if (get_timer(start[i]) >= WAIT_MS_LINKUP) {
+				printf("SATA link %d timeout.\n", i);
+				pending &= ~(1 << i);
+			}
+		}
+	}
+
+	return linked;
+}
+
 static int ahci_host_init(struct ahci_probe_ent *probe_ent)
 {
 #ifndef CONFIG_SCSI_AHCI_PLAT
@@ -173,10 +256,12 @@ static int ahci_host_init(struct ahci_probe_ent *probe_ent)
 	unsigned short vendor;
 #endif
 	void __iomem *mmio = probe_ent->mmio_base;
-	u32 tmp, cap_save, cmd;
-	int i, j, ret;
+	u32 tmp, cap_save;
+	int i, ret;
 	void __iomem *port_mmio;
-	u32 port_map;
+	u32 port_map, active = 0, pending = 0, linked;
+	ulong start[AHCI_MAX_PORTS];
+	int retries[AHCI_MAX_PORTS];
 
 	debug("ahci_host_init: start\n");
 
@@ -228,83 +313,63 @@ static int ahci_host_init(struct ahci_probe_ent *probe_ent)
 			tmp &= ~(PORT_CMD_LIST_ON | PORT_CMD_FIS_ON |
 				 PORT_CMD_FIS_RX | PORT_CMD_START);
 			writel_with_flush(tmp, port_mmio + PORT_CMD);
-
-			/* spec says 500 msecs for each bit, so
-			 * this is slightly incorrect.
-			 */
-			msleep(500);
+			active |= 1 << i;
 		}
+	}
 
-#ifdef CONFIG_SUNXI_AHCI
-		sunxi_dma_init(port_mmio);
-#endif
+	/* spec says 500 msecs for each bit, so
+	 * this is slightly incorrect.
+	 */
+	if (active)
+		msleep(500);
 
-		/* Add the spinup command to whatever mode bits may
-		 * already be on in the command register.
-		 */
-		cmd = readl(port_mmio + PORT_CMD);
-		cmd |= PORT_CMD_SPIN_UP;
-		writel_with_flush(cmd, port_mmio + PORT_CMD);
-
-		/* Bring up SATA link. */
-		ret = ahci_link_up(probe_ent, i);
-		if (ret) {
-			printf("SATA link %d timeout.\n", i);
+	/*
+	 * Spin up every port before waiting for any of them, so that the
+	 * links come up together and an empty port costs WAIT_MS_LINKUP
+	 * once rather than once per port.
+	 */
+	for (i = 0; i < probe_ent->n_ports; i++) {
+		if (!(port_map & (1 << i)))
 			continue;
-		} else {
-			debug("SATA link ok.\n");
-		}
-
-		/* Clear error status */
-		tmp = readl(port_mmio + PORT_SCR_ERR);
-		if (tmp)
-			writel(tmp, port_mmio + PORT_SCR_ERR);
+		ahci_port_spin_up(probe_ent, i);
+		start[i] = get_timer(0);
+		retries[i] = 0;
+		pending |= 1 << i;
+	}
 
-		debug("Spinning up device on SATA port %d... ", i);
+	while (pending) {
+		linked = ahci_wait_links(probe_ent, pending, start);
+		pending = 0;
 
-		j = 0;
-		while (j < WAIT_MS_SPINUP) {
-			tmp = readl(port_mmio + PORT_TFDATA);
-			if (!(tmp & (ATA_BUSY | ATA_DRQ)))
-				break;
+		/*
+		 * A device may drop the link again just after it comes up and
+		 * send COMINIT. Spin such ports up again and go back to
+		 * waiting for them, with a fresh timeout.
+		 */
+		if (linked)
 			udelay(1000);
+		for (i = 0; i < probe_ent->n_ports; i++) {
+			if (!(linked & (1 << i)))
+				continue;
+
+			port_mmio = probe_ent->port[i].port_mmio;
 			tmp = readl(port_mmio + PORT_SCR_STAT);
 			tmp &= PORT_SCR_STAT_DET_MASK;
-			if (tmp == PORT_SCR_STAT_DET_PHYRDY)
-				break;
-			j++;
-		}
-
-		tmp = readl(port_mmio + PORT_SCR_STAT) & PORT_SCR_STAT_DET_MASK;
-		if (tmp == PORT_SCR_STAT_DET_COMINIT) {
-			debug("SATA link %d down (COMINIT received), retrying...\n", i);
-			i--;
-			continue;
+			if (tmp == PORT_SCR_STAT_DET_COMINIT) {
+				if (retries[i] < MAX_COMINIT_RETRIES) {
+					debug("SATA link %d down (COMINIT received), retrying...\n",
+					      i);
+					retries[i]++;
+					ahci_port_spin_up(probe_ent, i);
+					start[i] = get_timer(0);
+					pending |= 1 << i;
+					continue;
+				}
+				printf("SATA link %d down (COMINIT received).\n",
+				       i);
+			}
+			ahci_port_linked(probe_ent, i);
 		}
-
-		printf("Target spinup took %d ms.\n", j);
-		if (j == WAIT_MS_SPINUP)
-			debug("timeout.\n");
-		else
-			debug("ok.\n");
-
-		tmp = readl(port_mmio + PORT_SCR_ERR);
-		debug("PORT_SCR_ERR 0x%x\n", tmp);
-		writel(tmp, port_mmio + PORT_SCR_ERR);
-
-		/* ack any pending irq events for this port */
-		tmp = readl(port_mmio + PORT_IRQ_STAT);
-		debug("PORT_IRQ_STAT 0x%x\n", tmp);
-		if (tmp)
-			writel(tmp, port_mmio + PORT_IRQ_STAT);
-
-		writel(1 << i, mmio + HOST_IRQ_STAT);
-
-		/* register linkup ports */
-		tmp = readl(port_mmio + PORT_SCR_STAT);
-		debug("SATA port %d status: 0x%x\n", i, tmp);
-		if ((tmp & PORT_SCR_STAT_DET_MASK) == PORT_SCR_STAT_DET_PHYRDY)
-			probe_ent->link_port_map |= (0x01 << i);
 	}
 
 	tmp = readl(mmio + HOST_CTL);
@@ -445,10 +510,11 @@ static int ahci_init_one(pci_dev_t pdev)
 
 #define MAX_DATA_BYTE_COUNT  (4*1024*1024)
 
-static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
+static int ahci_fill_sg(struct ahci_ioports *pp, int tag, unsigned char *buf,
+			int buf_len)
 {
-	struct ahci_ioports *pp = &(probe_ent->port[port]);
-	struct ahci_sg *ahci_sg = pp->cmd_tbl_sg;
+	struct ahci_sg *ahci_sg = (struct ahci_sg *)((ulong)pp->cmd_tbl_sg +
+						     tag * AHCI_CMD_TBL_SZ);
 	u32 sg_count;
 	int i;
 
@@ -474,14 +540,16 @@ static int ahci_fill_sg(u8 port, unsigned char *buf, int buf_len)
 }
 
 
-static void ahci_fill_cmd_slot(struct ahci_ioports *pp, u32 opts)
+static void ahci_fill_cmd_slot(struct ahci_ioports *pp, int tag, u32 opts)
 {
-	pp->cmd_slot->opts = cpu_to_le32(opts);
-	pp->cmd_slot->status = 0;
-	pp->cmd_slot->tbl_addr = cpu_to_le32((u32)pp->cmd_tbl & 0xffffffff);
+	struct ahci_cmd_hdr *cmd_slot = &pp->cmd_slot[tag];
+	ulong cmd_tbl = pp->cmd_tbl + tag * AHCI_CMD_TBL_SZ;
+
+	cmd_slot->opts = cpu_to_le32(opts);
+	cmd_slot->status = 0;
+	cmd_slot->tbl_addr = cpu_to_le32((u32)cmd_tbl & 0xffffffff);
 #ifdef CONFIG_PHYS_64BIT
-	pp->cmd_slot->tbl_addr_hi =
-	    cpu_to_le32((u32)(((pp->cmd_tbl) >> 16) >> 16));
+	cmd_slot->tbl_addr_hi = cpu_to_le32((u32)((cmd_tbl >> 16) >> 16));
 #endif
 }
 
@@ -503,8 +571,8 @@ static void ahci_set_feature(u8 port)
 	fis[12] = __ilog2(probe_ent->udma_mask + 1) + 0x40 - 0x01;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, sizeof(fis));
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel(1, port_mmio + PORT_CMD_ISSUE);
 	readl(port_mmio + PORT_CMD_ISSUE);
 
@@ -515,21 +583,6 @@ static void ahci_set_feature(u8 port)
 }
 #endif
 
-static int wait_spinup(void __iomem *port_mmio)
-{
-	ulong start;
-	u32 tf_data;
-
-	start = get_timer(0);
-	do {
-		tf_data = readl(port_mmio + PORT_TFDATA);
-		if (!(tf_data & ATA_BUSY))
-			return 0;
-	} while (get_timer(start) < WAIT_MS_SPINUP);
-
-	return -ETIMEDOUT;
-}
-
 static int ahci_port_start(u8 port)
 {
 	struct ahci_ioports *pp = &(probe_ent->port[port]);
@@ -545,16 +598,13 @@ static int ahci_port_start(u8 port)
 		return -1;
 	}
 
-	mem = malloc(AHCI_PORT_PRIV_DMA_SZ + 2048);
+	/* Aligned to 2048-bytes */
+	mem = memalign(2048, AHCI_PORT_PRIV_DMA_AR_SZ);
 	if (!mem) {
-		free(pp);
 		printf("%s: No mem for table!\n", __func__);
 		return -ENOMEM;
 	}
-
-	/* Aligned to 2048-bytes */
-	mem = memalign(2048, AHCI_PORT_PRIV_DMA_SZ);
-	memset(mem, 0, AHCI_PORT_PRIV_DMA_SZ);
+	memset(mem, 0, AHCI_PORT_PRIV_DMA_AR_SZ);
 
 	/*
 	 * First item in chunk of DMA memory: 32-slot command table,
@@ -563,7 +613,7 @@ static int ahci_port_start(u8 port)
 	pp->cmd_slot =
 		(struct ahci_cmd_hdr *)(uintptr_t)virt_to_phys((void *)mem);
 	debug("cmd_slot = %p\n", pp->cmd_slot);
-	mem += (AHCI_CMD_SLOT_SZ + 224);
+	mem += AHCI_CMD_SLOT_SZ * AHCI_MAX_CMD_SLOT;
 
 	/*
 	 * Second item: Received-FIS area
@@ -572,8 +622,8 @@ static int ahci_port_start(u8 port)
 	mem += AHCI_RX_FIS_SZ;
 
 	/*
-	 * Third item: data area for storing a single command
-	 * and its scatter-gather table
+	 * Third item: data area for storing a command and its
+	 * scatter-gather table, for each slot in turn
 	 */
 	pp->cmd_tbl = virt_to_phys((void *)mem);
 	debug("cmd_tbl_dma = %lx\n", pp->cmd_tbl);
@@ -597,11 +647,56 @@ static int ahci_port_start(u8 port)
 
 	debug("Exit start port %d\n", port);
 
-	/*
-	 * Make sure interface is not busy based on error and status
-	 * information from task file data register before proceeding
-	 */
-	return wait_spinup(port_mmio);
+	return 0;
+}
+
+/*
+ * Start every linked-up port, then wait for all their devices to spin up
+ * together. Each port gets WAIT_MS_SPINUP from the time it was started,
+ * and is usable once the task file no longer shows it busy.
+ */
+static void ahci_start_ports(u32 linkmap)
+{
+	ulong start[AHCI_MAX_PORTS];
+	struct ahci_ioports *pp;
+	u32 pending = 0;
+	ulong ms;
+	int i;
+
+	for (i = 0; i < CONFIG_SYS_SCSI_MAX_SCSI_ID; i++) {
+		if (((linkmap >> i) & 0x01)) {
+			if (ahci_port_start((u8) i)) {
+				printf("Can not start port %d\n", i);
+				continue;
+			}
+			start[i] = get_timer(0);
+			pending |= 1 << i;
+		}
+	}
+
+	while (pending) {
+		for (i = 0; i < CONFIG_SYS_SCSI_MAX_SCSI_ID; i++) {
+			if (!(pending & (1 << i)))
+				continue;
+
+			pp = &probe_ent->port[i];
+			ms = get_timer(start[i]);
+			if (!(readl(pp->port_mmio + PORT_TFDATA) & ATA_BUSY)) {
+				pending &= ~(1 << i);
+				snprintf(pp->name, sizeof(pp->name),
+					 "ahci_port%d", i);
+				bootstage_mark_name(BOOTSTAGE_ID_ALLOC,
+						    pp->name);
+				printf("Target %d spinup took %lu ms.\n", i, ms);
+#ifdef CONFIG_AHCI_SETFEATURES_XFER
+				ahci_set_feature((u8) i);
+#endif
+			} else if (ms >= WAIT_MS_SPINUP) {
+				pending &= ~(1 << i);
+				printf("Can not start port %d\n", i);
+			}
+		}
+	}
 }
 
 
@@ -630,11 +725,11 @@ static int ahci_device_data_io(u8 port, u8 *fis, int fis_len, u8 *buf,
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, fis_len);
 
-	sg_count = ahci_fill_sg(port, buf, buf_len);
+	sg_count = ahci_fill_sg(pp, 0, buf, buf_len);
 	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
-	ahci_fill_cmd_slot(pp, opts);
+	ahci_fill_cmd_slot(pp, 0, opts);
 
-	ahci_dcache_flush_sata_cmd(pp);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	ahci_dcache_flush_range((unsigned long)buf, (unsigned long)buf_len);
 
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
@@ -652,6 +747,228 @@ static int ahci_device_data_io(u8 port, u8 *fis, int fis_len, u8 *buf,
 	return 0;
 }
 
+/*
+ * Put a data command in slot @tag and hand it to the controller. A queued
+ * (NCQ) command is marked in PxSACT as well, and is finished when the
+ * drive clears that bit.
+ */
+static int ahci_issue_cmd(struct ahci_ioports *pp, int tag, u8 *fis,
+			  int fis_len, u8 *buf, int buf_len, u8 is_write,
+			  bool ncq)
+{
+	void __iomem *port_mmio = pp->port_mmio;
+	int sg_count;
+	u32 opts;
+
+	memcpy((unsigned char *)(pp->cmd_tbl + tag * AHCI_CMD_TBL_SZ), fis,
+	       fis_len);
+
+	sg_count = ahci_fill_sg(pp, tag, buf, buf_len);
+	if (sg_count < 0)
+		return -EINVAL;
+	opts = (fis_len >> 2) | (sg_count << 16) | (is_write << 6);
+	ahci_fill_cmd_slot(pp, tag, opts);
+	ahci_dcache_flush_sata_cmd(pp, tag);
+
+	if (ncq)
+		writel(1 << tag, port_mmio + PORT_SCR_ACT);
+	writel_with_flush(1 << tag, port_mmio + PORT_CMD_ISSUE);
+
+	return 0;
+}
+
+/*
+ * Stop and restart the port's command list engine. This drops all
+ * outstanding commands so that new ones can be issued.
+ */
+static void ahci_port_restart(struct ahci_ioports *pp)
+{
+	void __iomem *port_mmio = pp->port_mmio;
+	u32 tmp;
+
+	tmp = readl(port_mmio + PORT_CMD) & ~PORT_CMD_START;
+	writel_with_flush(tmp, port_mmio + PORT_CMD);
+	if (waiting_for_cmd_completed(port_mmio + PORT_CMD, 500,
+				      PORT_CMD_LIST_ON))
+		debug("%s: command list engine did not stop\n", __func__);
+
+	writel(readl(port_mmio + PORT_SCR_ERR), port_mmio + PORT_SCR_ERR);
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	/* Clear BSY and DRQ left by the failed command, if we can */
+	if ((readl(port_mmio + PORT_TFDATA) & (ATA_BUSY | ATA_DRQ)) &&
+	    (probe_ent->cap & (1 << 24))) {
+		writel_with_flush(tmp | PORT_CMD_CLO, port_mmio + PORT_CMD);
+		waiting_for_cmd_completed(port_mmio + PORT_CMD, 500,
+					  PORT_CMD_CLO);
+	}
+
+	writel_with_flush(tmp | PORT_CMD_START, port_mmio + PORT_CMD);
+}
+
+/*
+ * Read the NCQ command error log, which a drive requires after a queued
+ * command fails before it takes any more commands
+ */
+static int ahci_read_ncq_log(u8 port)
+{
+	struct ahci_ioports *pp = &probe_ent->port[port];
+	ALLOC_CACHE_ALIGN_BUFFER(u8, log, ATA_SECT_SIZE);
+	u8 fis[20];
+
+	memset(fis, 0, sizeof(fis));
+	fis[0] = 0x27;		/* Host to device FIS. */
+	fis[1] = 1 << 7;	/* Command FIS. */
+	fis[2] = ATA_CMD_READ_LOG_EXT;
+	fis[4] = ATA_LOG_SATA_NCQ;
+	fis[12] = 1;		/* one page */
+
+	if (ahci_device_data_io(port, fis, sizeof(fis), log, ATA_SECT_SIZE,
+				0) ||
+	    (readl(pp->port_mmio + PORT_TFDATA) & ATA_ERR))
+		return -EIO;
+
+	if (!(log[0] & 0x80))
+		debug("%s: queued command %d failed, status %x error %x\n",
+		      __func__, log[0] & 0x1f, log[2], log[3]);
+
+	return 0;
+}
+
+/*
+ * After an error, restart the port so that new commands can be issued.
+ * If NCQ was in use the drive also needs its NCQ error log read; if that
+ * does not work either, NCQ is turned off for the port.
+ */
+static void ahci_port_recover(u8 port, bool ncq)
+{
+	struct ahci_ioports *pp = &probe_ent->port[port];
+
+	ahci_port_restart(pp);
+	if (ncq && ahci_read_ncq_log(port)) {
+		printf("scsi_ahci: turning off NCQ on port %d\n", port);
+		pp->ncq_depth = 0;
+		ahci_port_restart(pp);
+	}
+}
+
+/* Set up the FIS to read or write blocks, queued if @tag is not -1 */
+static void ahci_rw_fis(u8 *fis, lbaint_t lba, u32 blocks, u8 is_write,
+			int tag)
+{
+	memset(fis, 0, 20);
+	fis[0] = 0x27;		 /* Host to device FIS. */
+	fis[1] = 1 << 7;	 /* Command FIS. */
+
+	/*
+	 * LBA48 SATA command but only use 32bit address range within
+	 * that (unless we've enabled 64bit LBA support). The next
+	 * smaller command range (28bit) is too small.
+	 */
+	fis[4] = (lba >> 0) & 0xff;
+	fis[5] = (lba >> 8) & 0xff;
+	fis[6] = (lba >> 16) & 0xff;
+	fis[7] = 1 << 6; /* device reg: set LBA mode */
+	fis[8] = ((lba >> 24) & 0xff);
+#ifdef CONFIG_SYS_64BIT_LBA
+	fis[9] = ((lba >> 32) & 0xff);
+	fis[10] = ((lba >> 40) & 0xff);
+#endif
+
+	if (tag >= 0) {
+		fis[2] = is_write ? ATA_CMD_FPDMA_WRITE : ATA_CMD_FPDMA_READ;
+		/* The block count goes in the features, the tag in count */
+		fis[3] = (blocks >> 0) & 0xff;
+		fis[11] = (blocks >> 8) & 0xff;
+		fis[12] = tag << 3;
+	} else {
+		fis[2] = is_write ? ATA_CMD_WRITE_EXT : ATA_CMD_READ_EXT;
+		fis[3] = 0xe0; /* features */
+
+		/* Block (sector) count */
+		fis[12] = (blocks >> 0) & 0xff;
+		fis[13] = (blocks >> 8) & 0xff;
+	}
+}
+
+/*
+ * Read or write blocks, split into as many commands as needed. With NCQ
+ * every slot the drive can take is kept busy, a new command going out as
+ * soon as one finishes; otherwise the commands go one at a time.
+ */
+static int ahci_rw_blocks(u8 port, lbaint_t lba, u32 blocks, u8 *buf,
+			  u8 is_write)
+{
+	struct ahci_ioports *pp = &(probe_ent->port[port]);
+	void __iomem *port_mmio = pp->port_mmio;
+	bool ncq = pp->ncq_depth > 0;
+	int depth = ncq ? pp->ncq_depth : 1;
+	u32 max_blocks = ncq ? AHCI_NCQ_BLOCKS : MAX_SATA_BLOCKS_READ_WRITE;
+	ulong len = (ulong)blocks * ATA_SECT_SIZE;
+	u8 *user_buffer = buf;
+	u32 busy = 0, done;
+	ulong start;
+	u8 fis[20];
+	int tag;
+
+	if ((readl(port_mmio + PORT_SCR_STAT) & 0xf) != 0x03) {
+		debug("No Link on port %d!\n", port);
+		return -EIO;
+	}
+
+	ahci_dcache_flush_range((unsigned long)buf, len);
+
+	/* Clear old status so that only errors from these commands show */
+	writel(readl(port_mmio + PORT_IRQ_STAT), port_mmio + PORT_IRQ_STAT);
+
+	start = get_timer(0);
+	while (blocks || busy) {
+		WATCHDOG_RESET();
+		for (tag = 0; tag < depth && blocks; tag++) {
+			u32 now_blocks = min(blocks, max_blocks);
+
+			if (busy & (1 << tag))
+				continue;
+			ahci_rw_fis(fis, lba, now_blocks, is_write,
+				    ncq ? tag : -1);
+			if (ahci_issue_cmd(pp, tag, fis, sizeof(fis), buf,
+					   now_blocks * ATA_SECT_SIZE,
+					   is_write, ncq))
+				goto err;
+			busy |= 1 << tag;
+			buf += now_blocks * ATA_SECT_SIZE;
+			lba += now_blocks;
+			blocks -= now_blocks;
+		}
+
+		done = busy & ~readl(port_mmio +
+				     (ncq ? PORT_SCR_ACT : PORT_CMD_ISSUE));
+		if (done) {
+			busy &= ~done;
+			start = get_timer(0);
+			continue;
+		}
+		if (readl(port_mmio + PORT_IRQ_STAT) & (PORT_IRQ_FATAL)) {
+			printf("scsi_ahci: error on port %d, status %x\n",
+			       port, readl(port_mmio + PORT_TFDATA));
+			goto err;
+		}
+		if (get_timer(start) >= WAIT_MS_DATAIO) {
+			printf("timeout exit!\n");
+			goto err;
+		}
+	}
+
+	if (!is_write)
+		ahci_dcache_invalidate_range((unsigned long)user_buffer, len);
+
+	return 0;
+
+err:
+	ahci_port_recover(port, ncq);
+	return -EIO;
+}
+
 
 static char *ata_id_strcpy(u16 *target, u16 *src, int len)
 {
@@ -714,6 +1031,17 @@ static int ata_scsiop_inquiry(ccb *pccb)
 	memcpy(idbuf, tmpid, ATA_ID_WORDS * 2);
 	ata_swap_buf_le16(idbuf, ATA_ID_WORDS);
 
+	/* Queue commands if both the controller and the drive can */
+	probe_ent->port[port].ncq_depth = 0;
+	if ((probe_ent->cap & HOST_CAP_NCQ) &&
+	    (idbuf[ATA_ID_SATA_CAP] & ATA_ID_SATA_CAP_NCQ)) {
+		probe_ent->port[port].ncq_depth =
+			min_t(int, HOST_CAP_NCS(probe_ent->cap),
+			      (idbuf[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1);
+	}
+	debug("scsi_ahci: port %d NCQ depth %d\n", port,
+	      probe_ent->port[port].ncq_depth);
+
 	memcpy(&pccb->pdata[8], "ATA     ", 8);
 	ata_id_strcpy((u16 *)&pccb->pdata[16], &idbuf[ATA_ID_PROD], 16);
 	ata_id_strcpy((u16 *)&pccb->pdata[32], &idbuf[ATA_ID_FW_REV], 4);
@@ -732,7 +1060,6 @@ static int ata_scsiop_read_write(ccb *pccb, u8 is_write)
 {
 	lbaint_t lba = 0;
 	u16 blocks = 0;
-	u8 fis[20];
 	u8 *user_buffer = pccb->pdata;
 	u32 user_buffer_size = pccb->datalen;
 
@@ -765,71 +1092,28 @@ static int ata_scsiop_read_write(ccb *pccb, u8 is_write)
 	debug("scsi_ahci: %s %u blocks starting from lba 0x" LBAFU "\n",
 	      is_write ?  "write" : "read", blocks, lba);
 
-	/* Preset the FIS */
-	memset(fis, 0, sizeof(fis));
-	fis[0] = 0x27;		 /* Host to device FIS. */
-	fis[1] = 1 << 7;	 /* Command FIS. */
-	/* Command byte (read/write). */
-	fis[2] = is_write ? ATA_CMD_WRITE_EXT : ATA_CMD_READ_EXT;
-
-	while (blocks) {
-		u16 now_blocks; /* number of blocks per iteration */
-		u32 transfer_size; /* number of bytes per iteration */
-
-		now_blocks = min((u16)MAX_SATA_BLOCKS_READ_WRITE, blocks);
-
-		transfer_size = ATA_SECT_SIZE * now_blocks;
-		if (transfer_size > user_buffer_size) {
-			printf("scsi_ahci: Error: buffer too small.\n");
-			return -EIO;
-		}
-
-		/*
-		 * LBA48 SATA command but only use 32bit address range within
-		 * that (unless we've enabled 64bit LBA support). The next
-		 * smaller command range (28bit) is too small.
-		 */
-		fis[4] = (lba >> 0) & 0xff;
-		fis[5] = (lba >> 8) & 0xff;
-		fis[6] = (lba >> 16) & 0xff;
-		fis[7] = 1 << 6; /* device reg: set LBA mode */
-		fis[8] = ((lba >> 24) & 0xff);
-#ifdef CONFIG_SYS_64BIT_LBA
-		if (pccb->cmd[0] == SCSI_READ16) {
-			fis[9] = ((lba >> 32) & 0xff);
-			fis[10] = ((lba >> 40) & 0xff);
-		}
-#endif
+	if (ATA_SECT_SIZE * blocks > user_buffer_size) {
+		printf("scsi_ahci: Error: buffer too small.\n");
+		return -EIO;
+	}
 
-		fis[3] = 0xe0; /* features */
+	/* Read/Write from ahci */
+	if (ahci_rw_blocks(pccb->target, lba, blocks, user_buffer,
+			   is_write)) {
+		debug("scsi_ahci: SCSI %s10 command failure.\n",
+		      is_write ? "WRITE" : "READ");
+		return -EIO;
+	}
 
-		/* Block (sector) count */
-		fis[12] = (now_blocks >> 0) & 0xff;
-		fis[13] = (now_blocks >> 8) & 0xff;
-
-		/* Read/Write from ahci */
-		if (ahci_device_data_io(pccb->target, (u8 *) &fis, sizeof(fis),
-					user_buffer, transfer_size,
-					is_write)) {
-			debug("scsi_ahci: SCSI %s10 command failure.\n",
-			      is_write ? "WRITE" : "READ");
+	/* If this transaction is a write, do a following flush.
+	 * Writes in u-boot are so rare, and the logic to know when is
+	 * the last write and do a flush only there is sufficiently
+	 * difficult. Just do a flush after every write. This incurs,
+	 * usually, one extra flush when the rare writes do happen.
+	 */
+	if (is_write) {
+		if (-EIO == ata_io_flush(pccb->target))
 			return -EIO;
-		}
-
-		/* If this transaction is a write, do a following flush.
-		 * Writes in u-boot are so rare, and the logic to know when is
-		 * the last write and do a flush only there is sufficiently
-		 * difficult. Just do a flush after every write. This incurs,
-		 * usually, one extra flush when the rare writes do happen.
-		 */
-		if (is_write) {
-			if (-EIO == ata_io_flush(pccb->target))
-				return -EIO;
-		}
-		user_buffer += transfer_size;
-		user_buffer_size -= transfer_size;
-		blocks -= now_blocks;
-		lba += now_blocks;
 	}
 
 	return 0;
@@ -941,33 +1225,17 @@ int scsi_exec(ccb *pccb)
 
 void scsi_low_level_init(int busdevfunc)
 {
-	int i;
-	u32 linkmap;
-
 #ifndef CONFIG_SCSI_AHCI_PLAT
 	ahci_init_one(busdevfunc);
 #endif
 
-	linkmap = probe_ent->link_port_map;
-
-	for (i = 0; i < CONFIG_SYS_SCSI_MAX_SCSI_ID; i++) {
-		if (((linkmap >> i) & 0x01)) {
-			if (ahci_port_start((u8) i)) {
-				printf("Can not start port %d\n", i);
-				continue;
-			}
-#ifdef CONFIG_AHCI_SETFEATURES_XFER
-			ahci_set_feature((u8) i);
-#endif
-		}
-	}
+	ahci_start_ports(probe_ent->link_port_map);
 }
 
 #ifdef CONFIG_SCSI_AHCI_PLAT
 int ahci_init(void __iomem *base)
 {
-	int i, rc = 0;
-	u32 linkmap;
+	int rc = 0;
 
 	probe_ent = malloc(sizeof(struct ahci_probe_ent));
 	if (!probe_ent) {
@@ -994,19 +1262,7 @@ int ahci_init(void __iomem *base)
 
 	ahci_print_info(probe_ent);
 
-	linkmap = probe_ent->link_port_map;
-
-	for (i = 0; i < CONFIG_SYS_SCSI_MAX_SCSI_ID; i++) {
-		if (((linkmap >> i) & 0x01)) {
-			if (ahci_port_start((u8) i)) {
-				printf("Can not start port %d\n", i);
-				continue;
-			}
-#ifdef CONFIG_AHCI_SETFEATURES_XFER
-			ahci_set_feature((u8) i);
-#endif
-		}
-	}
+	ahci_start_ports(probe_ent->link_port_map);
 err_out:
 	return rc;
 }
@@ -1040,7 +1296,8 @@ static int ata_io_flush(u8 port)
 	fis[2] = ATA_CMD_FLUSH_EXT;
 
 	memcpy((unsigned char *)pp->cmd_tbl, fis, 20);
-	ahci_fill_cmd_slot(pp, cmd_fis_len);
+	ahci_fill_cmd_slot(pp, 0, cmd_fis_len);
+	ahci_dcache_flush_sata_cmd(pp, 0);
 	writel_with_flush(1, port_mmio + PORT_CMD_ISSUE);
 
 	if (waiting_for_cmd_completed(port_mmio + PORT_CMD_ISSUE,
@@ -0,0 +1,163 @@
+/*
+ * LRU cache of recently read blocks, sitting between the block device
+ * drivers and the filesystem/partition code.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <linux/ctype.h>
+#include <linux/list.h>
+
+struct block_cache_node {
+	struct list_head lh;
+	int if_type;
+	int dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	unsigned long blksz;
+	char *cache;
+};
+
+static LIST_HEAD(block_cache);
+
+static struct block_cache_stats _stats = {
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_MAX_ENTRIES,
+};
+
+static struct block_cache_node *cache_find(int if_type, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry(node, &block_cache, lh)
+		if (node->if_type == if_type && node->dev == dev &&
+		    node->blksz == blksz && node->start <= start &&
+		    node->start + node->blkcnt >= start + blkcnt) {
+			/* Move to the front of the list to keep LRU order */
+			if (block_cache.next != &node->lh) {
+				list_del(&node->lh);
+				list_add(&node->lh, &block_cache);
+			}
+			return node;
+		}
+
+	return NULL;
+}
+
+int blkcache_read(int if_type, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer)
+{
+	struct block_cache_node *node;
+
+	node = cache_find(if_type, dev, start, blkcnt, blksz);
+	if (node) {
+		const char *src = node->cache + (start - node->start) * blksz;
+
+		memcpy(buffer, src, blksz * blkcnt);
+		debug("hit: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+		++_stats.hits;
+		return 1;
+	}
+
+	debug("miss: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+	++_stats.misses;
+
+	return 0;
+}
+
+void blkcache_fill(int if_type, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer)
+{
+	size_t bytes = blksz * blkcnt;
+	struct block_cache_node *node;
+
+	/* Don't cache big stuff */
+	if (blkcnt > _stats.max_blocks_per_entry || !_stats.max_entries)
+		return;
+
+	/* Reuse the least-recently-used entry if the cache is full */
+	if (_stats.entries >= _stats.max_entries) {
+		node = list_entry(block_cache.prev, struct block_cache_node,
+				  lh);
+		list_del(&node->lh);
+		_stats.entries--;
+		debug("drop: start " LBAF ", count " LBAFU "\n", node->start,
+		      node->blkcnt);
+		if (node->blkcnt * node->blksz < bytes) {
+			free(node->cache);
+			node->cache = NULL;
+		}
+	} else {
+		node = malloc(sizeof(*node));
+		if (!node)
+			return;
+		node->cache = NULL;
+	}
+
+	if (!node->cache) {
+		node->cache = malloc(bytes);
+		if (!node->cache) {
+			free(node);
+			return;
+		}
+	}
+
+	debug("fill: start " LBAF ", count " LBAFU "\n", start, blkcnt);
+
+	node->if_type = if_type;
+	node->dev = dev;
+	node->start = start;
+	node->blkcnt = blkcnt;
+	node->blksz = blksz;
+	memcpy(node->cache, buffer, bytes);
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+}
+
+void blkcache_invalidate(int if_type, int dev)
+{
+	struct block_cache_node *node, *next;
+
+	list_for_each_entry_safe(node, next, &block_cache, lh) {
+		if (node->if_type == if_type && node->dev == dev) {
+			list_del(&node->lh);
+			free(node->cache);
+			free(node);
+			--_stats.entries;
+		}
+	}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries)
+{
+	struct block_cache_node *node, *next;
+
+	if (blocks != _stats.max_blocks_per_entry ||
+	    entries != _stats.max_entries) {
+		/* Invalidate the whole cache */
+		list_for_each_entry_safe(node, next, &block_cache, lh) {
+			list_del(&node->lh);
+			free(node->cache);
+			free(node);
+		}
+		_stats.entries = 0;
+	}
+
+	_stats.max_blocks_per_entry = blocks;
+	_stats.max_entries = entries;
+
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
+
+void blkcache_stats(struct block_cache_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
@@ -29,6 +29,9 @@ static unsigned long host_block_read(int dev, unsigned long start,
 
 	if (!host_dev)
 		return -1;
+	if (blkcache_read(IF_TYPE_HOST, dev, start, blkcnt,
+			  host_dev->blk_dev.blksz, buffer))
+		return blkcnt;
 	if (os_lseek(host_dev->fd,
 		     start * host_dev->blk_dev.blksz,
 		     OS_SEEK_SET) == -1) {
@@ -37,6 +40,9 @@ static unsigned long host_block_read(int dev, unsigned long start,
 	}
 	ssize_t len = os_read(host_dev->fd, buffer,
 			      blkcnt * host_dev->blk_dev.blksz);
+	if (len == blkcnt * host_dev->blk_dev.blksz)
+		blkcache_fill(IF_TYPE_HOST, dev, start, blkcnt,
+			      host_dev->blk_dev.blksz, buffer);
 	if (len >= 0)
 		return len / host_dev->blk_dev.blksz;
 	return -1;
@@ -46,6 +52,8 @@ static unsigned long host_block_write(int dev, unsigned long start,
 				      lbaint_t blkcnt, const void *buffer)
 {
 	struct host_block_dev *host_dev = find_host_device(dev);
+
+	blkcache_invalidate(IF_TYPE_HOST, dev);
 	if (os_lseek(host_dev->fd,
 		     start * host_dev->blk_dev.blksz,
 		     OS_SEEK_SET) == -1) {
@@ -65,6 +73,7 @@ int host_dev_bind(int dev, char *filename)
 
 	if (!host_dev)
 		return -1;
+	blkcache_invalidate(IF_TYPE_HOST, dev);
 	if (host_dev->blk_dev.priv) {
 		os_close(host_dev->fd);
 		host_dev->blk_dev.priv = NULL;
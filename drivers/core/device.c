@@ -26,6 +26,25 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#ifdef CONFIG_DM_TIMING
+/*
+ * Read the time for DM_TIMING into *usp, returning false if it cannot be
+ * read yet. With CONFIG_TIMER the timer is itself a device: reading it
+ * before it is up would bind and probe it from inside device_bind() or
+ * device_probe(), which then read the timer again, without end.
+ */
+static bool dm_timing_now(ulong *usp)
+{
+#ifdef CONFIG_TIMER
+	if (!gd->timer)
+		return false;
+#endif
+	*usp = timer_get_boot_us();
+
+	return true;
+}
+#endif
+
 int device_bind(struct udevice *parent, const struct driver *drv,
 		const char *name, void *platdata, int of_offset,
 		struct udevice **devp)
@@ -33,6 +52,10 @@ int device_bind(struct udevice *parent, const struct driver *drv,
 	struct udevice *dev;
 	struct uclass *uc;
 	int size, ret = 0;
+#ifdef CONFIG_DM_TIMING
+	ulong start = 0;
+	bool timed = dm_timing_now(&start);
+#endif
 
 	if (devp)
 		*devp = NULL;
@@ -142,6 +165,10 @@ int device_bind(struct udevice *parent, const struct driver *drv,
 		*devp = dev;
 
 	dev->flags |= DM_FLAG_BOUND;
+#ifdef CONFIG_DM_TIMING
+	if (timed)
+		dev->bind_us = timer_get_boot_us() - start;
+#endif
 
 	return 0;
 
@@ -222,6 +249,10 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 	int size = 0;
 	int ret;
 	int seq;
+#ifdef CONFIG_DM_TIMING
+	ulong start = 0;
+	bool timed;
+#endif
 
 	if (!dev)
 		return -EINVAL;
@@ -281,6 +312,10 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 			return 0;
 	}
 
+	/* Time this device only, not its parents */
+#ifdef CONFIG_DM_TIMING
+	timed = dm_timing_now(&start);
+#endif
 	seq = uclass_resolve_seq(dev);
 	if (seq < 0) {
 		ret = seq;
@@ -325,6 +360,12 @@ int device_probe_child(struct udevice *dev, void *parent_priv)
 	if (ret)
 		goto fail_uclass;
 
+#ifdef CONFIG_DM_TIMING
+	/* The driver name stays valid even if the device is unbound */
+	if (timed)
+		dev->probe_us = bootstage_add_interval(drv->name, start);
+#endif
+
 	return 0;
 fail_uclass:
 	if (device_remove(dev)) {
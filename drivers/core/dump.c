@@ -17,8 +17,12 @@ static void show_devices(struct udevice *dev, int depth, int last_flag)
 
 	/* print the first 11 characters to not break the tree-format. */
 	strlcpy(class_name, dev->uclass->uc_drv->name, sizeof(class_name));
-	printf(" %-11s [ %c ]    ", class_name,
+	printf(" %-11s [ %c ]", class_name,
 	       dev->flags & DM_FLAG_ACTIVATED ? '+' : ' ');
+#ifdef CONFIG_DM_TIMING
+	printf("  %7u %8u", dev->bind_us, dev->probe_us);
+#endif
+	printf("    ");
 
 	for (i = depth; i >= 0; i--) {
 		is_last = (last_flag >> i) & 1;
@@ -49,8 +53,13 @@ void dm_dump_all(void)
 
 	root = dm_root();
 	if (root) {
+#ifdef CONFIG_DM_TIMING
+		printf(" Class       Probed Bind us Probe us    Name\n");
+		printf("----------------------------------------------------------\n");
+#else
 		printf(" Class       Probed   Name\n");
 		printf("----------------------------------------\n");
+#endif
 		show_devices(root, -1, 0);
 	}
 }
@@ -69,6 +78,9 @@ static void dm_display_line(struct udevice *dev)
 	       dev->name, (ulong)map_to_sysmem(dev));
 	if (dev->seq != -1 || dev->req_seq != -1)
 		printf(", seq %d, (req %d)", dev->seq, dev->req_seq);
+#ifdef CONFIG_DM_TIMING
+	printf(", bind %u us, probe %u us", dev->bind_us, dev->probe_us);
+#endif
 	puts("\n");
 }
 
@@ -85,7 +97,20 @@ void dm_dump_uclass(void)
 		if (ret)
 			continue;
 
-		printf("uclass %d: %s\n", id, uc->uc_drv->name);
+		printf("uclass %d: %s", id, uc->uc_drv->name);
+#ifdef CONFIG_DM_TIMING
+		{
+			ulong bind_us = 0, probe_us = 0;
+
+			list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+				bind_us += dev->bind_us;
+				probe_us += dev->probe_us;
+			}
+			printf(" (bind %lu us, probe %lu us)", bind_us,
+			       probe_us);
+		}
+#endif
+		puts("\n");
 		if (list_empty(&uc->dev_head))
 			continue;
 		list_for_each_entry(dev, &uc->dev_head, uclass_node) {
@@ -16,8 +16,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -138,56 +141,188 @@ static int driver_check_compatible(const void *blob, int offset,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
-		   struct udevice **devp)
+static int lists_lookup_fdt_linear(const void *blob, int offset,
+				   struct driver **drvp,
+				   const struct udevice_id **idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+	int ret = -ENOENT;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		ret = driver_check_compatible(blob, offset, entry->of_match,
+					      idp);
+		if (ret != -ENOENT)
+			break;
+	}
+	if (!ret)
+		*drvp = entry;
+
+	return ret;
+}
+
+/*
+ * Every compatible string of every driver, sorted by string and then by
+ * driver and match order. It is built on first use after relocation,
+ * since the pre-relocation malloc() area is small and only a few nodes
+ * are bound then.
+ */
+struct compat_entry {
+	const char *compatible;
+	struct driver *drv;
+	const struct udevice_id *id;
+};
+
+static struct compat_entry *compat_index;
+static int compat_count;
+
+static int h_compare_compat(const void *e1, const void *e2)
+{
+	const struct compat_entry *c1 = e1, *c2 = e2;
+	int ret;
+
+	ret = strcmp(c1->compatible, c2->compatible);
+	if (ret)
+		return ret;
+	if (c1->drv != c2->drv)
+		return c1->drv < c2->drv ? -1 : 1;
+
+	return c1->id < c2->id ? -1 : c1->id > c2->id;
+}
+
+static int compat_index_build(void)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id;
+	struct compat_entry *ce;
+	struct driver *entry;
+	int count = 0;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++)
+			count++;
+	}
+
+	compat_index = malloc(count * sizeof(*compat_index));
+	if (!compat_index)
+		return -ENOMEM;
+
+	for (ce = compat_index, entry = driver; entry != driver + n_ents;
+	     entry++) {
+		for (id = entry->of_match; id && id->compatible; id++, ce++) {
+			ce->compatible = id->compatible;
+			ce->drv = entry;
+			ce->id = id;
+		}
+	}
+	qsort(compat_index, count, sizeof(*compat_index), h_compare_compat);
+	compat_count = count;
+
+	return 0;
+}
+
+/* Find the first index entry for a compatible string */
+static struct compat_entry *compat_index_find(const char *compatible)
+{
+	int low = 0, high = compat_count;
+	int mid, ret;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		ret = strcmp(compat_index[mid].compatible, compatible);
+		if (ret < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low < compat_count &&
+	    !strcmp(compat_index[low].compatible, compatible))
+		return &compat_index[low];
+
+	return NULL;
+}
+
+static int lists_lookup_fdt_index(const void *blob, int offset,
+				  struct driver **drvp,
+				  const struct udevice_id **idp)
+{
+	struct compat_entry *best = NULL, *ce;
+	const char *compat, *end;
+	int len;
+
+	compat = fdt_getprop(blob, offset, "compatible", &len);
+	if (!compat)
+		return len == -FDT_ERR_NOTFOUND ? -ENODEV : -EINVAL;
+
+	/*
+	 * Pick the same driver as the linear search: the first one in the
+	 * list that matches any of the node's compatible strings
+	 */
+	for (end = compat + len; compat < end; compat += strlen(compat) + 1) {
+		ce = compat_index_find(compat);
+		if (ce && (!best || ce->drv < best->drv ||
+			   (ce->drv == best->drv && ce->id < best->id)))
+			best = ce;
+	}
+	if (!best)
+		return -ENOENT;
+	*drvp = best->drv;
+	*idp = best->id;
+
+	return 0;
+}
+
+int lists_driver_lookup_fdt(const void *blob, int offset, bool use_index,
+			    struct driver **drvp,
+			    const struct udevice_id **idp)
+{
+	*drvp = NULL;
+	*idp = NULL;
+	if (use_index && (gd->flags & GD_FLG_RELOC)) {
+		if (compat_index || !compat_index_build())
+			return lists_lookup_fdt_index(blob, offset, drvp, idp);
+	}
+
+	return lists_lookup_fdt_linear(blob, offset, drvp, idp);
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
+		   struct udevice **devp)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
-	bool found = false;
 	const char *name;
-	int result = 0;
-	int ret = 0;
+	int ret;
 
 	dm_dbg("bind node %s\n", fdt_get_name(blob, offset, NULL));
 	if (devp)
 		*devp = NULL;
-	for (entry = driver; entry != driver + n_ents; entry++) {
-		ret = driver_check_compatible(blob, offset, entry->of_match,
-					      &id);
-		name = fdt_get_name(blob, offset, NULL);
-		if (ret == -ENOENT) {
-			continue;
-		} else if (ret == -ENODEV) {
-			dm_dbg("Device '%s' has no compatible string\n", name);
-			break;
-		} else if (ret) {
-			dm_warn("Device tree error at offset %d\n", offset);
-			result = ret;
-			break;
-		}
-
-		dm_dbg("   - found match at '%s'\n", entry->name);
-		ret = device_bind(parent, entry, name, NULL, offset, &dev);
-		if (ret) {
-			dm_warn("Error binding driver '%s'\n", entry->name);
-			return ret;
-		} else {
-			dev->driver_data = id->data;
-			found = true;
-			if (devp)
-				*devp = dev;
-		}
-		break;
+	name = fdt_get_name(blob, offset, NULL);
+	ret = lists_driver_lookup_fdt(blob, offset, true, &entry, &id);
+	if (ret == -ENOENT) {
+		dm_dbg("No match for node '%s'\n", name);
+		return 0;
+	} else if (ret == -ENODEV) {
+		dm_dbg("Device '%s' has no compatible string\n", name);
+		return 0;
+	} else if (ret) {
+		dm_warn("Device tree error at offset %d\n", offset);
+		return ret;
 	}
 
-	if (!found && !result && ret != -ENODEV) {
-		dm_dbg("No match for node '%s'\n",
-		       fdt_get_name(blob, offset, NULL));
+	dm_dbg("   - found match at '%s'\n", entry->name);
+	ret = device_bind(parent, entry, name, NULL, offset, &dev);
+	if (ret) {
+		dm_warn("Error binding driver '%s'\n", entry->name);
+		return ret;
 	}
+	dev->driver_data = id->data;
+	if (devp)
+		*devp = dev;
 
-	return result;
+	return 0;
 }
 #endif
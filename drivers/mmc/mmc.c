@@ -193,47 +193,231 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+static void mmc_setup_read(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
-		return 0;
+static int mmc_stop_read(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
 
-	if (blkcnt > 1) {
-		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
-		cmd.cmdarg = 0;
-		cmd.resp_type = MMC_RSP_R1b;
-		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+	cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1b;
+	if (mmc_send_cmd(mmc, &cmd, NULL)) {
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-			printf("mmc fail to send stop cmd\n");
+		printf("mmc fail to send stop cmd\n");
 #endif
-			return 0;
-		}
+		return COMM_ERR;
 	}
 
+	return 0;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	mmc_setup_read(mmc, &cmd, &data, dst, start, blkcnt);
+	if (mmc_send_cmd(mmc, &cmd, &data))
+		return 0;
+
+	if (blkcnt > 1 && mmc_stop_read(mmc))
+		return 0;
+
 	return blkcnt;
 }
 
+static bool mmc_can_queue(struct mmc *mmc)
+{
+	return mmc->cfg->ops->start_cmd && mmc->cfg->ops->poll_cmd;
+}
+
+/* Give the host a chance to set up the transfer while another one runs */
+static void mmc_req_prepare(struct mmc *mmc, struct mmc_req *req)
+{
+	const struct mmc_ops *ops = mmc->cfg->ops;
+
+	if (!req || req->prepared || !ops->prepare_data)
+		return;
+
+	/* On failure the host simply does the work in start_cmd() */
+	ops->prepare_data(mmc, &req->data);
+	req->prepared = true;
+}
+
+static void mmc_req_finish(struct mmc *mmc, struct mmc_req *req, int err)
+{
+	const struct mmc_ops *ops = mmc->cfg->ops;
+
+	mmc->req_head = req->next;
+	if (!mmc->req_head) {
+		mmc->req_tail = NULL;
+		/* Nothing prepared by the host may outlive the queue */
+		if (ops->prepare_data)
+			ops->prepare_data(mmc, NULL);
+	}
+	req->next = NULL;
+
+	if (!err && req->blkcnt > 1)
+		err = mmc_stop_read(mmc);
+	if (err)
+		debug("%s: Failed to read blocks: %d\n", __func__, err);
+	req->ret = err ? err : req->blkcnt;
+	req->state = MMC_REQ_DONE;
+}
+
+/* Start the request at the head of the queue, if it is not running yet */
+static void mmc_req_kick(struct mmc *mmc)
+{
+	const struct mmc_ops *ops = mmc->cfg->ops;
+	struct mmc_req *req;
+	int err;
+
+	while ((req = mmc->req_head) && req->state == MMC_REQ_QUEUED) {
+		if (mmc_can_queue(mmc)) {
+			err = ops->start_cmd(mmc, &req->cmd, &req->data);
+			if (!err) {
+				req->state = MMC_REQ_ACTIVE;
+				mmc_req_prepare(mmc, req->next);
+				return;
+			}
+		} else {
+			err = mmc_send_cmd(mmc, &req->cmd, &req->data);
+		}
+		mmc_req_finish(mmc, req, err);
+	}
+}
+
+int mmc_req_submit(struct mmc *mmc, struct mmc_req *req)
+{
+	int err;
+
+	if (!req->blkcnt || req->blkcnt > mmc->cfg->b_max ||
+	    req->start + req->blkcnt > mmc->block_dev.lba)
+		return -EINVAL;
+
+	if (!mmc->req_head) {
+		err = mmc_set_blocklen(mmc, mmc->read_bl_len);
+		if (err) {
+			debug("%s: Failed to set blocklen\n", __func__);
+			return err;
+		}
+	}
+
+	mmc_setup_read(mmc, &req->cmd, &req->data, req->dst, req->start,
+		       req->blkcnt);
+	req->state = MMC_REQ_QUEUED;
+	req->prepared = false;
+	req->next = NULL;
+	if (mmc->req_tail)
+		mmc->req_tail->next = req;
+	else
+		mmc->req_head = req;
+	mmc->req_tail = req;
+
+	if (mmc->req_head == req)
+		mmc_req_kick(mmc);
+	else if (mmc->req_head->next == req)
+		mmc_req_prepare(mmc, req);
+
+	return 0;
+}
+
+bool mmc_req_poll(struct mmc *mmc)
+{
+	struct mmc_req *req = mmc->req_head;
+	int err;
+
+	if (req && req->state == MMC_REQ_ACTIVE) {
+		err = mmc->cfg->ops->poll_cmd(mmc, &req->cmd, &req->data);
+		if (err == -EBUSY)
+			return true;
+		mmc_req_finish(mmc, req, err);
+		mmc_req_kick(mmc);
+	}
+
+	return mmc->req_head != NULL;
+}
+
+int mmc_req_wait(struct mmc *mmc, struct mmc_req *req)
+{
+	if (req->state == MMC_REQ_IDLE)
+		return -EINVAL;
+
+	while (!mmc_req_done(req))
+		mmc_req_poll(mmc);
+
+	return req->ret;
+}
+
+void mmc_req_flush(struct mmc *mmc)
+{
+	while (mmc_req_poll(mmc))
+		;
+}
+
+/*
+ * Read through the request queue, keeping the next chunk queued behind the
+ * running one so that the host can prepare it in advance
+ */
+static int mmc_bread_queued(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			    void *dst)
+{
+	struct mmc_req reqs[2], *req;
+	lbaint_t cur, blocks_todo = blkcnt;
+	int i, pending = 0, ret = 0;
+
+	memset(reqs, '\0', sizeof(reqs));
+	for (i = 0; blocks_todo || pending; i = !i) {
+		req = &reqs[i];
+		if (req->state == MMC_REQ_QUEUED ||
+		    req->state == MMC_REQ_ACTIVE) {
+			if (mmc_req_wait(mmc, req) < 0)
+				ret = -EIO;
+			pending--;
+		}
+		if (!blocks_todo)
+			continue;
+
+		cur = min(blocks_todo, (lbaint_t)mmc->cfg->b_max);
+		req->start = start;
+		req->blkcnt = cur;
+		req->dst = dst;
+		if (ret || mmc_req_submit(mmc, req)) {
+			ret = -EIO;
+			blocks_todo = 0;
+			continue;
+		}
+		pending++;
+		blocks_todo -= cur;
+		start += cur;
+		dst += cur * mmc->read_bl_len;
+	}
+
+	return ret;
+}
+
 static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
@@ -253,6 +437,18 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
+	if (blkcache_read(IF_TYPE_MMC, dev_num, start, blkcnt,
+			  mmc->read_bl_len, dst))
+		return blkcnt;
+
+	if (mmc_can_queue(mmc)) {
+		if (mmc_bread_queued(mmc, start, blkcnt, dst)) {
+			debug("%s: Failed to read blocks\n", __func__);
+			return 0;
+		}
+		goto done;
+	}
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
@@ -269,6 +465,12 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		start += cur;
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
+	start -= blkcnt;
+	dst -= blkcnt * mmc->read_bl_len;
+
+done:
+	blkcache_fill(IF_TYPE_MMC, dev_num, start, blkcnt, mmc->read_bl_len,
+		      dst);
 
 	return blkcnt;
 }
@@ -294,6 +496,55 @@ static int mmc_go_idle(struct mmc *mmc)
 	return 0;
 }
 
+#ifdef MMC_SUPPORTS_TUNING
+/* Check that the host can switch voltage, tune, and run in one of @caps */
+static bool mmc_host_can_tune(struct mmc *mmc, uint caps)
+{
+	const struct mmc_ops *ops = mmc->cfg->ops;
+
+	return (mmc->cfg->host_caps & caps) && ops->set_signal_voltage &&
+		ops->execute_tuning;
+}
+#endif
+
+static int mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	int err;
+
+	if (mmc->signal_voltage == voltage)
+		return 0;
+
+	if (!mmc->cfg->ops->set_signal_voltage)
+		return -ENOSYS;
+
+	err = mmc->cfg->ops->set_signal_voltage(mmc, voltage);
+	if (err)
+		return err;
+
+	mmc->signal_voltage = voltage;
+
+	return 0;
+}
+
+#ifdef CONFIG_MMC_UHS_SUPPORT
+/* Move an SD card which accepted S18R over to 1.8V signalling */
+static int sd_switch_voltage(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
+
+	cmd.cmdidx = SD_CMD_SWITCH_UHS18V;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		return err;
+
+	return mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+}
+#endif
+
 static int sd_send_op_cond(struct mmc *mmc)
 {
 	int timeout = 1000;
@@ -325,6 +576,11 @@ static int sd_send_op_cond(struct mmc *mmc)
 
 		if (mmc->version == SD_VERSION_2)
 			cmd.cmdarg |= OCR_HCS;
+#ifdef CONFIG_MMC_UHS_SUPPORT
+		if (mmc->version == SD_VERSION_2 &&
+		    mmc_host_can_tune(mmc, MMC_MODE_UHS))
+			cmd.cmdarg |= OCR_S18R;
+#endif
 
 		err = mmc_send_cmd(mmc, &cmd, NULL);
 
@@ -359,6 +615,16 @@ static int sd_send_op_cond(struct mmc *mmc)
 	mmc->high_capacity = ((mmc->ocr & OCR_HCS) == OCR_HCS);
 	mmc->rca = 0;
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	/* S18A: the card is ready to switch to 1.8V for UHS-I */
+	if (mmc->version == SD_VERSION_2 && (mmc->ocr & OCR_S18R) &&
+	    mmc_host_can_tune(mmc, MMC_MODE_UHS)) {
+		err = sd_switch_voltage(mmc);
+		if (err)
+			return err;
+	}
+#endif
+
 	return 0;
 }
 
@@ -470,7 +736,8 @@ static int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 }
 
 
-static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+static int __mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value,
+			bool send_status)
 {
 	struct mmc_cmd cmd;
 	int timeout = 1000;
@@ -485,17 +752,22 @@ static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 	ret = mmc_send_cmd(mmc, &cmd, NULL);
 
 	/* Waiting for the ready status */
-	if (!ret)
+	if (!ret && send_status)
 		ret = mmc_send_status(mmc, timeout);
 
 	return ret;
 
 }
 
+static int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
+{
+	return __mmc_switch(mmc, set, index, value, true);
+}
+
 static int mmc_change_freq(struct mmc *mmc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(u8, ext_csd, MMC_MAX_BLOCK_LEN);
-	char cardtype;
+	u8 cardtype;
 	int err;
 
 	mmc->card_caps = 0;
@@ -514,7 +786,7 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE];
 
 	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
 
@@ -539,6 +811,17 @@ static int mmc_change_freq(struct mmc *mmc)
 	} else {
 		mmc->card_caps |= MMC_MODE_HS;
 	}
+	mmc->timing = MMC_TIMING_MMC_HS;
+
+#ifdef CONFIG_MMC_HS200_SUPPORT
+	/* Only 1.8V I/O is supported for HS200 and HS400 */
+	if (mmc_host_can_tune(mmc, MMC_MODE_HS200)) {
+		if (cardtype & EXT_CSD_CARD_TYPE_HS200_1_8V)
+			mmc->card_caps |= MMC_MODE_HS200;
+		if (cardtype & EXT_CSD_CARD_TYPE_HS400_1_8V)
+			mmc->card_caps |= MMC_MODE_HS400;
+	}
+#endif
 
 	return 0;
 }
@@ -605,9 +888,11 @@ int mmc_switch_part(int dev_num, unsigned int part_num)
 	if (!mmc)
 		return -1;
 
+	mmc_req_flush(mmc);
 	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_PART_CONF,
 			 (mmc->part_config & ~PART_ACCESS_MASK)
 			 | (part_num & PART_ACCESS_MASK));
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
 
 	/*
 	 * Set the capacity if the switch succeeded or was intended
@@ -935,6 +1220,22 @@ retry_scr:
 			break;
 	}
 
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	/*
+	 * At 1.8V the card is in UHS-I mode, where the high-speed function
+	 * below becomes SDR25. The faster modes are selected once the bus
+	 * is 4 bits wide.
+	 */
+	if (mmc->signal_voltage == MMC_SIGNAL_VOLTAGE_180) {
+		uint support = __be32_to_cpu(switch_status[3]);
+
+		if (support & SD_UHS_SDR104_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR104;
+		if (support & SD_UHS_SDR50_SUPPORTED)
+			mmc->card_caps |= MMC_MODE_UHS_SDR50;
+	}
+#endif
+
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -954,8 +1255,10 @@ retry_scr:
 	if (err)
 		return err;
 
-	if ((__be32_to_cpu(switch_status[4]) & 0x0f000000) == 0x01000000)
+	if ((__be32_to_cpu(switch_status[4]) & 0x0f000000) == 0x01000000) {
 		mmc->card_caps |= MMC_MODE_HS;
+		mmc->timing = MMC_TIMING_SD_HS;
+	}
 
 	return 0;
 }
@@ -1017,6 +1320,228 @@ static void mmc_set_bus_width(struct mmc *mmc, uint width)
 	mmc_set_ios(mmc);
 }
 
+const u8 mmc_tuning_blk_pattern_4bit[64] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+const u8 mmc_tuning_blk_pattern_8bit[128] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+int mmc_send_tuning(struct mmc *mmc, uint opcode)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, data_buf,
+				 sizeof(mmc_tuning_blk_pattern_8bit));
+	const u8 *pattern;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	uint size;
+	int err;
+
+	if (mmc->bus_width == 8) {
+		pattern = mmc_tuning_blk_pattern_8bit;
+		size = sizeof(mmc_tuning_blk_pattern_8bit);
+	} else if (mmc->bus_width == 4) {
+		pattern = mmc_tuning_blk_pattern_4bit;
+		size = sizeof(mmc_tuning_blk_pattern_4bit);
+	} else {
+		return -EINVAL;
+	}
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	data.dest = (char *)data_buf;
+	data.blocksize = size;
+	data.blocks = 1;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	return memcmp(data_buf, pattern, size) ? -EIO : 0;
+}
+
+#ifdef CONFIG_MMC_UHS_SUPPORT
+/* Select SDR104 or SDR50 on a UHS-I card with a 4-bit bus, and tune */
+static int sd_select_uhs(struct mmc *mmc)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(uint, switch_status, 16);
+	uint mode, timing, speed;
+	int err;
+
+	if (mmc->card_caps & MMC_MODE_UHS_SDR104) {
+		mode = SD_ACCESS_MODE_SDR104;
+		timing = MMC_TIMING_UHS_SDR104;
+		speed = 208000000;
+	} else {
+		mode = SD_ACCESS_MODE_SDR50;
+		timing = MMC_TIMING_UHS_SDR50;
+		speed = 100000000;
+	}
+
+	err = sd_switch(mmc, SD_SWITCH_SWITCH, 0, mode, (u8 *)switch_status);
+	if (err)
+		return err;
+
+	/* The card stays in SDR25 (or SDR12) if it refused the switch */
+	if (((__be32_to_cpu(switch_status[4]) >> 24) & 0xf) != mode)
+		return 0;
+
+	mmc->timing = timing;
+	mmc_set_clock(mmc, speed);
+
+	err = mmc->cfg->ops->execute_tuning(mmc, SD_CMD_SEND_TUNING_BLOCK);
+	if (!err) {
+		mmc->tran_speed = speed;
+		return 0;
+	}
+
+	printf("MMC: tuning failed (%d), using SDR25\n", err);
+	mmc->timing = MMC_TIMING_SD_HS;
+	mmc_set_clock(mmc, 25000000);
+
+	return sd_switch(mmc, SD_SWITCH_SWITCH, 0, SD_ACCESS_MODE_SDR25,
+			 (u8 *)switch_status);
+}
+#else
+static inline int sd_select_uhs(struct mmc *mmc)
+{
+	return -ENOSYS;
+}
+#endif
+
+#ifdef CONFIG_MMC_HS200_SUPPORT
+/*
+ * Change HS_TIMING and move the host over to match before checking the
+ * card's status, which would otherwise be read at the wrong timing.
+ */
+static int mmc_switch_timing(struct mmc *mmc, u8 value, uint timing,
+			     uint clock)
+{
+	int err;
+
+	err = __mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			   value, false);
+	if (err)
+		return err;
+
+	mmc->timing = timing;
+	mmc_set_clock(mmc, clock);
+
+	return mmc_send_status(mmc, 1000);
+}
+
+/* HS400 is entered from high-speed timing, keeping the HS200 tuning */
+static int mmc_select_hs400(struct mmc *mmc)
+{
+	int err;
+
+	err = mmc_switch_timing(mmc, EXT_CSD_TIMING_HS, MMC_TIMING_MMC_HS,
+				52000000);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 EXT_CSD_DDR_BUS_WIDTH_8);
+	if (err)
+		return err;
+	mmc->ddr_mode = 1;
+
+	return mmc_switch_timing(mmc, EXT_CSD_TIMING_HS400,
+				 MMC_TIMING_MMC_HS400, 200000000);
+}
+
+/*
+ * Select HS200, and then HS400 if possible. On failure the card is put
+ * back into high-speed timing so that the usual bus set-up can follow.
+ */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	uint old_voltage = mmc->signal_voltage;
+	uint width;
+	int err;
+
+	if (mmc->card_caps & MMC_MODE_8BIT)
+		width = 8;
+	else if (mmc->card_caps & MMC_MODE_4BIT)
+		width = 4;
+	else
+		return -EINVAL;
+
+	err = mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
+	if (err)
+		return err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 width == 8 ? EXT_CSD_BUS_WIDTH_8 : EXT_CSD_BUS_WIDTH_4);
+	if (err)
+		goto err;
+	mmc_set_bus_width(mmc, width);
+
+	err = mmc_switch_timing(mmc, EXT_CSD_TIMING_HS200,
+				MMC_TIMING_MMC_HS200, 200000000);
+	if (err)
+		goto err;
+
+	err = mmc->cfg->ops->execute_tuning(mmc,
+					    MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	if (err)
+		goto err;
+
+	if ((mmc->card_caps & MMC_MODE_HS400) && width == 8) {
+		err = mmc_select_hs400(mmc);
+		if (err)
+			goto err;
+	}
+
+	mmc->tran_speed = 200000000;
+
+	return 0;
+
+err:
+	printf("MMC: HS200 failed (%d), using high speed\n", err);
+	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_MMC_HS;
+	mmc_set_clock(mmc, 26000000);
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+		   EXT_CSD_TIMING_HS);
+	mmc_set_signal_voltage(mmc, old_voltage);
+	mmc->card_caps &= ~(MMC_MODE_HS200 | MMC_MODE_HS400);
+
+	return err;
+}
+#else
+static inline int mmc_select_hs200(struct mmc *mmc)
+{
+	return -ENOSYS;
+}
+#endif
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -1363,6 +1888,15 @@ static int mmc_startup(struct mmc *mmc)
 			mmc->tran_speed = 50000000;
 		else
 			mmc->tran_speed = 25000000;
+
+		if ((mmc->card_caps & MMC_MODE_UHS) && mmc->bus_width == 4) {
+			err = sd_select_uhs(mmc);
+			if (err)
+				return err;
+		}
+	} else if ((mmc->card_caps & MMC_MODE_HS200) &&
+		   !mmc_select_hs200(mmc)) {
+		/* The bus width and clock are set up for HS200/HS400 */
 	} else if (mmc->version >= MMC_VERSION_4) {
 		/* Only version 4 of MMC supports wider bus widths */
 		int idx;
@@ -1564,7 +2098,7 @@ struct mmc *mmc_create(const struct mmc_config *cfg, void *priv)
 
 void mmc_destroy(struct mmc *mmc)
 {
-	/* only freeing memory for now */
+	list_del(&mmc->link);
 	free(mmc);
 }
 
@@ -1612,6 +2146,8 @@ int mmc_start_init(struct mmc *mmc)
 		return err;
 
 	mmc->ddr_mode = 0;
+	mmc->timing = MMC_TIMING_LEGACY;
+	mmc_set_signal_voltage(mmc, MMC_SIGNAL_VOLTAGE_330);
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -1623,6 +2159,7 @@ int mmc_start_init(struct mmc *mmc)
 
 	/* The internal partition reset to user partition(0) at every CMD0*/
 	mmc->part_num = 0;
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
 
 	/* Test for SD version 2 */
 	err = mmc_send_if_cond(mmc);
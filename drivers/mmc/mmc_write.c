@@ -76,6 +76,9 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	if (!mmc)
 		return -1;
 
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+	mmc_req_flush(mmc);
+
 	/*
 	 * We want to see if the requested start or total block count are
 	 * unaligned.  We discard the whole numbers and only care about the
@@ -173,6 +176,9 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 	if (!mmc)
 		return 0;
 
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+	mmc_req_flush(mmc);
+
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
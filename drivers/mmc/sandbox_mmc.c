@@ -9,10 +9,431 @@
 #include <dm.h>
 #include <errno.h>
 #include <mmc.h>
+#include <fdtdec.h>
 #include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/*
+ * This emulates a 1MiB high-capacity UHS-I SD card held in memory, or an
+ * HS400 eMMC if the device tree node has a "sandbox,emmc" property. Reads
+ * can also be queued, in which case each transfer only completes after a
+ * few calls to poll_cmd(), as it would with a real DMA controller.
+ *
+ * At the tuned timings (SDR50, SDR104, HS200 and HS400) data can only be
+ * read if the host samples it at a tap between tap_first and tap_last.
+ */
+#define SANDBOX_MMC_BLKS	2048
+#define SANDBOX_MMC_BLKSZ	512
+#define SANDBOX_MMC_RCA		0x1234
+#define SANDBOX_MMC_BUSY_POLLS	3
+#define SANDBOX_MMC_TAPS	16
+
+/**
+ * struct sandbox_mmc_priv - private data for the sandbox MMC host
+ *
+ * @cfg:	MMC configuration
+ * @cmd:	Command whose transfer is running, or NULL if none
+ * @busy:	Number of polls left before the running transfer finishes
+ * @next:	Data transfer prepared by prepare_data(), or NULL
+ * @started:	Number of transfers started with start_cmd()
+ * @prepared:	Number of those which had been prepared in advance
+ * @emmc:	true to emulate an eMMC rather than an SD card
+ * @s18a:	SD card has accepted 1.8V signalling in ACMD41
+ * @uhs:	SD card has switched to 1.8V with CMD11
+ * @access_mode: SD access mode (SD_ACCESS_MODE_...)
+ * @tap:	Sampling point used by the host
+ * @tap_first:	First sampling point which works at the tuned timings
+ * @tap_last:	Last sampling point which works at the tuned timings
+ * @tunings:	Number of times the host has been tuned
+ * @ext_csd:	eMMC extended CSD
+ * @buf:	Card contents
+ */
+struct sandbox_mmc_priv {
+	struct mmc_config cfg;
+	struct mmc_cmd *cmd;
+	int busy;
+	struct mmc_data *next;
+	int started;
+	int prepared;
+	bool emmc;
+	bool s18a;
+	bool uhs;
+	int access_mode;
+	int tap;
+	int tap_first;
+	int tap_last;
+	int tunings;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	u8 buf[SANDBOX_MMC_BLKS * SANDBOX_MMC_BLKSZ];
+};
+
+/* Put the card back in its power-on state, as CMD0 does */
+static void sandbox_mmc_reset(struct sandbox_mmc_priv *priv)
+{
+	u8 *ext_csd = priv->ext_csd;
+
+	priv->s18a = false;
+	priv->uhs = false;
+	priv->access_mode = 0;
+
+	memset(ext_csd, '\0', sizeof(priv->ext_csd));
+	ext_csd[EXT_CSD_REV] = 7;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_1_8V |
+		EXT_CSD_CARD_TYPE_HS200_1_8V | EXT_CSD_CARD_TYPE_HS400_1_8V;
+	ext_csd[EXT_CSD_SEC_CNT] = SANDBOX_MMC_BLKS & 0xff;
+	ext_csd[EXT_CSD_SEC_CNT + 1] = SANDBOX_MMC_BLKS >> 8;
+	ext_csd[EXT_CSD_HC_WP_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;
+}
+
+/* Check whether the host samples the data at a point which works */
+static bool sandbox_mmc_sampling_ok(struct mmc *mmc)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	switch (mmc->timing) {
+	case MMC_TIMING_UHS_SDR50:
+	case MMC_TIMING_UHS_SDR104:
+	case MMC_TIMING_MMC_HS200:
+	case MMC_TIMING_MMC_HS400:
+		return priv->tap >= priv->tap_first &&
+			priv->tap <= priv->tap_last;
+	default:
+		return true;
+	}
+}
+
+static int sandbox_mmc_xfer(struct mmc *mmc, struct mmc_cmd *cmd,
+			    struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	ulong size = data->blocks * data->blocksize;
+	ulong offset = cmd->cmdarg * SANDBOX_MMC_BLKSZ;
+
+	if (data->blocksize != SANDBOX_MMC_BLKSZ ||
+	    cmd->cmdarg + data->blocks > SANDBOX_MMC_BLKS ||
+	    !sandbox_mmc_sampling_ok(mmc))
+		return COMM_ERR;
+
+	if (data->flags & MMC_DATA_READ)
+		memcpy(data->dest, priv->buf + offset, size);
+	else
+		memcpy(priv->buf + offset, data->src, size);
+
+	return 0;
+}
+
+/* Function switch (CMD6) on an SD card: only the access mode can change */
+static int sandbox_sd_switch(struct sandbox_mmc_priv *priv,
+			     struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	uint mode = cmd->cmdarg & 0xf;
+	/* SDR12 (the default) and SDR25 (high speed) */
+	u8 support = 1 << 0 | 1 << SD_ACCESS_MODE_SDR25;
+
+	if (priv->uhs)
+		support |= 1 << SD_ACCESS_MODE_SDR50 |
+			1 << SD_ACCESS_MODE_SDR104;
+
+	if (mode == 0xf)
+		mode = priv->access_mode;
+	else if (!(support & 1 << mode))
+		mode = 0xf;
+	else if (cmd->cmdarg & 1 << 31)
+		priv->access_mode = mode;
+
+	memset(data->dest, '\0', 64);
+	data->dest[13] = support;
+	data->dest[16] = mode;
+
+	return 0;
+}
+
+static int sandbox_mmc_tuning_block(struct mmc *mmc, struct mmc_data *data)
+{
+	const u8 *pattern = mmc_tuning_blk_pattern_4bit;
+	uint size = sizeof(mmc_tuning_blk_pattern_4bit);
+
+	if (mmc->bus_width == 8) {
+		pattern = mmc_tuning_blk_pattern_8bit;
+		size = sizeof(mmc_tuning_blk_pattern_8bit);
+	}
+	if (!data || data->blocksize != size)
+		return COMM_ERR;
+
+	memcpy(data->dest, pattern, size);
+	if (!sandbox_mmc_sampling_ok(mmc))
+		data->dest[size / 2] ^= 0xff;
+
+	return 0;
+}
+
+static int sandbox_mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	/* Card size in units of 512KiB, less one */
+	uint csize = SANDBOX_MMC_BLKS / 1024 - 1;
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		sandbox_mmc_reset(priv);
+		cmd->response[0] = 0;
+		break;
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+	case MMC_CMD_STOP_TRANSMISSION:
+		cmd->response[0] = 0;
+		break;
+	case MMC_CMD_APP_CMD:
+		if (priv->emmc)
+			return TIMEOUT;
+		cmd->response[0] = 0;
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		if (!priv->emmc)
+			return TIMEOUT;
+		cmd->response[0] = OCR_BUSY | OCR_HCS | OCR_VOLTAGE_MASK;
+		break;
+	case SD_CMD_SEND_IF_COND:
+		if (!priv->emmc) {
+			cmd->response[0] = cmd->cmdarg;
+			break;
+		}
+		/* This is MMC_CMD_SEND_EXT_CSD on an eMMC */
+		if (!data)
+			return TIMEOUT;
+		memcpy(data->dest, priv->ext_csd, sizeof(priv->ext_csd));
+		break;
+	case SD_CMD_APP_SEND_OP_COND:
+		priv->s18a = cmd->cmdarg & OCR_S18R;
+		cmd->response[0] = OCR_BUSY | OCR_HCS |
+			(priv->s18a ? OCR_S18R : 0);
+		break;
+	case SD_CMD_SWITCH_UHS18V:
+		if (!priv->s18a)
+			return TIMEOUT;
+		priv->uhs = true;
+		cmd->response[0] = 0;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		memset(cmd->response, '\0', sizeof(cmd->response));
+		break;
+	case SD_CMD_SEND_RELATIVE_ADDR:
+		cmd->response[0] = SANDBOX_MMC_RCA << 16;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/*
+		 * SD CSD version 2.0 or MMC 4.x CSD, 25MHz, 512-byte blocks.
+		 * The high-capacity size layout is used for both.
+		 */
+		cmd->response[0] = priv->emmc ? 0x90000032 : 0x40000032;
+		cmd->response[1] = 9 << 16 | csize >> 16;
+		cmd->response[2] = (csize & 0xffff) << 16;
+		cmd->response[3] = priv->emmc ? 9 << 22 : 0;
+		break;
+	case MMC_CMD_SEND_STATUS:
+		/* Ready, in the transfer state */
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | 4 << 9;
+		break;
+	case SD_CMD_APP_SEND_SCR:
+		/* SD version 3.0x, 1 and 4-bit bus */
+		memset(data->dest, '\0', 8);
+		data->dest[0] = 2;
+		data->dest[1] = 5;
+		data->dest[2] = 0x80;
+		break;
+	case SD_CMD_SWITCH_FUNC:
+		/* Without data this is SD_CMD_APP_SET_BUS_WIDTH */
+		if (!priv->emmc && !data) {
+			cmd->response[0] = 0;
+			break;
+		}
+		if (!priv->emmc)
+			return sandbox_sd_switch(priv, cmd, data);
+		/* MMC_CMD_SWITCH: write one byte of the extended CSD */
+		priv->ext_csd[(cmd->cmdarg >> 16) & 0xff] =
+			(cmd->cmdarg >> 8) & 0xff;
+		cmd->response[0] = 0;
+		break;
+	case SD_CMD_SEND_TUNING_BLOCK:
+	case MMC_CMD_SEND_TUNING_BLOCK_HS200:
+		return sandbox_mmc_tuning_block(mmc, data);
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		return sandbox_mmc_xfer(mmc, cmd, data);
+	default:
+		debug("%s: Unsupported command %d\n", __func__, cmd->cmdidx);
+		return TIMEOUT;
+	}
+
+	return 0;
+}
+
+static int sandbox_mmc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	if (priv->cmd)
+		return -EBUSY;
+	if (!data)
+		return sandbox_mmc_send_cmd(mmc, cmd, data);
+
+	priv->cmd = cmd;
+	priv->busy = SANDBOX_MMC_BUSY_POLLS;
+	priv->started++;
+	if (priv->next == data)
+		priv->prepared++;
+	priv->next = NULL;
+
+	return 0;
+}
+
+static int sandbox_mmc_poll_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	if (priv->cmd != cmd)
+		return COMM_ERR;
+	if (priv->busy-- > 0)
+		return -EBUSY;
+	priv->cmd = NULL;
+
+	return sandbox_mmc_send_cmd(mmc, cmd, data);
+}
+
+static int sandbox_mmc_prepare_data(struct mmc *mmc, struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	priv->next = data;
+
+	return 0;
+}
+
+static int sandbox_mmc_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+
+	/* An SD card must be told with CMD11 before the host switches */
+	if (voltage == MMC_SIGNAL_VOLTAGE_180 && !priv->emmc && !priv->uhs)
+		return -EIO;
+
+	return 0;
+}
+
+/* Try each tap in turn and settle in the middle of the working ones */
+static int sandbox_mmc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct sandbox_mmc_priv *priv = mmc->priv;
+	int first = -1, last = -1;
+	int tap;
+
+	priv->tunings++;
+	for (tap = 0; tap < SANDBOX_MMC_TAPS; tap++) {
+		priv->tap = tap;
+		if (mmc_send_tuning(mmc, opcode))
+			continue;
+		if (first == -1)
+			first = tap;
+		last = tap;
+	}
+	if (first == -1)
+		return -EIO;
+	priv->tap = (first + last) / 2;
+
+	return 0;
+}
+
+static int sandbox_mmc_init(struct mmc *mmc)
+{
+	return 0;
+}
+
+static const struct mmc_ops sandbox_mmc_ops = {
+	.send_cmd	= sandbox_mmc_send_cmd,
+	.init		= sandbox_mmc_init,
+	.start_cmd	= sandbox_mmc_start_cmd,
+	.poll_cmd	= sandbox_mmc_poll_cmd,
+	.prepare_data	= sandbox_mmc_prepare_data,
+	.set_signal_voltage = sandbox_mmc_set_signal_voltage,
+	.execute_tuning	= sandbox_mmc_execute_tuning,
+};
+
+void sandbox_mmc_get_stats(struct udevice *dev, int *started, int *prepared)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*started = priv->started;
+	*prepared = priv->prepared;
+}
+
+int sandbox_mmc_get_tuning(struct udevice *dev, int *tap)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*tap = priv->tap;
+
+	return priv->tunings;
+}
+
+void sandbox_mmc_set_tap_window(struct udevice *dev, int first, int last)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->tap_first = first;
+	priv->tap_last = last;
+}
+
+static int sandbox_mmc_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_config *cfg = &priv->cfg;
+
+	priv->emmc = fdtdec_get_bool(gd->fdt_blob, dev->of_offset,
+				     "sandbox,emmc");
+	priv->tap_first = 6;
+	priv->tap_last = 10;
+	sandbox_mmc_reset(priv);
+
+	cfg->name = dev->name;
+	cfg->ops = &sandbox_mmc_ops;
+	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
+	cfg->host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	if (priv->emmc)
+		cfg->host_caps |= MMC_MODE_8BIT | MMC_MODE_DDR_52MHz |
+			MMC_MODE_HS200 | MMC_MODE_HS400;
+	else
+		cfg->host_caps |= MMC_MODE_UHS;
+	cfg->f_min = 400000;
+	cfg->f_max = 208000000;
+	/* Keep this small so that reads are split into several requests */
+	cfg->b_max = 16;
+	cfg->part_type = PART_TYPE_DOS;
+
+	upriv->mmc = mmc_create(cfg, priv);
+	if (!upriv->mmc)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int sandbox_mmc_remove(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+
+	mmc_destroy(upriv->mmc);
+
+	return 0;
+}
+
 static const struct udevice_id sandbox_mmc_ids[] = {
 	{ .compatible = "sandbox,mmc" },
 	{ }
@@ -22,4 +443,7 @@ U_BOOT_DRIVER(warm_mmc_sandbox) = {
 	.name		= "mmc_sandbox",
 	.id		= UCLASS_MMC,
 	.of_match	= sandbox_mmc_ids,
+	.probe		= sandbox_mmc_probe,
+	.remove		= sandbox_mmc_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 };
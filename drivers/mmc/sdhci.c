@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <malloc.h>
 #include <mmc.h>
 #include <sdhci.h>
@@ -71,12 +72,6 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 				unsigned int start_addr)
 {
 	unsigned int stat, rdy, mask, timeout, block = 0;
-#ifdef CONFIG_MMC_SDMA
-	unsigned char ctrl;
-	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
-	ctrl &= ~SDHCI_CTRL_DMA_MASK;
-	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
-#endif
 
 	timeout = 1000000;
 	rdy = SDHCI_INT_SPACE_AVAIL | SDHCI_INT_DATA_AVAIL;
@@ -115,6 +110,205 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 	return 0;
 }
 
+#ifdef CONFIG_MMC_SDMA
+static unsigned int sdhci_sdma_setup(struct sdhci_host *host,
+				     struct mmc_data *data, int trans_bytes,
+				     int *is_aligned)
+{
+	unsigned int start_addr;
+	unsigned char ctrl;
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	if (data->flags == MMC_DATA_READ)
+		start_addr = (unsigned long)data->dest;
+	else
+		start_addr = (unsigned long)data->src;
+	if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+			(start_addr & 0x7) != 0x0) {
+		*is_aligned = 0;
+		start_addr = (unsigned long)aligned_buffer;
+		if (data->flags != MMC_DATA_READ)
+			memcpy(aligned_buffer, data->src, trans_bytes);
+	}
+
+#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
+	/*
+	 * Always use this bounce-buffer when
+	 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
+	 */
+	*is_aligned = 0;
+	start_addr = (unsigned long)aligned_buffer;
+	if (data->flags != MMC_DATA_READ)
+		memcpy(aligned_buffer, data->src, trans_bytes);
+#endif
+
+	sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
+
+	return start_addr;
+}
+#endif
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static uint sdhci_adma_desc_size(struct sdhci_host *host)
+{
+	return host->adma64 ? SDHCI_ADMA64_DESC_SIZE : SDHCI_ADMA32_DESC_SIZE;
+}
+
+static uint sdhci_adma_table_size(struct sdhci_host *host)
+{
+	uint descs;
+
+	descs = DIV_ROUND_UP(host->cfg.b_max * MMC_MAX_BLOCK_LEN,
+			     SDHCI_ADMA_MAX_LEN);
+
+	return ALIGN(descs * sdhci_adma_desc_size(host), ARCH_DMA_MINALIGN);
+}
+
+/*
+ * Describe the buffer of @data in an ADMA2 descriptor table. This fails if
+ * the controller cannot reach the buffer, in which case SDMA or PIO is used.
+ */
+static int sdhci_adma_build(struct sdhci_host *host, void *table,
+			    struct mmc_data *data)
+{
+	uint left = data->blocks * data->blocksize;
+	ulong addr = (ulong)data->dest;
+	ulong align = 3;
+	struct sdhci_adma_desc *desc = NULL;
+	u8 *ptr = table;
+	uint len;
+
+	if (host->adma64 || (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR))
+		align = 7;
+	if ((addr & align) || (left & 3) ||
+	    left > host->cfg.b_max * MMC_MAX_BLOCK_LEN)
+		return -EINVAL;
+	if (!host->adma64 && (u64)addr + left - 1 > 0xffffffffULL)
+		return -EINVAL;
+
+	while (left) {
+		len = min(left, (uint)SDHCI_ADMA_MAX_LEN);
+		desc = (struct sdhci_adma_desc *)ptr;
+		desc->attr = SDHCI_ADMA_VALID | SDHCI_ADMA_ACT_TRAN;
+		desc->reserved = 0;
+		desc->len = cpu_to_le16(len);
+		desc->addr_lo = cpu_to_le32((u32)addr);
+		if (host->adma64)
+			desc->addr_hi = cpu_to_le32((u64)addr >> 32);
+		addr += len;
+		left -= len;
+		ptr += sdhci_adma_desc_size(host);
+	}
+	desc->attr |= SDHCI_ADMA_END;
+	flush_cache((ulong)table, sdhci_adma_table_size(host));
+
+	return 0;
+}
+
+/*
+ * A struct mmc_data is often reused for the next transfer, so a prepared
+ * table is only used if everything it was built from is unchanged
+ */
+static bool sdhci_adma_match(struct sdhci_adma_prep *prep,
+			     struct mmc_data *data)
+{
+	return prep->data == data && prep->buf == data->src &&
+		prep->blocks == data->blocks &&
+		prep->blocksize == data->blocksize;
+}
+
+static void sdhci_adma_forget(struct sdhci_host *host)
+{
+	memset(host->adma_data, '\0', sizeof(host->adma_data));
+}
+
+/* Point the controller at an ADMA2 table for @data, if it can be used */
+static bool sdhci_adma_setup(struct sdhci_host *host, struct mmc_data *data)
+{
+	unsigned char ctrl;
+	ulong table;
+	int i;
+
+	if (!host->adma_table[0])
+		return false;
+
+	/* Use the table prepared by sdhci_prepare_data(), if any */
+	for (i = 0; i < 2; i++) {
+		if (sdhci_adma_match(&host->adma_data[i], data))
+			break;
+	}
+	if (i == 2) {
+		i = host->adma_data[0].data ? 1 : 0;
+		if (sdhci_adma_build(host, host->adma_table[i], data)) {
+			sdhci_adma_forget(host);
+			return false;
+		}
+	}
+	/* Only the transfer after this one can have been prepared since */
+	sdhci_adma_forget(host);
+	host->adma_cur = i;
+
+	table = (ulong)host->adma_table[i];
+	sdhci_writel(host, (u32)table, SDHCI_ADMA_ADDRESS);
+	if (host->adma64)
+		sdhci_writel(host, (u64)table >> 32, SDHCI_ADMA_ADDRESS_HI);
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= host->adma64 ? SDHCI_CTRL_ADMA64 : SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	flush_cache((ulong)data->dest, data->blocks * data->blocksize);
+
+	return true;
+}
+#else
+static bool sdhci_adma_setup(struct sdhci_host *host, struct mmc_data *data)
+{
+	return false;
+}
+
+static void sdhci_adma_forget(struct sdhci_host *host)
+{
+}
+#endif
+
+static int sdhci_finish_command(struct sdhci_host *host,
+				struct mmc_data *data, int ret, int bounce_bytes)
+{
+	unsigned int stat;
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	host->adma_cur = -1;
+#endif
+	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
+		udelay(1000);
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	if (!ret) {
+		if (bounce_bytes && (data->flags == MMC_DATA_READ))
+			memcpy(data->dest, aligned_buffer, bounce_bytes);
+		return 0;
+	}
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (stat & SDHCI_INT_ADMA_ERROR)
+		printf("%s: ADMA error 0x%x\n", __func__,
+		       sdhci_readl(host, SDHCI_ADMA_ERROR));
+#endif
+	sdhci_adma_forget(host);
+	sdhci_reset(host, SDHCI_RESET_CMD);
+	sdhci_reset(host, SDHCI_RESET_DATA);
+	if (stat & SDHCI_INT_TIMEOUT)
+		return TIMEOUT;
+	else
+		return COMM_ERR;
+}
+
 /*
  * No command will be sent by driver if card is busy, so driver must wait
  * for card ready state.
@@ -128,13 +322,19 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 #endif
 #define CONFIG_SDHCI_CMD_DEFAULT_TIMEOUT	100
 
-static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
-		       struct mmc_data *data)
+/*
+ * Send a command and, unless @async is set and the data is moved by ADMA,
+ * wait for its data transfer. In that case -EINPROGRESS is returned once the
+ * command has been accepted; see sdhci_poll_cmd().
+ */
+static int sdhci_do_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			    struct mmc_data *data, bool async)
 {
 	struct sdhci_host *host = mmc->priv;
 	unsigned int stat = 0;
 	int ret = 0;
 	int trans_bytes = 0, is_aligned = 1;
+	bool adma = false;
 	u32 mask, flags, mode;
 	unsigned int time = 0, start_addr = 0;
 	int mmc_dev = mmc->block_dev.dev;
@@ -160,6 +360,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 				       cmd_timeout);
 			} else {
 				puts("timeout.\n");
+				sdhci_adma_forget(host);
 				return COMM_ERR;
 			}
 		}
@@ -196,32 +397,15 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
+		adma = sdhci_adma_setup(host, data);
+		if (adma)
+			mode |= SDHCI_TRNS_DMA;
 #ifdef CONFIG_MMC_SDMA
-		if (data->flags == MMC_DATA_READ)
-			start_addr = (unsigned long)data->dest;
-		else
-			start_addr = (unsigned long)data->src;
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				(start_addr & 0x7) != 0x0) {
-			is_aligned = 0;
-			start_addr = (unsigned long)aligned_buffer;
-			if (data->flags != MMC_DATA_READ)
-				memcpy(aligned_buffer, data->src, trans_bytes);
+		if (!adma) {
+			start_addr = sdhci_sdma_setup(host, data, trans_bytes,
+						      &is_aligned);
+			mode |= SDHCI_TRNS_DMA;
 		}
-
-#if defined(CONFIG_FIXED_SDHCI_ALIGNED_BUFFER)
-		/*
-		 * Always use this bounce-buffer when
-		 * CONFIG_FIXED_SDHCI_ALIGNED_BUFFER is defined
-		 */
-		is_aligned = 0;
-		start_addr = (unsigned long)aligned_buffer;
-		if (data->flags != MMC_DATA_READ)
-			memcpy(aligned_buffer, data->src, trans_bytes);
-#endif
-
-		sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
-		mode |= SDHCI_TRNS_DMA;
 #endif
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
@@ -234,7 +418,8 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
 #ifdef CONFIG_MMC_SDMA
-	flush_cache(start_addr, trans_bytes);
+	if (!adma)
+		flush_cache(start_addr, trans_bytes);
 #endif
 	sdhci_writew(host, SDHCI_MAKE_CMD(cmd->cmdidx, flags), SDHCI_COMMAND);
 	start = get_timer(0);
@@ -246,6 +431,10 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		 (get_timer(start) < CONFIG_SDHCI_CMD_DEFAULT_TIMEOUT));
 
 	if (get_timer(start) >= CONFIG_SDHCI_CMD_DEFAULT_TIMEOUT) {
+		sdhci_adma_forget(host);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		host->adma_cur = -1;
+#endif
 		if (host->quirks & SDHCI_QUIRK_BROKEN_R1B)
 			return 0;
 		else {
@@ -260,28 +449,105 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	} else
 		ret = -1;
 
-	if (!ret && data)
+	if (!ret && data) {
+		if (async && adma)
+			return -EINPROGRESS;
 		ret = sdhci_transfer_data(host, data, start_addr);
+	}
 
-	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
-		udelay(1000);
+	if (!(host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) || is_aligned)
+		trans_bytes = 0;
+
+	return sdhci_finish_command(host, data, ret, trans_bytes);
+}
+
+static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	return sdhci_do_command(mmc, cmd, data, false);
+}
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+/* Time allowed for a queued ADMA transfer, as for sdhci_transfer_data() */
+#define SDHCI_ADMA_TIMEOUT_MS	10000
+
+static int sdhci_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data)
+{
+	struct sdhci_host *host = mmc->priv;
+	int ret;
+
+	if (host->async_busy)
+		return -EBUSY;
+
+	/* Anything that cannot use ADMA is simply done straight away */
+	ret = sdhci_do_command(mmc, cmd, data, true);
+	if (ret == -EINPROGRESS) {
+		host->async_busy = true;
+		host->async_start = get_timer(0);
+		ret = 0;
+	}
+	host->async_ret = ret;
+
+	return 0;
+}
+
+static int sdhci_poll_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	struct sdhci_host *host = mmc->priv;
+	unsigned int stat;
+	int ret = 0;
+
+	if (!host->async_busy)
+		return host->async_ret;
 
 	stat = sdhci_readl(host, SDHCI_INT_STATUS);
-	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
-	if (!ret) {
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
-			memcpy(data->dest, aligned_buffer, trans_bytes);
+	if (stat & SDHCI_INT_ERROR) {
+		printf("%s: Error detected in status(0x%X)!\n", __func__,
+		       stat);
+		ret = -1;
+	} else if (!(stat & SDHCI_INT_DATA_END)) {
+		if (get_timer(host->async_start) < SDHCI_ADMA_TIMEOUT_MS)
+			return -EBUSY;
+		printf("%s: Transfer data timeout\n", __func__);
+		ret = -1;
+	}
+	host->async_busy = false;
+
+	return sdhci_finish_command(host, data, ret, 0);
+}
+
+/*
+ * Build the descriptors for the next transfer while the current one runs.
+ * A NULL @data means that the queue is empty and drops any prepared table.
+ */
+static int sdhci_prepare_data(struct mmc *mmc, struct mmc_data *data)
+{
+	struct sdhci_host *host = mmc->priv;
+	int i = host->adma_cur == 0 ? 1 : 0;
+	struct sdhci_adma_prep *prep = &host->adma_data[i];
+	int ret;
+
+	if (!data) {
+		sdhci_adma_forget(host);
 		return 0;
 	}
+	if (!host->adma_table[0])
+		return -ENOSYS;
+
+	memset(prep, '\0', sizeof(*prep));
+	ret = sdhci_adma_build(host, host->adma_table[i], data);
+	if (ret)
+		return ret;
+	prep->data = data;
+	prep->buf = data->src;
+	prep->blocks = data->blocks;
+	prep->blocksize = data->blocksize;
 
-	sdhci_reset(host, SDHCI_RESET_CMD);
-	sdhci_reset(host, SDHCI_RESET_DATA);
-	if (stat & SDHCI_INT_TIMEOUT)
-		return TIMEOUT;
-	else
-		return COMM_ERR;
+	return 0;
 }
+#endif
 
 static int sdhci_set_clock(struct mmc *mmc, unsigned int clock)
 {
@@ -372,6 +638,60 @@ static void sdhci_set_power(struct sdhci_host *host, unsigned short power)
 	sdhci_writeb(host, pwr, SDHCI_POWER_CONTROL);
 }
 
+#ifdef MMC_SUPPORTS_TUNING
+/*
+ * Program the UHS mode for the card's timing. The SD clock is stopped
+ * if the mode changes, so true is returned to have it started again.
+ */
+static bool sdhci_set_uhs_timing(struct sdhci_host *host, uint timing)
+{
+	u16 ctrl2, mode;
+
+	if (SDHCI_GET_VERSION(host) < SDHCI_SPEC_300)
+		return false;
+
+	ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+
+	switch (timing) {
+	case MMC_TIMING_MMC_HS:
+	case MMC_TIMING_SD_HS:
+		mode = SDHCI_CTRL_UHS_SDR25;
+		break;
+	case MMC_TIMING_UHS_SDR50:
+		mode = SDHCI_CTRL_UHS_SDR50;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+	case MMC_TIMING_MMC_HS200:
+		mode = SDHCI_CTRL_UHS_SDR104;
+		break;
+	case MMC_TIMING_MMC_HS400:
+		mode = SDHCI_CTRL_HS400;
+		break;
+	default:
+		mode = SDHCI_CTRL_UHS_SDR12;
+		break;
+	}
+
+	/* The mode is only meaningful with 1.8V signalling */
+	if (!(ctrl2 & SDHCI_CTRL_VDD_180))
+		mode = SDHCI_CTRL_UHS_SDR12;
+
+	if ((ctrl2 & SDHCI_CTRL_UHS_MASK) == mode)
+		return false;
+
+	sdhci_writew(host, 0, SDHCI_CLOCK_CONTROL);
+	ctrl2 = (ctrl2 & ~SDHCI_CTRL_UHS_MASK) | mode;
+	sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+
+	return true;
+}
+#else
+static inline bool sdhci_set_uhs_timing(struct sdhci_host *host, uint timing)
+{
+	return false;
+}
+#endif
+
 static void sdhci_set_ios(struct mmc *mmc)
 {
 	u32 ctrl;
@@ -380,7 +700,8 @@ static void sdhci_set_ios(struct mmc *mmc)
 	if (host->set_control_reg)
 		host->set_control_reg(host);
 
-	if (mmc->clock != host->clock)
+	if (sdhci_set_uhs_timing(host, mmc->timing) ||
+	    mmc->clock != host->clock)
 		sdhci_set_clock(mmc, mmc->clock);
 
 	/* Set bus width */
@@ -411,6 +732,153 @@ static void sdhci_set_ios(struct mmc *mmc)
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
 }
 
+#ifdef MMC_SUPPORTS_TUNING
+static int sdhci_set_signal_voltage(struct mmc *mmc, uint voltage)
+{
+	struct sdhci_host *host = mmc->priv;
+	u16 ctrl2, clk;
+
+	if (SDHCI_GET_VERSION(host) < SDHCI_SPEC_300)
+		return -ENOSYS;
+
+	ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+
+	if (voltage == MMC_SIGNAL_VOLTAGE_330) {
+		sdhci_writew(host, ctrl2 & ~SDHCI_CTRL_VDD_180,
+			     SDHCI_HOST_CONTROL2);
+		mdelay(5);
+		if (sdhci_readw(host, SDHCI_HOST_CONTROL2) & SDHCI_CTRL_VDD_180)
+			return -EIO;
+		return 0;
+	}
+
+	if (host->quirks & SDHCI_QUIRK_NO_1_8_V)
+		return -ENOSYS;
+
+	/* Stop the SD clock while the I/O voltage changes */
+	clk = sdhci_readw(host, SDHCI_CLOCK_CONTROL);
+	sdhci_writew(host, clk & ~SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+
+	sdhci_writew(host, ctrl2 | SDHCI_CTRL_VDD_180, SDHCI_HOST_CONTROL2);
+
+	/* The regulator has 5ms to settle */
+	mdelay(5);
+	if (!(sdhci_readw(host, SDHCI_HOST_CONTROL2) & SDHCI_CTRL_VDD_180))
+		return -EIO;
+
+	sdhci_writew(host, clk | SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+	mdelay(1);
+
+	/* A card which has switched drives DAT[3:0] high */
+	if ((sdhci_readl(host, SDHCI_PRESENT_STATE) & SDHCI_DATA_LVL_MASK) !=
+	    SDHCI_DATA_LVL_MASK)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Send one tuning command. The controller keeps the tuning block to itself,
+ * so only the buffer-read-ready status tells us that it has arrived.
+ */
+static int sdhci_send_tuning(struct sdhci_host *host, uint opcode,
+			     uint blksz)
+{
+	u32 flags, stat;
+	ulong start;
+
+	flags = SDHCI_CMD_RESP_SHORT | SDHCI_CMD_CRC | SDHCI_CMD_INDEX |
+		SDHCI_CMD_DATA;
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG, blksz),
+		     SDHCI_BLOCK_SIZE);
+	sdhci_writew(host, 1, SDHCI_BLOCK_COUNT);
+	sdhci_writew(host, SDHCI_TRNS_READ, SDHCI_TRANSFER_MODE);
+	sdhci_writel(host, 0, SDHCI_ARGUMENT);
+	sdhci_writew(host, SDHCI_MAKE_CMD(opcode, flags), SDHCI_COMMAND);
+
+	start = get_timer(0);
+	do {
+		stat = sdhci_readl(host, SDHCI_INT_STATUS);
+		if (stat & SDHCI_INT_DATA_AVAIL) {
+			sdhci_writel(host, stat, SDHCI_INT_STATUS);
+			return 0;
+		}
+	} while (get_timer(start) < 50);
+
+	return -ETIMEDOUT;
+}
+
+static int sdhci_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct sdhci_host *host = mmc->priv;
+	uint blksz = mmc->bus_width == 8 ? 128 : 64;
+	u16 ctrl2;
+	int i;
+
+	/* SDR50 only needs tuning if the controller says so */
+	if (mmc->timing == MMC_TIMING_UHS_SDR50 &&
+	    !(sdhci_readl(host, SDHCI_CAPABILITIES_1) & SDHCI_USE_SDR50_TUNING))
+		return 0;
+
+	ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+	ctrl2 &= ~SDHCI_CTRL_TUNED_CLK;
+	ctrl2 |= SDHCI_CTRL_EXEC_TUNING;
+	sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+
+	/* Send the tuning block until the controller is done with it */
+	for (i = 0; i < SDHCI_TUNING_LOOPS; i++) {
+		if (sdhci_send_tuning(host, opcode, blksz))
+			break;
+		ctrl2 = sdhci_readw(host, SDHCI_HOST_CONTROL2);
+		if (!(ctrl2 & SDHCI_CTRL_EXEC_TUNING))
+			break;
+	}
+
+	sdhci_reset(host, SDHCI_RESET_CMD | SDHCI_RESET_DATA);
+
+	if (ctrl2 & SDHCI_CTRL_EXEC_TUNING) {
+		ctrl2 &= ~(SDHCI_CTRL_EXEC_TUNING | SDHCI_CTRL_TUNED_CLK);
+		sdhci_writew(host, ctrl2, SDHCI_HOST_CONTROL2);
+		return -ETIMEDOUT;
+	}
+
+	/* Without a sampling point the controller uses the fixed clock */
+	if (!(ctrl2 & SDHCI_CTRL_TUNED_CLK))
+		return -EIO;
+
+	return 0;
+}
+
+/* Host capabilities for UHS-I and HS200/HS400 from CAPABILITIES_1 */
+static uint sdhci_tuning_caps(struct sdhci_host *host, unsigned int caps)
+{
+	uint host_caps = 0;
+	u32 caps1;
+
+	if (SDHCI_GET_VERSION(host) < SDHCI_SPEC_300 ||
+	    (host->quirks & SDHCI_QUIRK_NO_1_8_V))
+		return 0;
+
+	caps1 = sdhci_readl(host, SDHCI_CAPABILITIES_1);
+#ifdef CONFIG_MMC_UHS_SUPPORT
+	if (caps1 & (SDHCI_SUPPORT_SDR50 | SDHCI_SUPPORT_SDR104))
+		host_caps |= MMC_MODE_UHS_SDR50;
+	if (caps1 & SDHCI_SUPPORT_SDR104)
+		host_caps |= MMC_MODE_UHS_SDR104;
+#endif
+#ifdef CONFIG_MMC_HS200_SUPPORT
+	/* HS200 is SDR104 timing on an eMMC bus */
+	if (caps1 & SDHCI_SUPPORT_SDR104)
+		host_caps |= MMC_MODE_HS200;
+	if ((caps1 & SDHCI_SUPPORT_HS400) && (caps & SDHCI_CAN_DO_8BIT))
+		host_caps |= MMC_MODE_HS400;
+#endif
+
+	return host_caps;
+}
+#endif
+
 static int sdhci_init(struct mmc *mmc)
 {
 	struct sdhci_host *host = mmc->priv;
@@ -453,8 +921,47 @@ static const struct mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
 	.init		= sdhci_init,
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	.start_cmd	= sdhci_start_cmd,
+	.poll_cmd	= sdhci_poll_cmd,
+	.prepare_data	= sdhci_prepare_data,
+#endif
+#ifdef MMC_SUPPORTS_TUNING
+	.set_signal_voltage = sdhci_set_signal_voltage,
+	.execute_tuning	= sdhci_execute_tuning,
+#endif
 };
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static void sdhci_adma_init(struct sdhci_host *host, unsigned int caps)
+{
+	int i;
+
+	host->adma_cur = -1;
+	host->async_busy = false;
+	sdhci_adma_forget(host);
+	for (i = 0; i < 2; i++)
+		host->adma_table[i] = NULL;
+
+#ifndef CONFIG_FIXED_SDHCI_ALIGNED_BUFFER
+	if (!(caps & SDHCI_CAN_DO_ADMA2))
+		return;
+
+	host->adma64 = sizeof(ulong) > 4 && (caps & SDHCI_CAN_64BIT);
+	for (i = 0; i < 2; i++) {
+		host->adma_table[i] = memalign(ARCH_DMA_MINALIGN,
+					       sdhci_adma_table_size(host));
+		if (!host->adma_table[i]) {
+			/* Carry on without ADMA */
+			free(host->adma_table[0]);
+			host->adma_table[0] = NULL;
+			return;
+		}
+	}
+#endif
+}
+#endif
+
 int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 {
 	unsigned int caps;
@@ -514,11 +1021,17 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 		if (caps & SDHCI_CAN_DO_8BIT)
 			host->cfg.host_caps |= MMC_MODE_8BIT;
 	}
+#ifdef MMC_SUPPORTS_TUNING
+	host->cfg.host_caps |= sdhci_tuning_caps(host, caps);
+#endif
 	if (host->host_caps)
 		host->cfg.host_caps |= host->host_caps;
 
 	host->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	sdhci_adma_init(host, caps);
+#endif
 	sdhci_reset(host, SDHCI_RESET_ALL);
 
 	host->mmc = mmc_create(&host->cfg, host);
@@ -0,0 +1,237 @@
+/*
+ * NAND flash simulator for sandbox
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ *
+ * This simulates a 1GiB large-page SLC chip (2KiB pages, 128KiB blocks)
+ * behind a controller without hardware ECC, so that nand_base.c uses
+ * software ECC with sub-page reads and writes. Pages are kept in host
+ * memory and only allocated once programmed, so an erased chip costs
+ * little.
+ *
+ * Loading a page from the array takes CONFIG_NAND_SANDBOX_READ_US, so that
+ * the time spent by e.g. a UBI attach reflects the number of page loads as
+ * it would on real flash. Programming and erasing are immediate.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <nand.h>
+#include <os.h>
+
+/* Samsung K9F8G08U0M: 1GiB, 2KiB pages, 64 byte OOB, 128KiB blocks */
+static const u8 sandbox_nand_id[] = {
+	NAND_MFR_SAMSUNG, 0xd3, 0x51, 0x95, 0x58
+};
+
+#define SB_NAND_PAGE_SIZE	2048
+#define SB_NAND_OOB_SIZE	64
+#define SB_NAND_RAW_SIZE	(SB_NAND_PAGE_SIZE + SB_NAND_OOB_SIZE)
+#define SB_NAND_PAGES_PER_BLOCK	64
+#define SB_NAND_PAGES		(1024 << 20 >> 11)
+
+enum sandbox_nand_mode {
+	SB_NAND_IDLE,
+	SB_NAND_ID,
+	SB_NAND_STATUS,
+	SB_NAND_READ,
+	SB_NAND_PROG,
+};
+
+/**
+ * struct sandbox_nand - state of the simulated chip
+ *
+ * @pages: Contents of each page and its OOB, NULL while erased
+ * @buf: Page register, holding the page being read or programmed
+ * @mode: What read_byte()/read_buf() return
+ * @page: Page being programmed
+ * @pos: Position in @buf or the ID
+ */
+struct sandbox_nand {
+	u8 **pages;
+	u8 buf[SB_NAND_RAW_SIZE];
+	enum sandbox_nand_mode mode;
+	int page;
+	int pos;
+};
+
+static struct sandbox_nand sandbox_nand;
+
+/* Load a page into the page register, taking as long as the array would */
+static void sandbox_nand_load(struct sandbox_nand *priv, int page)
+{
+	uint64_t end;
+
+	if (page >= 0 && page < SB_NAND_PAGES && priv->pages[page])
+		memcpy(priv->buf, priv->pages[page], SB_NAND_RAW_SIZE);
+	else
+		memset(priv->buf, 0xff, SB_NAND_RAW_SIZE);
+
+	end = os_get_nsec() + CONFIG_NAND_SANDBOX_READ_US * 1000ULL;
+	while (os_get_nsec() < end)
+		;
+}
+
+static int sandbox_nand_program(struct sandbox_nand *priv)
+{
+	u8 *data;
+	int i;
+
+	if (priv->page < 0 || priv->page >= SB_NAND_PAGES)
+		return -EINVAL;
+
+	data = priv->pages[priv->page];
+	if (!data) {
+		data = os_malloc(SB_NAND_RAW_SIZE);
+		if (!data)
+			return -ENOMEM;
+		memset(data, 0xff, SB_NAND_RAW_SIZE);
+		priv->pages[priv->page] = data;
+	}
+
+	/* Programming can only clear bits */
+	for (i = 0; i < SB_NAND_RAW_SIZE; i++)
+		data[i] &= priv->buf[i];
+
+	return 0;
+}
+
+static void sandbox_nand_erase(struct sandbox_nand *priv, int page)
+{
+	int i;
+
+	page &= ~(SB_NAND_PAGES_PER_BLOCK - 1);
+	if (page < 0 || page >= SB_NAND_PAGES)
+		return;
+
+	for (i = page; i < page + SB_NAND_PAGES_PER_BLOCK; i++) {
+		os_free(priv->pages[i]);
+		priv->pages[i] = NULL;
+	}
+}
+
+static void sandbox_nand_cmdfunc(struct mtd_info *mtd, unsigned command,
+				 int column, int page_addr)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	switch (command) {
+	case NAND_CMD_RESET:
+		priv->mode = SB_NAND_IDLE;
+		break;
+	case NAND_CMD_READID:
+		/* Only the JEDEC ID at address 0; no ONFI/JEDEC parameters */
+		priv->mode = SB_NAND_ID;
+		priv->pos = column ? ARRAY_SIZE(sandbox_nand_id) : 0;
+		break;
+	case NAND_CMD_STATUS:
+		priv->mode = SB_NAND_STATUS;
+		break;
+	case NAND_CMD_READ0:
+		sandbox_nand_load(priv, page_addr);
+		priv->mode = SB_NAND_READ;
+		priv->pos = column;
+		break;
+	case NAND_CMD_READOOB:
+		sandbox_nand_load(priv, page_addr);
+		priv->mode = SB_NAND_READ;
+		priv->pos = SB_NAND_PAGE_SIZE + column;
+		break;
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+		priv->pos = column;
+		break;
+	case NAND_CMD_SEQIN:
+		memset(priv->buf, 0xff, SB_NAND_RAW_SIZE);
+		priv->mode = SB_NAND_PROG;
+		priv->page = page_addr;
+		priv->pos = column;
+		break;
+	case NAND_CMD_PAGEPROG:
+		if (sandbox_nand_program(priv))
+			printf("%s: cannot program page %d\n", __func__,
+			       priv->page);
+		priv->mode = SB_NAND_IDLE;
+		break;
+	case NAND_CMD_ERASE1:
+		sandbox_nand_erase(priv, page_addr);
+		break;
+	case NAND_CMD_ERASE2:
+		break;
+	default:
+		debug("%s: unsupported command %#x\n", __func__, command);
+		break;
+	}
+}
+
+static uint8_t sandbox_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	switch (priv->mode) {
+	case SB_NAND_ID:
+		if (priv->pos < ARRAY_SIZE(sandbox_nand_id))
+			return sandbox_nand_id[priv->pos++];
+		return 0;
+	case SB_NAND_STATUS:
+		return NAND_STATUS_READY | NAND_STATUS_WP;
+	case SB_NAND_READ:
+		if (priv->pos < SB_NAND_RAW_SIZE)
+			return priv->buf[priv->pos++];
+		return 0xff;
+	default:
+		return 0xff;
+	}
+}
+
+static void sandbox_nand_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = sandbox_nand_read_byte(mtd);
+}
+
+static void sandbox_nand_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+				   int len)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	if (priv->mode != SB_NAND_PROG || priv->pos < 0 ||
+	    priv->pos + len > SB_NAND_RAW_SIZE)
+		return;
+
+	memcpy(priv->buf + priv->pos, buf, len);
+	priv->pos += len;
+}
+
+static void sandbox_nand_select_chip(struct mtd_info *mtd, int chip)
+{
+}
+
+static int sandbox_nand_dev_ready(struct mtd_info *mtd)
+{
+	return 1;
+}
+
+int board_nand_init(struct nand_chip *nand)
+{
+	struct sandbox_nand *priv = &sandbox_nand;
+
+	if (!priv->pages) {
+		priv->pages = os_malloc(SB_NAND_PAGES * sizeof(*priv->pages));
+		if (!priv->pages)
+			return -ENOMEM;
+		memset(priv->pages, '\0', SB_NAND_PAGES * sizeof(*priv->pages));
+	}
+
+	nand->cmdfunc = sandbox_nand_cmdfunc;
+	nand->read_byte = sandbox_nand_read_byte;
+	nand->read_buf = sandbox_nand_read_buf;
+	nand->write_buf = sandbox_nand_write_buf;
+	nand->select_chip = sandbox_nand_select_chip;
+	nand->dev_ready = sandbox_nand_dev_ready;
+	nand->ecc.mode = NAND_ECC_SOFT;
+
+	return 0;
+}
@@ -76,18 +76,23 @@
 #include <linux/crc32.h>
 #include <linux/random.h>
 #else
+#include <ubi_uboot.h>
 #include <div64.h>
 #include <linux/err.h>
 #endif
 
 #include <linux/math64.h>
 
-#include <ubi_uboot.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
 
-/* Temporary variables used during scanning */
+/*
+ * Temporary variables used during scanning. Both headers share one buffer,
+ * laid out as they are at the start of a PEB, so that they can be read
+ * from the flash together.
+ */
+static void *hdrs;
 static struct ubi_ec_hdr *ech;
 static struct ubi_vid_hdr *vidh;
 
@@ -799,6 +804,57 @@ out_unlock:
 	return err;
 }
 
+/**
+ * alloc_hdrs - allocate the header buffer used during scanning.
+ * @ubi: UBI device description object
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int alloc_hdrs(struct ubi_device *ubi)
+{
+	hdrs = kzalloc(ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize, GFP_KERNEL);
+	if (!hdrs)
+		return -ENOMEM;
+
+	ech = hdrs;
+	vidh = hdrs + ubi->vid_hdr_aloffset + ubi->vid_hdr_shift;
+
+	return 0;
+}
+
+static void free_hdrs(void)
+{
+	kfree(hdrs);
+	hdrs = NULL;
+}
+
+/**
+ * read_hdrs - read both UBI headers of a PEB with one flash read.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock number
+ *
+ * When both headers are in the same min. I/O unit (NAND with sub-pages),
+ * reading them one after the other costs two loads of the same page from
+ * the array if the NAND driver reads sub-pages, since it then does not
+ * keep the page in its page buffer. This reads them together instead.
+ * Other NAND drivers already serve the second read from the page buffer,
+ * and on NOR the min. I/O unit is one byte, so the headers are read one
+ * by one there as before.
+ *
+ * Returns %1 if both headers were read without bit-flips or ECC errors
+ * and only need checking, or %0 if they have to be read one by one, which
+ * also makes sure that such errors are put down to the right header.
+ */
+static int read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+
+	if (len > ubi->min_io_size)
+		return 0;
+
+	return !ubi_io_read(ubi, hdrs, pnum, 0, len);
+}
+
 /**
  * scan_peb - scan and process UBI headers of a PEB.
  * @ubi: UBI device description object
@@ -816,7 +872,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		    int pnum, int *vid, unsigned long long *sqnum)
 {
 	long long uninitialized_var(ec);
-	int err, bitflips = 0, vol_id = -1, ec_err = 0;
+	int err, read, bitflips = 0, vol_id = -1, ec_err = 0;
 
 	dbg_bld("scan PEB %d", pnum);
 
@@ -829,7 +885,11 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	read = read_hdrs(ubi, pnum);
+	if (read)
+		err = ubi_io_check_ec_hdr(ubi, pnum, ech, 0, 0);
+	else
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -912,7 +972,10 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
+	if (read)
+		err = ubi_io_check_vid_hdr(ubi, pnum, vidh, 0, 0);
+	else
+		err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1228,27 +1291,29 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+#ifdef __UBOOT__
+	ulong time = get_timer(0);
+#endif
 
-	err = -ENOMEM;
-
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
+	err = alloc_hdrs(ubi);
+	if (err)
 		return err;
 
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
-
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
 		dbg_gen("process PEB %d", pnum);
 		err = scan_peb(ubi, ai, pnum, NULL, NULL);
 		if (err < 0)
-			goto out_vidh;
+			goto out_hdrs;
 	}
 
+#ifdef __UBOOT__
+	ubi_msg(ubi, "scanning is finished, %d PEBs in %lu ms",
+		ubi->peb_count - start, get_timer(time));
+#else
 	ubi_msg(ubi, "scanning is finished");
+#endif
 
 	/* Calculate mean erase counter */
 	if (ai->ec_count)
@@ -1256,7 +1321,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	err = late_analysis(ubi, ai);
 	if (err)
-		goto out_vidh;
+		goto out_hdrs;
 
 	/*
 	 * In case of unknown erase counter we use the mean erase counter
@@ -1283,17 +1348,14 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	err = self_check_ai(ubi, ai);
 	if (err)
-		goto out_vidh;
+		goto out_hdrs;
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+	free_hdrs();
 
 	return 0;
 
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
+out_hdrs:
+	free_hdrs();
 	return err;
 }
 
@@ -1338,15 +1400,9 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	int err, pnum, fm_anchor = -1;
 	unsigned long long max_sqnum = 0;
 
-	err = -ENOMEM;
-
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
-		goto out;
-
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
+	err = alloc_hdrs(ubi);
+	if (err)
+		return err;
 
 	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum++) {
 		int vol_id = -1;
@@ -1356,7 +1412,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 		dbg_gen("process PEB %d", pnum);
 		err = scan_peb(ubi, *ai, pnum, &vol_id, &sqnum);
 		if (err < 0)
-			goto out_vidh;
+			goto out_hdrs;
 
 		if (vol_id == UBI_FM_SB_VOLUME_ID && sqnum > max_sqnum) {
 			max_sqnum = sqnum;
@@ -1364,8 +1420,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 		}
 	}
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+	free_hdrs();
 
 	if (fm_anchor < 0)
 		return UBI_NO_FASTMAP;
@@ -1377,11 +1432,8 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 
 	return ubi_scan_fastmap(ubi, *ai, fm_anchor);
 
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
-out:
+out_hdrs:
+	free_hdrs();
 	return err;
 }
 
@@ -1399,6 +1451,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+#ifdef __UBOOT__
+	ulong time = get_timer(0);
+#endif
 
 	ai = alloc_ai();
 	if (!ai)
@@ -1477,6 +1532,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	}
 #endif
 
+#ifdef __UBOOT__
+	ubi_msg(ubi, "attached in %lu ms", get_timer(time));
+#endif
 	destroy_ai(ai);
 	return 0;
 
@@ -724,8 +724,7 @@ bad:
 int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		       struct ubi_ec_hdr *ec_hdr, int verbose)
 {
-	int err, read_err;
-	uint32_t crc, magic, hdr_crc;
+	int read_err;
 
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
@@ -746,6 +745,27 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		 */
 	}
 
+	return ubi_io_check_ec_hdr(ubi, pnum, ec_hdr, read_err, verbose);
+}
+
+/**
+ * ubi_io_check_ec_hdr - check an erase counter header which has been read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock the header was read from
+ * @ec_hdr: the erase counter header
+ * @read_err: what 'ubi_io_read()' returned for the header: %0,
+ * %UBI_IO_BITFLIPS or an ECC error
+ * @verbose: be verbose if the header is corrupted or was not found
+ *
+ * This is 'ubi_io_read_ec_hdr()' for callers which have read the header
+ * themselves, e.g. together with the VID header. It returns the same codes.
+ */
+int ubi_io_check_ec_hdr(struct ubi_device *ubi, int pnum,
+			struct ubi_ec_hdr *ec_hdr, int read_err, int verbose)
+{
+	int err;
+	uint32_t crc, magic, hdr_crc;
+
 	magic = be32_to_cpu(ec_hdr->magic);
 	if (magic != UBI_EC_HDR_MAGIC) {
 		if (mtd_is_eccerr(read_err))
@@ -997,8 +1017,7 @@ bad:
 int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_hdr *vid_hdr, int verbose)
 {
-	int err, read_err;
-	uint32_t crc, magic, hdr_crc;
+	int read_err;
 	void *p;
 
 	dbg_io("read VID header from PEB %d", pnum);
@@ -1010,6 +1029,27 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
+	return ubi_io_check_vid_hdr(ubi, pnum, vid_hdr, read_err, verbose);
+}
+
+/**
+ * ubi_io_check_vid_hdr - check a volume identifier header which has been read.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock the header was read from
+ * @vid_hdr: the volume identifier header
+ * @read_err: what 'ubi_io_read()' returned for the header: %0,
+ * %UBI_IO_BITFLIPS or an ECC error
+ * @verbose: be verbose if the header is corrupted or wasn't found
+ *
+ * This is 'ubi_io_read_vid_hdr()' for callers which have read the header
+ * themselves. It returns the same codes.
+ */
+int ubi_io_check_vid_hdr(struct ubi_device *ubi, int pnum,
+			 struct ubi_vid_hdr *vid_hdr, int read_err, int verbose)
+{
+	int err;
+	uint32_t crc, magic, hdr_crc;
+
 	magic = be32_to_cpu(vid_hdr->magic);
 	if (magic != UBI_VID_HDR_MAGIC) {
 		if (mtd_is_eccerr(read_err))
@@ -102,6 +102,21 @@ static int sb_eth_raw_recv(struct udevice *dev, int flags, uchar **packetp)
 		uchar *pktptr = priv->local ?
 			net_rx_packets[0] + ETHER_HDR_SIZE : net_rx_packets[0];
 
+#ifdef CONFIG_NET_RX_PLACE
+		/* Split the headers from the payload, which goes into place */
+		if (net_rx_target.buf) {
+			int hdr_len = net_rx_target.hdr_len;
+
+			if (priv->local)
+				hdr_len -= ETHER_HDR_SIZE;
+			retval = sandbox_eth_raw_os_recv_split(pktptr, hdr_len,
+					net_rx_target.buf, net_rx_target.len,
+					&length, priv);
+			if (!retval && length > hdr_len)
+				net_rx_target.placed = min(length - hdr_len,
+							   net_rx_target.len);
+		} else
+#endif
 		retval = sandbox_eth_raw_os_recv(pktptr, &length, priv);
 	}
 
@@ -11,10 +11,19 @@
 #include <dm.h>
 #include <malloc.h>
 #include <net.h>
+#include <asm/eth.h>
 #include <asm/test.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* TFTP opcodes and the port the fake host serves TFTP from */
+#define SB_TFTP_RRQ	1
+#define SB_TFTP_DATA	3
+#define SB_TFTP_ACK	4
+#define SB_TFTP_OACK	6
+#define SB_TFTP_PORT	69
+#define SB_TFTP_TID	1069
+
 /**
  * struct eth_sandbox_priv - memory for sandbox mock driver
  *
@@ -22,16 +31,25 @@ DECLARE_GLOBAL_DATA_PTR;
  * fake_host_ipaddr: IP address of mocked machine
  * recv_packet_buffer: buffer of the packet returned as received
  * recv_packet_length: length of the packet returned as received
+ * tftp_blksize: block size of the TFTP transfer being served
+ * tftp_block: number of the last TFTP data block sent, not wrapped at 64K
+ * tftp_done: true once the last TFTP data block has been sent
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
 	uchar *recv_packet_buffer;
 	int recv_packet_length;
+	int tftp_blksize;
+	ulong tftp_block;
+	bool tftp_done;
 };
 
 static bool disabled[8] = {false};
 static bool skip_timeout;
+static int tftp_size = -1;
+static ulong tftp_bad_block;
+static int tftp_placed;
 
 /*
  * sandbox_eth_disable_response()
@@ -54,6 +72,46 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_tftp_serve()
+ *
+ * Make the fake host serve a file of the given size over TFTP, whatever
+ * name is asked for. The contents are given by sandbox_eth_tftp_byte().
+ *
+ * size - Size of the file, or -1 to stop serving it
+ * bad_block - Number of a data block (not wrapped at 64K) whose payload is
+ *	corrupted after its UDP checksum is worked out, the first time it is
+ *	sent, or 0 for none
+ */
+void sandbox_eth_tftp_serve(int size, ulong bad_block)
+{
+	tftp_size = size;
+	tftp_bad_block = bad_block;
+	tftp_placed = 0;
+}
+
+/*
+ * sandbox_eth_tftp_byte()
+ *
+ * Return the byte at a given offset of the file served over TFTP. Blocks
+ * stored at the wrong offset, even a multiple of 64K blocks away, show up.
+ */
+u8 sandbox_eth_tftp_byte(ulong offset)
+{
+	return offset * 7 + (offset >> 8) + (offset >> 16) * 3;
+}
+
+/*
+ * sandbox_eth_tftp_placed()
+ *
+ * Return the number of packets whose payload was received straight into
+ * place (see struct net_rx_target) since sandbox_eth_tftp_serve()
+ */
+int sandbox_eth_tftp_placed(void)
+{
+	return tftp_placed;
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -66,6 +124,138 @@ static int sb_eth_start(struct udevice *dev)
 	return 0;
 }
 
+/* Start a reply to a UDP packet, from the port it was sent to */
+static struct ip_udp_hdr *sb_eth_udp_reply(struct eth_sandbox_priv *priv,
+					   void *packet, int sport)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ipr;
+
+	eth_recv = (void *)priv->recv_packet_buffer;
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ipr = (void *)priv->recv_packet_buffer + ETHER_HDR_SIZE;
+	memcpy(ipr, ip, IP_UDP_HDR_SIZE);
+	ipr->ip_off = 0;
+	net_copy_ip((void *)&ipr->ip_dst, &ip->ip_src);
+	net_copy_ip((void *)&ipr->ip_src, &ip->ip_dst);
+	ipr->udp_src = htons(sport);
+	ipr->udp_dst = ip->udp_src;
+
+	return ipr;
+}
+
+/* Fill in the lengths and checksums of a UDP reply with @len bytes of data */
+static void sb_eth_udp_send(struct eth_sandbox_priv *priv,
+			    struct ip_udp_hdr *ipr, int len)
+{
+	uchar *p = (uchar *)&ipr->udp_src;
+	ulong xsum;
+	int i;
+
+	ipr->ip_len = htons(IP_UDP_HDR_SIZE + len);
+	ipr->ip_sum = 0;
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	ipr->udp_xsum = 0;
+
+	xsum = IPPROTO_UDP + UDP_HDR_SIZE + len;
+	xsum += ntohl(ipr->ip_src.s_addr) >> 16;
+	xsum += ntohl(ipr->ip_src.s_addr) & 0xffff;
+	xsum += ntohl(ipr->ip_dst.s_addr) >> 16;
+	xsum += ntohl(ipr->ip_dst.s_addr) & 0xffff;
+	for (i = 0; i < UDP_HDR_SIZE + len; i += 2)
+		xsum += p[i] << 8 | (i + 1 < UDP_HDR_SIZE + len ? p[i + 1] : 0);
+	while (xsum >> 16)
+		xsum = (xsum & 0xffff) + (xsum >> 16);
+	xsum = ~xsum & 0xffff;
+	ipr->udp_xsum = htons(xsum ? xsum : 0xffff);
+
+	priv->recv_packet_length = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+}
+
+/* Send data block @block of the file served over TFTP */
+static void sb_eth_tftp_data(struct eth_sandbox_priv *priv, void *packet,
+			     ulong block)
+{
+	ulong offset = (block - 1) * priv->tftp_blksize;
+	struct ip_udp_hdr *ipr;
+	__be16 *s;
+	uchar *data;
+	int len, i;
+
+	if (offset > tftp_size)
+		return;
+	len = min_t(ulong, priv->tftp_blksize, tftp_size - offset);
+	ipr = sb_eth_udp_reply(priv, packet, SB_TFTP_TID);
+	s = (__be16 *)(ipr + 1);
+	s[0] = htons(SB_TFTP_DATA);
+	s[1] = htons(block & 0xffff);
+	data = (uchar *)(s + 2);
+	for (i = 0; i < len; i++)
+		data[i] = sandbox_eth_tftp_byte(offset + i);
+	sb_eth_udp_send(priv, ipr, 4 + len);
+
+	priv->tftp_block = block;
+	priv->tftp_done = len < priv->tftp_blksize;
+	if (block == tftp_bad_block) {
+		data[0] ^= 0xff;
+		tftp_bad_block = 0;
+		/* Let the client time out and ask for the block again */
+		skip_timeout = true;
+	}
+}
+
+/* Answer a TFTP read request or ACK for the file being served */
+static void sb_eth_tftp(struct eth_sandbox_priv *priv, void *packet,
+			int length)
+{
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	__be16 *s = (__be16 *)(ip + 1);
+	int dport = ntohs(ip->udp_dst);
+	struct ip_udp_hdr *ipr;
+	char *opt, *end;
+	ulong block;
+	int len;
+
+	if (tftp_size < 0 || length < ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4)
+		return;
+
+	if (dport == SB_TFTP_PORT && ntohs(s[0]) == SB_TFTP_RRQ) {
+		/* Find the block size among the options after the name */
+		priv->tftp_blksize = 512;
+		opt = (char *)(s + 1);
+		end = packet + length;
+		while (opt < end && strcmp(opt, "octet"))
+			opt += strlen(opt) + 1;
+		for (; opt < end; opt += strlen(opt) + 1) {
+			if (!strcmp(opt, "blksize"))
+				priv->tftp_blksize = simple_strtoul(opt + 8,
+								    NULL, 10);
+		}
+		priv->tftp_block = 0;
+		priv->tftp_done = false;
+
+		ipr = sb_eth_udp_reply(priv, packet, SB_TFTP_TID);
+		s = (__be16 *)(ipr + 1);
+		s[0] = htons(SB_TFTP_OACK);
+		opt = (char *)(s + 1);
+		len = sprintf(opt, "tsize%c%d%cblksize%c%d", 0, tftp_size, 0,
+			      0, priv->tftp_blksize) + 1;
+		sb_eth_udp_send(priv, ipr, 2 + len);
+	} else if (dport == SB_TFTP_TID && ntohs(s[0]) == SB_TFTP_ACK) {
+		block = ntohs(s[1]);
+		if (block == (priv->tftp_block & 0xffff) && !priv->tftp_done)
+			sb_eth_tftp_data(priv, packet, priv->tftp_block + 1);
+		else if (block == ((priv->tftp_block - 1) & 0xffff))
+			sb_eth_tftp_data(priv, packet, priv->tftp_block);
+	}
+}
+
 static int sb_eth_send(struct udevice *dev, void *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -146,6 +336,8 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 
 				priv->recv_packet_length = length;
 			}
+		} else if (ip->ip_p == IPPROTO_UDP) {
+			sb_eth_tftp(priv, packet, length);
 		}
 	}
 
@@ -167,6 +359,25 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("eth_sandbox: received packet %d\n",
 		      priv->recv_packet_length);
 		priv->recv_packet_length = 0;
+#ifdef CONFIG_NET_RX_PLACE
+		/*
+		 * Act like a controller which splits the headers from the
+		 * payload. What is left in the packet buffer is not payload.
+		 */
+		if (net_rx_target.buf &&
+		    lcl_recv_packet_length > net_rx_target.hdr_len) {
+			uchar *payload = priv->recv_packet_buffer +
+				net_rx_target.hdr_len;
+			int len = min(lcl_recv_packet_length -
+				      net_rx_target.hdr_len,
+				      net_rx_target.len);
+
+			memcpy(net_rx_target.buf, payload, len);
+			memset(payload, 0xa5, len);
+			net_rx_target.placed = len;
+			tftp_placed++;
+		}
+#endif
 		*packetp = priv->recv_packet_buffer;
 		return lcl_recv_packet_length;
 	}
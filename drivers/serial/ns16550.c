@@ -314,6 +314,25 @@ static int ns16550_serial_putc(struct udevice *dev, const char ch)
 	return 0;
 }
 
+static int ns16550_serial_puts(struct udevice *dev, const char *s, int len)
+{
+	struct NS16550 *const com_port = dev_get_priv(dev);
+	int i;
+
+	/* THRE is only set once the whole transmit FIFO is empty */
+	if (!(serial_in(&com_port->lsr) & UART_LSR_THRE))
+		return -EAGAIN;
+
+	len = min(len, max(com_port->plat->fifo_size, 1));
+	for (i = 0; i < len; i++) {
+		serial_out(s[i], &com_port->thr);
+		if (s[i] == '\n')
+			WATCHDOG_RESET();
+	}
+
+	return len;
+}
+
 static int ns16550_serial_pending(struct udevice *dev, bool input)
 {
 	struct NS16550 *const com_port = dev_get_priv(dev);
@@ -401,6 +420,8 @@ int ns16550_serial_ofdata_to_platdata(struct udevice *dev)
 	plat->base = addr;
 	plat->reg_shift = fdtdec_get_int(gd->fdt_blob, dev->of_offset,
 					 "reg-shift", 1);
+	plat->fifo_size = fdtdec_get_int(gd->fdt_blob, dev->of_offset,
+					 "fifo-size", 16);
 
 	return 0;
 }
@@ -408,6 +429,7 @@ int ns16550_serial_ofdata_to_platdata(struct udevice *dev)
 
 const struct dm_serial_ops ns16550_serial_ops = {
 	.putc = ns16550_serial_putc,
+	.puts = ns16550_serial_puts,
 	.pending = ns16550_serial_pending,
 	.getc = ns16550_serial_getc,
 	.setbrg = ns16550_serial_setbrg,
@@ -9,6 +9,7 @@
 #include <environment.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <os.h>
 #include <serial.h>
 #include <stdio_dev.h>
@@ -23,6 +24,11 @@ DECLARE_GLOBAL_DATA_PTR;
  */
 static const unsigned long baudrate_table[] = CONFIG_SYS_BAUDRATE_TABLE;
 
+#ifdef CONFIG_SERIAL_TX_BUFFER
+/* Set once the console has been found again after relocation */
+static bool serial_tx_ready;
+#endif
+
 #ifndef CONFIG_SYS_MALLOC_F_LEN
 #error "Serial is required before relocation - define CONFIG_SYS_MALLOC_F_LEN to make this work"
 #endif
@@ -96,13 +102,142 @@ int serial_init(void)
 void serial_initialize(void)
 {
 	serial_find_console_or_panic();
+#ifdef CONFIG_SERIAL_TX_BUFFER
+	serial_tx_ready = true;
+#endif
+}
+
+#ifdef CONFIG_SERIAL_TX_BUFFER
+#define TX_BUF_SIZE	CONFIG_SERIAL_TX_BUFFER_SIZE
+
+/*
+ * Once relocated, output to the console device goes into a ring buffer
+ * instead of waiting for the UART after each character. The buffer is
+ * drained without waiting whenever more output arrives and from the
+ * polling loops (ctrlc(), udelay() and the serial input functions), and
+ * completely by serial_flush() before anything that may lose it.
+ */
+static bool serial_tx_active(void)
+{
+	/* BSS cannot be read before relocation on some archs */
+	return (gd->flags & GD_FLG_RELOC) && serial_tx_ready &&
+		gd->cur_serial_dev;
+}
+
+static struct serial_dev_priv *serial_tx_buf(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv;
+
+	if (!serial_tx_active() || dev != gd->cur_serial_dev)
+		return NULL;
+
+	upriv = dev_get_uclass_priv(dev);
+	if (!upriv->txbuf)
+		upriv->txbuf = malloc(TX_BUF_SIZE);
+
+	return upriv->txbuf ? upriv : NULL;
+}
+
+/**
+ * serial_tx_drain() - Send buffered output to the UART
+ *
+ * @dev: Device to drain
+ * @wait: true to wait until everything is sent, false to send only what
+ *	the UART will take now
+ * @return number of characters still buffered
+ */
+static int serial_tx_drain(struct udevice *dev, bool wait)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	uint tail, len;
+	int ret;
+
+	/* A driver that calls udelay() or ctrlc() must not recurse here */
+	if (!upriv->txbuf || upriv->tx_busy)
+		return upriv->txbuf ? upriv->tx_head - upriv->tx_tail : 0;
+
+	upriv->tx_busy = true;
+	while (upriv->tx_head != upriv->tx_tail) {
+		tail = upriv->tx_tail % TX_BUF_SIZE;
+		len = min(upriv->tx_head - upriv->tx_tail, TX_BUF_SIZE - tail);
+		if (ops->puts) {
+			ret = ops->puts(dev, upriv->txbuf + tail, len);
+		} else {
+			ret = ops->putc(dev, upriv->txbuf[tail]);
+			if (!ret)
+				ret = 1;
+		}
+		if (ret == -EAGAIN) {
+			if (!wait)
+				break;
+			WATCHDOG_RESET();
+			continue;
+		}
+		/* Drop a character on error, as the unbuffered path does */
+		upriv->tx_tail += ret < 0 ? 1 : ret;
+	}
+	upriv->tx_busy = false;
+
+	return upriv->tx_head - upriv->tx_tail;
+}
+
+static void serial_tx_put(struct udevice *dev, struct serial_dev_priv *upriv,
+			  char ch)
+{
+	while (upriv->tx_head - upriv->tx_tail == TX_BUF_SIZE) {
+		/* Output from inside a drain: drop it rather than spin */
+		if (upriv->tx_busy)
+			return;
+		serial_tx_drain(dev, false);
+	}
+	upriv->txbuf[upriv->tx_head++ % TX_BUF_SIZE] = ch;
+	if (ch == '\n')
+		serial_tx_put(dev, upriv, '\r');
+}
+
+int serial_poll_tx(void)
+{
+	if (!serial_tx_active())
+		return 0;
+
+	return serial_tx_drain(gd->cur_serial_dev, false);
+}
+
+void serial_flush(void)
+{
+	if (serial_tx_active())
+		serial_tx_drain(gd->cur_serial_dev, true);
+}
+#else
+static inline struct serial_dev_priv *serial_tx_buf(struct udevice *dev)
+{
+	return NULL;
+}
+
+static inline int serial_tx_drain(struct udevice *dev, bool wait)
+{
+	return 0;
 }
 
+static inline void serial_tx_put(struct udevice *dev,
+				 struct serial_dev_priv *upriv, char ch)
+{
+}
+#endif
+
 static void _serial_putc(struct udevice *dev, char ch)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
+	struct serial_dev_priv *upriv = serial_tx_buf(dev);
 	int err;
 
+	if (upriv) {
+		serial_tx_put(dev, upriv, ch);
+		serial_tx_drain(dev, false);
+		return;
+	}
+
 	do {
 		err = ops->putc(dev, ch);
 	} while (err == -EAGAIN);
@@ -112,6 +247,15 @@ static void _serial_putc(struct udevice *dev, char ch)
 
 static void _serial_puts(struct udevice *dev, const char *str)
 {
+	struct serial_dev_priv *upriv = serial_tx_buf(dev);
+
+	if (upriv) {
+		while (*str)
+			serial_tx_put(dev, upriv, *str++);
+		serial_tx_drain(dev, false);
+		return;
+	}
+
 	while (*str)
 		_serial_putc(dev, *str++);
 }
@@ -123,8 +267,10 @@ static int _serial_getc(struct udevice *dev)
 
 	do {
 		err = ops->getc(dev);
-		if (err == -EAGAIN)
+		if (err == -EAGAIN) {
 			WATCHDOG_RESET();
+			serial_tx_drain(dev, false);
+		}
 	} while (err == -EAGAIN);
 
 	return err >= 0 ? err : 0;
@@ -134,6 +280,7 @@ static int _serial_tstc(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 
+	serial_tx_drain(dev, false);
 	if (ops->pending)
 		return ops->pending(dev, true);
 
@@ -175,6 +322,8 @@ void serial_setbrg(void)
 	if (!gd->cur_serial_dev)
 		return;
 
+	/* Send what was printed at the old rate before changing it */
+	serial_tx_drain(gd->cur_serial_dev, true);
 	ops = serial_get_ops(gd->cur_serial_dev);
 	if (ops->setbrg)
 		ops->setbrg(gd->cur_serial_dev, gd->baudrate);
@@ -283,6 +432,8 @@ static int serial_post_probe(struct udevice *dev)
 		ops->getc += gd->reloc_off;
 	if (ops->putc)
 		ops->putc += gd->reloc_off;
+	if (ops->puts)
+		ops->puts += gd->reloc_off;
 	if (ops->pending)
 		ops->pending += gd->reloc_off;
 	if (ops->clear)
@@ -318,12 +469,19 @@ static int serial_post_probe(struct udevice *dev)
 
 static int serial_pre_remove(struct udevice *dev)
 {
-#ifdef CONFIG_SYS_STDIO_DEREGISTER
+#if defined(CONFIG_SYS_STDIO_DEREGISTER) || defined(CONFIG_SERIAL_TX_BUFFER)
 	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+#endif
 
+#ifdef CONFIG_SYS_STDIO_DEREGISTER
 	if (stdio_deregister_dev(upriv->sdev, 0))
 		return -EPERM;
 #endif
+#ifdef CONFIG_SERIAL_TX_BUFFER
+	serial_tx_drain(dev, true);
+	free(upriv->txbuf);
+	upriv->txbuf = NULL;
+#endif
 
 	return 0;
 }
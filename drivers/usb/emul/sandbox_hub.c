@@ -229,6 +229,13 @@ static int sandbox_hub_submit_control_msg(struct udevice *bus,
 				if (setup->value < USB_PORT_FEAT_C_CONNECTION) {
 					ret = clrset_post_state(bus, port, 0,
 							1 << setup->value);
+					/* A reset is over at once */
+					if (!ret &&
+					    setup->value == USB_PORT_FEAT_RESET)
+						ret = clrset_post_state(bus,
+							port,
+							USB_PORT_STAT_RESET,
+							0);
 				} else {
 					debug("  ** Invalid feature\n");
 				}
@@ -244,8 +251,8 @@ static int sandbox_hub_submit_control_msg(struct udevice *bus,
 					ret = clrset_post_state(bus, port,
 							1 << setup->value, 0);
 				} else {
-					priv->change[port] &= 1 <<
-						(setup->value - 16);
+					priv->change[port] &= ~(1 <<
+						(setup->value - 16));
 				}
 				udev->status = 0;
 				return 0;
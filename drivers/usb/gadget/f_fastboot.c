@@ -18,6 +18,7 @@
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 #include <version.h>
 #include <g_dnl.h>
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
@@ -39,6 +40,19 @@
 
 #define EP_BUFFER_SIZE			4096
 
+/*
+ * A streamed download is received into two buffers of this size at the
+ * start of the download buffer, in turn
+ */
+#ifndef CONFIG_FASTBOOT_STREAM_BUF_SIZE
+#define CONFIG_FASTBOOT_STREAM_BUF_SIZE	SZ_1M
+#endif
+
+#if defined(CONFIG_FASTBOOT_STREAM) && \
+	2 * CONFIG_FASTBOOT_STREAM_BUF_SIZE > CONFIG_FASTBOOT_BUF_SIZE
+#error "CONFIG_FASTBOOT_BUF_SIZE must hold two stream buffers"
+#endif
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
@@ -56,6 +70,10 @@ static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
 static bool is_high_speed;
+#ifdef CONFIG_FASTBOOT_STREAM
+static void *stream_cmd_buf;	/* command buffer, while streaming */
+static int stream_buf;		/* stream buffer being received */
+#endif
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -183,6 +201,12 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
 
+#ifdef CONFIG_FASTBOOT_STREAM
+	if (stream_cmd_buf) {
+		f_fb->out_req->buf = stream_cmd_buf;
+		stream_cmd_buf = NULL;
+	}
+#endif
 	if (f_fb->out_req) {
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
@@ -378,9 +402,14 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		strncat(response, U_BOOT_VERSION, chars_left);
 	} else if (!strcmp_l1("downloadsize", cmd) ||
 		!strcmp_l1("max-download-size", cmd)) {
+		unsigned int size = CONFIG_FASTBOOT_BUF_SIZE;
 		char str_num[12];
 
-		sprintf(str_num, "0x%08x", CONFIG_FASTBOOT_BUF_SIZE);
+#ifdef CONFIG_FASTBOOT_STREAM
+		if (fb_mmc_stream_size())
+			size = fb_mmc_stream_size();
+#endif
+		sprintf(str_num, "0x%08x", size);
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = getenv("serial#");
@@ -395,14 +424,15 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 	fastboot_tx_write_str(response);
 }
 
-static unsigned int rx_bytes_expected(unsigned int maxpacket)
+static unsigned int rx_bytes_expected(unsigned int maxpacket,
+				      unsigned int bufsize)
 {
 	int rx_remain = download_size - download_bytes;
 	int rem = 0;
 	if (rx_remain < 0)
 		return 0;
-	if (rx_remain > EP_BUFFER_SIZE)
-		return EP_BUFFER_SIZE;
+	if (rx_remain > bufsize)
+		return bufsize;
 	if (rx_remain < maxpacket) {
 		rx_remain = maxpacket;
 	} else if (rx_remain % maxpacket != 0) {
@@ -413,13 +443,27 @@ static unsigned int rx_bytes_expected(unsigned int maxpacket)
 }
 
 #define BYTES_PER_DOT	0x20000
+static void download_progress(unsigned int transfer_size)
+{
+	unsigned int pre_dot_num, now_dot_num;
+
+	pre_dot_num = download_bytes / BYTES_PER_DOT;
+	download_bytes += transfer_size;
+	now_dot_num = download_bytes / BYTES_PER_DOT;
+
+	if (pre_dot_num != now_dot_num) {
+		putc('.');
+		if (!(now_dot_num % 74))
+			putc('\n');
+	}
+}
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[RESPONSE_LEN];
 	unsigned int transfer_size = download_size - download_bytes;
 	const unsigned char *buffer = req->buf;
 	unsigned int buffer_size = req->actual;
-	unsigned int pre_dot_num, now_dot_num;
 	unsigned int max;
 
 	if (req->status != 0) {
@@ -433,15 +477,7 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
 	       buffer, transfer_size);
 
-	pre_dot_num = download_bytes / BYTES_PER_DOT;
-	download_bytes += transfer_size;
-	now_dot_num = download_bytes / BYTES_PER_DOT;
-
-	if (pre_dot_num != now_dot_num) {
-		putc('.');
-		if (!(now_dot_num % 74))
-			putc('\n');
-	}
+	download_progress(transfer_size);
 
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
@@ -460,7 +496,7 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	} else {
 		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
 				fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
+		req->length = rx_bytes_expected(max, EP_BUFFER_SIZE);
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
 	}
@@ -469,10 +505,79 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	usb_ep_queue(ep, req, 0);
 }
 
+#ifdef CONFIG_FASTBOOT_STREAM
+static void *stream_buf_addr(int buf)
+{
+	return (void *)CONFIG_FASTBOOT_BUF_ADDR +
+		buf * CONFIG_FASTBOOT_STREAM_BUF_SIZE;
+}
+
+static void stream_queue_next(struct usb_ep *ep, struct usb_request *req)
+{
+	unsigned int max;
+
+	max = is_high_speed ? hs_ep_out.wMaxPacketSize :
+			fs_ep_out.wMaxPacketSize;
+	req->buf = stream_buf_addr(stream_buf);
+	req->length = rx_bytes_expected(max, CONFIG_FASTBOOT_STREAM_BUF_SIZE);
+	if (req->length < ep->maxpacket)
+		req->length = ep->maxpacket;
+}
+
+/*
+ * Receive a streamed download straight into the two stream buffers in
+ * turn. The other buffer is queued before the data just received is
+ * written out, so that the USB controller can receive while the data is
+ * written to the flash device.
+ */
+static void rx_handler_dl_stream(struct usb_ep *ep, struct usb_request *req)
+{
+	char response[RESPONSE_LEN];
+	unsigned int transfer_size = download_size - download_bytes;
+	void *buffer = req->buf;
+	bool done;
+
+	if (req->status != 0) {
+		printf("Bad status: %d\n", req->status);
+		return;
+	}
+
+	if (req->actual < transfer_size)
+		transfer_size = req->actual;
+	download_progress(transfer_size);
+
+	done = download_bytes >= download_size;
+	if (done) {
+		download_size = 0;
+		req->complete = rx_handler_command;
+		req->buf = stream_cmd_buf;
+		req->length = EP_BUFFER_SIZE;
+		stream_cmd_buf = NULL;
+	} else {
+		stream_buf ^= 1;
+		stream_queue_next(ep, req);
+	}
+
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+
+	fb_mmc_stream_write(buffer, transfer_size);
+	if (done) {
+		fb_mmc_stream_finish();
+
+		sprintf(response, "OKAY");
+		fastboot_tx_write_str(response);
+
+		printf("\ndownloading of %d bytes finished\n", download_bytes);
+	}
+}
+#endif
+
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
 	char response[RESPONSE_LEN];
+	unsigned int max_size = CONFIG_FASTBOOT_BUF_SIZE;
 	unsigned int max;
 
 	strsep(&cmd, ":");
@@ -481,17 +586,30 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 
 	printf("Starting download of %d bytes\n", download_size);
 
+#ifdef CONFIG_FASTBOOT_STREAM
+	fb_mmc_stream_reset();
+	if (fb_mmc_stream_size())
+		max_size = fb_mmc_stream_size();
+#endif
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > max_size) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
+#ifdef CONFIG_FASTBOOT_STREAM
+	} else if (fb_mmc_stream_size()) {
+		sprintf(response, "DATA%08x", download_size);
+		req->complete = rx_handler_dl_stream;
+		stream_cmd_buf = req->buf;
+		stream_buf = 0;
+		stream_queue_next(ep, req);
+#endif
 	} else {
 		sprintf(response, "DATA%08x", download_size);
 		req->complete = rx_handler_dl_image;
 		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
 			fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
+		req->length = rx_bytes_expected(max, EP_BUFFER_SIZE);
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
 	}
@@ -543,6 +661,13 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	strcpy(response, "FAILno flash device defined");
+#ifdef CONFIG_FASTBOOT_STREAM
+	if (fb_mmc_stream_result(cmd, response)) {
+		/* The image was written while it was downloaded */
+		fastboot_tx_write_str(response);
+		return;
+	}
+#endif
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	fb_mmc_flash_write(cmd, (void *)CONFIG_FASTBOOT_BUF_ADDR,
 			   download_bytes, response);
@@ -564,6 +689,17 @@ static void cb_oem(struct usb_ep *ep, struct usb_request *req)
                 else
 			fastboot_tx_write_str("OKAY");
 	} else
+#endif
+#ifdef CONFIG_FASTBOOT_STREAM
+	if (strncmp("stream", cmd + 4, 6) == 0) {
+		char response[RESPONSE_LEN];
+		char *part = cmd + 10;
+
+		while (*part == ' ')
+			part++;
+		fb_mmc_stream_start(part, response);
+		fastboot_tx_write_str(response);
+	} else
 #endif
 	if (strncmp("unlock", cmd + 4, 8) == 0) {
 		fastboot_tx_write_str("FAILnot implemented");
@@ -46,6 +46,17 @@ int ext4fs_indir3_blkno = -1;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
+/*
+ * Extent runs of the most recently read extent-mapped inode. The whole
+ * extent tree is walked once and flattened into this array so that file
+ * reads do not need to descend the tree again for every block.
+ */
+static struct ext4_extent_run *ext4fs_ext_runs;
+static int ext4fs_ext_nr_runs;
+static int ext4fs_ext_max_runs;
+static struct ext2_data *ext4fs_ext_data;
+static int ext4fs_ext_ino;
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n)
 {
@@ -1449,6 +1460,152 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+static int ext4fs_add_extent_run(uint32_t lblk, uint32_t len, uint64_t pblk)
+{
+	struct ext4_extent_run *run;
+
+	if (ext4fs_ext_nr_runs) {
+		run = &ext4fs_ext_runs[ext4fs_ext_nr_runs - 1];
+		/* Merge with the previous run if it is contiguous */
+		if (run->lblk + run->len == lblk && run->pblk &&
+		    run->pblk + run->len == pblk) {
+			run->len += len;
+			return 0;
+		}
+	}
+
+	if (ext4fs_ext_nr_runs == ext4fs_ext_max_runs) {
+		int max = ext4fs_ext_max_runs ? ext4fs_ext_max_runs * 2 : 16;
+
+		run = realloc(ext4fs_ext_runs, max * sizeof(*run));
+		if (!run)
+			return -ENOMEM;
+		ext4fs_ext_runs = run;
+		ext4fs_ext_max_runs = max;
+	}
+
+	run = &ext4fs_ext_runs[ext4fs_ext_nr_runs++];
+	run->lblk = lblk;
+	run->len = len;
+	run->pblk = pblk;
+
+	return 0;
+}
+
+static int ext4fs_walk_extents(struct ext4_extent_header *ext_block,
+			       int depth, int log2_blksz)
+{
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	unsigned long long block;
+	char *buf;
+	int i, ret;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth)
+		return -EINVAL;
+
+	if (depth == 0) {
+		struct ext4_extent *extent = (struct ext4_extent *)
+					     (ext_block + 1);
+
+		for (i = 0; i < entries; i++) {
+			uint32_t len = le16_to_cpu(extent[i].ee_len);
+
+			block = le16_to_cpu(extent[i].ee_start_hi);
+			block = (block << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			/* Uninitialized extents read back as zeroes */
+			if (len > EXT_INIT_MAX_LEN) {
+				len -= EXT_INIT_MAX_LEN;
+				block = 0;
+			}
+			ret = ext4fs_add_extent_run(
+					le32_to_cpu(extent[i].ee_block),
+					len, block);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0, ret = 0; i < entries && !ret; i++) {
+		struct ext4_extent_idx *index = (struct ext4_extent_idx *)
+						(ext_block + 1);
+
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			ret = -EIO;
+			break;
+		}
+		ret = ext4fs_walk_extents((struct ext4_extent_header *)buf,
+					  depth - 1, log2_blksz);
+	}
+	free(buf);
+
+	return ret;
+}
+
+void ext4fs_free_extent_cache(void)
+{
+	free(ext4fs_ext_runs);
+	ext4fs_ext_runs = NULL;
+	ext4fs_ext_nr_runs = 0;
+	ext4fs_ext_max_runs = 0;
+	ext4fs_ext_data = NULL;
+	ext4fs_ext_ino = 0;
+}
+
+/**
+ * ext4fs_get_extent_runs() - Get the extent map of an extent-mapped inode
+ *
+ * The extent tree of @node is flattened into a sorted array of runs of
+ * logically and physically contiguous blocks. The array is cached until a
+ * different inode is looked up or the filesystem is closed.
+ *
+ * @node:	Inode to look up, must have EXT4_EXTENTS_FL set
+ * @runsp:	Returns a pointer to the (cached) array of runs
+ * @countp:	Returns the number of entries in @runsp
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_get_extent_runs(struct ext2fs_node *node,
+			   struct ext4_extent_run **runsp, int *countp)
+{
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+			 get_fs()->dev_desc->log2blksz;
+	struct ext4_extent_header *ext_block;
+	int ret;
+
+	if (!ext4fs_ext_runs || ext4fs_ext_data != node->data ||
+	    ext4fs_ext_ino != node->ino) {
+		ext4fs_free_extent_cache();
+		ext_block = (struct ext4_extent_header *)
+			    node->inode.b.blocks.dir_blocks;
+		ret = ext4fs_walk_extents(ext_block,
+					  le16_to_cpu(ext_block->eh_depth),
+					  log2_blksz);
+		if (ret) {
+			printf("invalid extent block\n");
+			ext4fs_free_extent_cache();
+			return ret;
+		}
+		ext4fs_ext_data = node->data;
+		ext4fs_ext_ino = node->ino;
+	}
+
+	*runsp = ext4fs_ext_runs;
+	*countp = ext4fs_ext_nr_runs;
+
+	return 0;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -1878,6 +2035,7 @@ void ext4fs_reinit_global(void)
 		ext4fs_indir3_size = 0;
 		ext4fs_indir3_blkno = -1;
 	}
+	ext4fs_free_extent_cache();
 }
 void ext4fs_close(void)
 {
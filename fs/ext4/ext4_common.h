@@ -41,6 +41,13 @@
 #define SUPERBLOCK_SIZE	1024
 #define F_FILE			1
 
+/* A run of logically and physically contiguous blocks of an inode */
+struct ext4_extent_run {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block, 0 for a hole */
+};
+
 static inline void *zalloc(size_t size)
 {
 	void *p = memalign(ARCH_DMA_MINALIGN, size);
@@ -56,6 +63,9 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int expecttype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
+int ext4fs_get_extent_runs(struct ext2fs_node *node,
+			   struct ext4_extent_run **runsp, int *countp);
+void ext4fs_free_extent_cache(void);
 
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
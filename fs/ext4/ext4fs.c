@@ -26,6 +26,7 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -41,6 +42,70 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Read a range of an extent-mapped file, issuing one device read per
+ * extent run rather than looking up every block separately.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node, loff_t pos,
+			       loff_t len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
+	int blocksize = 1 << (log2_fs_blocksize + log2blksz);
+	struct ext4_extent_run *runs;
+	loff_t end = pos + len;
+	int count, lo, hi, ret;
+
+	ret = ext4fs_get_extent_runs(node, &runs, &count);
+	if (ret)
+		return ret;
+
+	while (pos < end) {
+		uint32_t fileblock = lldiv(pos, blocksize);
+		int blockoff = pos - (loff_t)fileblock * blocksize;
+		loff_t run_end, chunk;
+
+		/* Find the first run ending after fileblock */
+		lo = 0;
+		hi = count;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+
+			if (runs[mid].lblk + runs[mid].len <= fileblock)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo == count || runs[lo].lblk > fileblock) {
+			/* Hole up to the next run or the end of the read */
+			run_end = lo == count ? end :
+				  (loff_t)runs[lo].lblk * blocksize;
+			chunk = min(run_end, end) - pos;
+			memset(buf, 0, chunk);
+		} else {
+			run_end = (loff_t)(runs[lo].lblk + runs[lo].len) *
+				  blocksize;
+			chunk = min(run_end, end) - pos;
+			/* ext4fs_devread() takes an int length */
+			chunk = min(chunk, (loff_t)SZ_1G);
+			if (!runs[lo].pblk) {
+				memset(buf, 0, chunk);
+			} else if (!ext4fs_devread((lbaint_t)(runs[lo].pblk +
+					fileblock - runs[lo].lblk) <<
+					log2_fs_blocksize, blockoff, chunk,
+					buf)) {
+				return -EIO;
+			}
+		}
+		buf += chunk;
+		pos += chunk;
+	}
+
+	return 0;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -65,8 +130,19 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	short status;
 
 	/* Adjust len so it we can't read past the end of the file. */
-	if (len > filesize)
-		len = filesize;
+	if (pos >= filesize) {
+		*actread = 0;
+		return 0;
+	}
+	if (len > filesize - pos)
+		len = filesize - pos;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		if (ext4fs_read_extents(node, pos, len, buf))
+			return -1;
+		*actread = len;
+		return 0;
+	}
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
@@ -198,6 +274,15 @@ int ext4fs_read(char *buf, loff_t len, loff_t *actread)
 	return ext4fs_read_file(ext4fs_file, 0, len, buf, actread);
 }
 
+/* Read part of the file opened by ext4fs_open() */
+int ext4fs_read_open(void *buf, loff_t offset, loff_t len, loff_t *actread)
+{
+	if (ext4fs_root == NULL || ext4fs_file == NULL)
+		return -1;
+
+	return ext4fs_read_file(ext4fs_file, offset, len, buf, actread);
+}
+
 int ext4fs_probe(block_dev_desc_t *fs_dev_desc,
 		 disk_partition_t *fs_partition)
 {
@@ -217,11 +302,6 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	loff_t file_len;
 	int ret;
 
-	if (offset != 0) {
-		printf("** Cannot support non-zero offset **\n");
-		return -1;
-	}
-
 	ret = ext4fs_open(filename, &file_len);
 	if (ret < 0) {
 		printf("** File not found %s **\n", filename);
@@ -231,7 +311,7 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	if (len == 0)
 		len = file_len;
 
-	return ext4fs_read(buf, len, len_read);
+	return ext4fs_read_file(ext4fs_file, offset, len, buf, len_read);
 }
 
 int ext4fs_uuid(char *uuid_str)
@@ -64,6 +64,7 @@ int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	fat_close();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -162,6 +163,64 @@ static void get_name(dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+/*
+ * Return the cached copy of FAT window 'bufnum' (FATBUFBLOCKS sectors),
+ * reading it into the least-recently-used slot if needed. When the whole
+ * FAT fits into the cache it is read with a single request instead.
+ * On failure NULL is returned.
+ */
+static __u8 *get_fat_window(fsdata *mydata, __u32 bufnum)
+{
+	__u32 nwindows = DIV_ROUND_UP(mydata->fatlength, FATBUFBLOCKS);
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock;
+	int i, slot = 0;
+
+	if (bufnum >= nwindows) {
+		debug("FAT window %u past end of FAT\n", bufnum);
+		return NULL;
+	}
+
+	for (i = 0; i < FATCACHE_WINDOWS; i++) {
+		if (mydata->fatcachenum[i] == bufnum)
+			goto found;
+		if (mydata->fatcacheuse[i] < mydata->fatcacheuse[slot])
+			slot = i;
+	}
+
+	if (nwindows <= FATCACHE_WINDOWS) {
+		/* Small FAT: window n always lives in slot n */
+		if (disk_read(mydata->fat_sect, mydata->fatlength,
+			      mydata->fatcache) < 0) {
+			debug("Error reading FAT blocks\n");
+			return NULL;
+		}
+		for (i = 0; i < FATCACHE_WINDOWS; i++)
+			mydata->fatcachenum[i] = i < nwindows ? i : -1;
+		i = bufnum;
+		goto found;
+	}
+
+	startblock = bufnum * FATBUFBLOCKS;
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	/* Offset from start of disk */
+	if (disk_read(startblock + mydata->fat_sect, getsize,
+		      mydata->fatcache + slot * FATBUFSIZE) < 0) {
+		debug("Error reading FAT blocks\n");
+		mydata->fatcachenum[slot] = -1;
+		return NULL;
+	}
+	mydata->fatcachenum[slot] = bufnum;
+	i = slot;
+
+found:
+	mydata->fatcacheuse[i] = ++mydata->fatcachetick;
+
+	return mydata->fatcache + i * FATBUFSIZE;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -172,6 +231,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 off16, offset;
 	__u32 ret = 0x00;
 	__u16 val1, val2;
+	__u8 *fatbuf;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -195,57 +255,43 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Look up the block of FAT entries in the cache. */
+	fatbuf = get_fat_window(mydata, bufnum);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
 
 		switch (offset & 0x3) {
 		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *) fatbuf)[off16]);
 			ret &= 0xfff;
 			break;
 		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x00ff;
 			ret = (val2 << 4) | (val1 >> 12);
 			break;
 		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x000f;
 			ret = (val2 << 8) | (val1 >> 8);
 			break;
 		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			ret = (ret & 0xfff0) >> 4;
 			break;
 		default:
@@ -354,6 +400,12 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	actsize = bytesperclust;
 
+	/* Carry on from the cluster found by the previous read, if any */
+	if (mydata->clust_hint && mydata->clust_hint_pos <= pos) {
+		curclust = mydata->clust_hint;
+		actsize += mydata->clust_hint_pos;
+	}
+
 	/* go to cluster at pos */
 	while (actsize <= pos) {
 		curclust = get_fatent(mydata, curclust);
@@ -367,6 +419,8 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
+	mydata->clust_hint = curclust;
+	mydata->clust_hint_pos = actsize;
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -814,6 +868,14 @@ exit:
 __u8 do_fat_read_at_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
 
+/* 'dogetsize' value for do_fat_read_at() to keep the file open */
+#define FAT_OPEN	2
+
+/* File opened by fat_open(), with its FAT cache */
+static fsdata fat_open_data;
+static dir_entry fat_open_dent;
+static int fat_is_open;
+
 int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		   loff_t maxsize, int dols, int dogetsize, loff_t *size)
 {
@@ -823,6 +885,7 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	fsdata datablock;
 	fsdata *mydata = &datablock;
 	dir_entry *dentptr = NULL;
+	dir_entry dent;
 	__u16 prevcksum = 0xffff;
 	char *subname = "";
 	__u32 cursect;
@@ -875,12 +938,18 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	mydata->fatcache = memalign(ARCH_DMA_MINALIGN, FATCACHESIZE);
+	if (mydata->fatcache == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	for (idx = 0; idx < FATCACHE_WINDOWS; idx++) {
+		mydata->fatcachenum[idx] = -1;
+		mydata->fatcacheuse[idx] = 0;
+	}
+	mydata->fatcachetick = 0;
+	mydata->clust_hint = 0;
+	mydata->clust_hint_pos = 0;
 
 	if (vfat_enabled)
 		debug("VFAT Support enabled\n");
@@ -1155,9 +1224,12 @@ rootdir_done:
 	while (isdir) {
 		int startsect = mydata->data_begin
 			+ START(dentptr) * mydata->clust_size;
-		dir_entry dent;
 		char *nextname = NULL;
 
+		/*
+		 * get_dentfromdir() fills in the entry. Keep it in 'dent',
+		 * which outlives this loop, since it is still used below.
+		 */
 		dent = *dentptr;
 		dentptr = &dent;
 
@@ -1221,7 +1293,14 @@ rootdir_done:
 			subname = nextname;
 	}
 
-	if (dogetsize) {
+	if (dogetsize == FAT_OPEN) {
+		*size = FAT2CPU32(dentptr->size);
+		/* fat_close() frees the FAT cache */
+		fat_open_data = *mydata;
+		fat_open_dent = *dentptr;
+		fat_is_open = 1;
+		return 0;
+	} else if (dogetsize) {
 		*size = FAT2CPU32(dentptr->size);
 		ret = 0;
 	} else {
@@ -1230,7 +1309,7 @@ rootdir_done:
 	debug("Size: %u, got: %llu\n", FAT2CPU32(dentptr->size), *size);
 
 exit:
-	free(mydata->fatbuf);
+	free(mydata->fatcache);
 	return ret;
 }
 
@@ -1355,6 +1434,30 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ret;
 }
 
+/*
+ * Look up 'filename' and keep it open, so that fat_read_open() can read
+ * it in pieces without walking the directories and cluster chain again.
+ */
+int fat_open(const char *filename, loff_t *size)
+{
+	fat_close();
+
+	return do_fat_read_at(filename, 0, NULL, 0, LS_NO, FAT_OPEN, size);
+}
+
+int fat_read_open(void *buf, loff_t offset, loff_t len, loff_t *actread)
+{
+	if (!fat_is_open)
+		return -1;
+
+	return get_contents(&fat_open_data, &fat_open_dent, offset, buf, len,
+			    actread);
+}
+
 void fat_close(void)
 {
+	if (fat_is_open) {
+		free(fat_open_data.fatcache);
+		fat_is_open = 0;
+	}
 }
@@ -102,6 +102,13 @@ struct fstype_info {
 		     loff_t len, loff_t *actwrite);
 	void (*close)(void);
 	int (*uuid)(char *uuid_str);
+	/*
+	 * Optional: look up a file and keep it open until close(), so that
+	 * read_open() can read it in pieces without looking it up again
+	 */
+	int (*open)(const char *filename, loff_t *size);
+	int (*read_open)(void *buf, loff_t offset, loff_t len,
+			 loff_t *actread);
 };
 
 static struct fstype_info fstypes[] = {
@@ -122,6 +129,8 @@ static struct fstype_info fstypes[] = {
 		.write = fs_write_unsupported,
 #endif
 		.uuid = fs_uuid_unsupported,
+		.open = fat_open,
+		.read_open = fat_read_open,
 	},
 #endif
 #ifdef CONFIG_FS_EXT4
@@ -141,6 +150,8 @@ static struct fstype_info fstypes[] = {
 		.write = fs_write_unsupported,
 #endif
 		.uuid = ext4fs_uuid,
+		.open = ext4fs_open,
+		.read_open = ext4fs_read_open,
 	},
 #endif
 #ifdef CONFIG_SANDBOX
@@ -218,6 +229,10 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 			info->ls += gd->reloc_off;
 			info->read += gd->reloc_off;
 			info->write += gd->reloc_off;
+			if (info->open) {
+				info->open += gd->reloc_off;
+				info->read_open += gd->reloc_off;
+			}
 		}
 		relocated = 1;
 	}
@@ -312,9 +327,13 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * We don't actually know how many bytes are being read, since len==0
 	 * means read the whole file.
 	 */
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FS_READ, "fs_read");
 	buf = map_sysmem(addr, len);
 	ret = info->read(filename, buf, offset, len, actread);
 	unmap_sysmem(buf);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FS_READ);
+	if (ret == 0)
+		bootstage_add_bytes(BOOTSTAGE_ID_ACCUM_FS_READ, *actread);
 
 	/* If we requested a specific number of bytes, check we got it */
 	if (ret == 0 && len && *actread != len)
@@ -432,6 +451,124 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
+#ifdef CONFIG_GZIP
+/* Size of the compressed chunks read by do_gzload() */
+#ifndef CONFIG_FS_GZLOAD_CHUNK_SIZE
+#define CONFIG_FS_GZLOAD_CHUNK_SIZE	(256 << 10)
+#endif
+
+struct fs_gz_stream {
+	const char *ifname;
+	const char *dev_part_str;
+	int fstype;
+	const char *filename;
+	loff_t size;
+	struct fstype_info *info;	/* Filesystem with the file open, or NULL */
+};
+
+/* Read the next chunk of the compressed file for gunzip_stream() */
+static int fs_gz_read(void *priv, void *buf, unsigned long offset,
+		      unsigned long size)
+{
+	struct fs_gz_stream *gz = priv;
+	loff_t len_read;
+	int ret;
+
+	if (offset >= gz->size)
+		return 0;
+	if (size > gz->size - offset)
+		size = gz->size - offset;
+
+	if (gz->info) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FS_READ, "fs_read");
+		ret = gz->info->read_open(buf, offset, size, &len_read);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FS_READ);
+		if (ret < 0)
+			return -1;
+		bootstage_add_bytes(BOOTSTAGE_ID_ACCUM_FS_READ, len_read);
+
+		return len_read;
+	}
+
+	/* fs_read() closes the filesystem, so select it for every chunk */
+	if (fs_set_blk_dev(gz->ifname, gz->dev_part_str, gz->fstype))
+		return -1;
+	if (fs_read(gz->filename, map_to_sysmem(buf), offset, size,
+		    &len_read) < 0)
+		return -1;
+
+	return len_read;
+}
+
+int do_gzload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+	      int fstype)
+{
+	struct fs_gz_stream gz;
+	unsigned long addr, maxsize, len;
+	unsigned long time;
+	void *buf;
+	char *ep;
+	int ret;
+
+	if (argc < 5 || argc > 6)
+		return CMD_RET_USAGE;
+
+	gz.ifname = argv[1];
+	gz.dev_part_str = argv[2];
+	gz.fstype = fstype;
+	gz.filename = argv[4];
+	addr = simple_strtoul(argv[3], &ep, 16);
+	if (ep == argv[3] || *ep != '\0')
+		return CMD_RET_USAGE;
+	maxsize = argc >= 6 ? simple_strtoul(argv[5], NULL, 16) : ~0UL;
+
+	if (fs_set_blk_dev(gz.ifname, gz.dev_part_str, fstype))
+		return 1;
+
+	/*
+	 * Keep the file open across chunks where the filesystem allows it,
+	 * rather than mounting it and looking up the file for each one
+	 */
+	gz.info = fs_get_info(fs_type);
+	if (gz.info->open) {
+		ret = gz.info->open(gz.filename, &gz.size);
+		if (ret < 0)
+			fs_close();
+	} else {
+		gz.info = NULL;
+		ret = fs_size(gz.filename, &gz.size);
+	}
+	if (ret < 0) {
+		printf("** File not found %s **\n", gz.filename);
+		return 1;
+	}
+
+	time = get_timer(0);
+	buf = map_sysmem(addr, maxsize);
+	ret = gunzip_stream(buf, maxsize, fs_gz_read, &gz,
+			    CONFIG_FS_GZLOAD_CHUNK_SIZE, &len);
+	unmap_sysmem(buf);
+	time = get_timer(time);
+	if (gz.info)
+		fs_close();
+	if (ret)
+		return 1;
+
+	printf("%llu bytes read, %lu bytes uncompressed in %lu ms",
+	       gz.size, len, time);
+	if (time > 0) {
+		puts(" (");
+		print_size(div_u64(len, time) * 1000, "/s");
+		puts(")");
+	}
+	puts("\n");
+
+	setenv_hex("filesize", len);
+
+	return 0;
+}
+#endif
+
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int fstype)
 {
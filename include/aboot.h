@@ -23,6 +23,85 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * struct sparse_stream - an image being written as it arrives
+ *
+ * A sparse image is parsed a piece at a time, so that each chunk can be
+ * written as soon as its data is available. Any other image is written to
+ * the partition as it is.
+ *
+ * @dev_desc:		Device to write to
+ * @info:		Partition to write to
+ * @part_name:		Partition name, for messages
+ * @state:		Current state of the parser (SPARSE_STREAM_...)
+ * @sparse:		Sparse image header
+ * @chunk:		Header of the current chunk
+ * @hdr:		Header being collected
+ * @hdr_len:		Number of header bytes received so far
+ * @hdr_need:		Number of header bytes expected
+ * @chunk_num:		Number of the current chunk
+ * @blk:		Next block to write
+ * @left:		Bytes of chunk data still to come
+ * @total_blocks:	Number of sparse blocks seen so far
+ * @bytes_written:	Number of bytes written to the partition
+ * @blkbuf:		Part of a block which has not been written yet
+ * @blkbuf_len:		Number of bytes in @blkbuf
+ */
+struct sparse_stream {
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+	char part_name[32];
+	int state;
+	sparse_header_t sparse;
+	chunk_header_t chunk;
+	uchar hdr[sizeof(sparse_header_t)] __aligned(4);
+	uint hdr_len;
+	uint hdr_need;
+	uint chunk_num;
+	lbaint_t blk;
+	u64 left;
+	uint32_t total_blocks;
+	u64 bytes_written;
+	uchar *blkbuf;
+	uint blkbuf_len;
+};
+
+/**
+ * sparse_stream_start() - Start writing an image to a partition
+ *
+ * @s:		Stream state to set up
+ * @dev_desc:	Device to write to
+ * @info:	Partition to write to
+ * @part_name:	Partition name, for messages
+ * @return 0 if OK, -ENOMEM if out of memory (the fastboot response is set)
+ */
+int sparse_stream_start(struct sparse_stream *s, block_dev_desc_t *dev_desc,
+			disk_partition_t *info, const char *part_name);
+
+/**
+ * sparse_stream_write() - Write the next part of an image
+ *
+ * The image can be split at any point.
+ *
+ * @s:		Stream state
+ * @buf:	Next part of the image
+ * @len:	Length of @buf in bytes
+ * @return 0 if OK, -EIO if the image is invalid or could not be written (the
+ * fastboot response is set). Once an error is reported, the rest of the
+ * image is ignored.
+ */
+int sparse_stream_write(struct sparse_stream *s, const void *buf, uint len);
+
+/**
+ * sparse_stream_finish() - Finish writing an image
+ *
+ * This writes anything still held back and sets the fastboot response.
+ *
+ * @s:		Stream state
+ * @return 0 if OK, -EIO on error
+ */
+int sparse_stream_finish(struct sparse_stream *s);
+
 void write_sparse_image(block_dev_desc_t *dev_desc,
 		disk_partition_t *info, const char *part_name,
 		void *data, unsigned sz);
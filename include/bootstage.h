@@ -16,6 +16,10 @@
 #define CONFIG_BOOTSTAGE_USER_COUNT	20
 #endif
 
+#ifndef CONFIG_BOOTSTAGE_INTERVAL_COUNT
+#define CONFIG_BOOTSTAGE_INTERVAL_COUNT	100
+#endif
+
 /* Flags for each bootstage record */
 enum bootstage_flags {
 	BOOTSTAGEF_ERROR	= 1 << 0,	/* Error record */
@@ -198,6 +202,8 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_SCSI,
 	BOOTSTAGE_ID_ACCUM_SPI,
 	BOOTSTAGE_ID_ACCUM_DECOMP,
+	BOOTSTAGE_ID_ACCUM_FS_READ,
+	BOOTSTAGE_ID_ACCUM_NET,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -212,6 +218,12 @@ enum bootstage_id {
  */
 ulong timer_get_boot_us(void);
 
+/* Output formats for bootstage_export() */
+enum bootstage_format {
+	BOOTSTAGE_FORMAT_JSON,		/* Chrome trace event JSON */
+	BOOTSTAGE_FORMAT_CSV,		/* Comma-separated values */
+};
+
 #if !defined(CONFIG_SPL_BUILD) && !defined(USE_HOSTCC)
 /*
  * Board code can implement show_boot_progress() if needed.
@@ -298,6 +310,44 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Record a timed interval
+ *
+ * This adds an interval running from start_us until now to the timeline
+ * written by bootstage_export(). Intervals may nest. bootstage_accum()
+ * calls this for each activity it accumulates.
+ *
+ * @param name		Name of the interval (must remain valid)
+ * @param start_us	Start time from timer_get_boot_us()
+ * @return duration of the interval in microseconds
+ */
+uint32_t bootstage_add_interval(const char *name, uint32_t start_us);
+
+/**
+ * Count bytes transferred by a bootstage activity
+ *
+ * The total is shown alongside the accumulated time in bootstage_export().
+ *
+ * @param id	Bootstage id to record the bytes against
+ * @param bytes	Number of bytes to add
+ */
+void bootstage_add_bytes(enum bootstage_id id, ulong bytes);
+
+/**
+ * Write the bootstage timings to memory in a structured format
+ *
+ * JSON output uses the Chrome trace event format, so it can be loaded into
+ * chrome://tracing or similar viewers. Marks are instant events, intervals
+ * are complete events and accumulated totals are in the metadata. CSV
+ * output has one line per mark, accumulator and interval.
+ *
+ * @param base		Base address of memory buffer
+ * @param size		Size of memory buffer
+ * @param format	Output format (BOOTSTAGE_FORMAT_...)
+ * @return number of bytes written, or -ENOSPC if out of space
+ */
+int bootstage_export(void *base, int size, enum bootstage_format format);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -380,6 +430,16 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_add_interval(const char *name,
+					      uint32_t start_us)
+{
+	return 0;
+}
+
+static inline void bootstage_add_bytes(enum bootstage_id id, ulong bytes)
+{
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -196,6 +196,12 @@ void	hang		(void) __attribute__ ((noreturn));
 int	timer_init(void);
 int	cpu_init(void);
 
+/*
+ * Stop any secondary CPUs still running U-Boot code, before jumping to an
+ * image which may overwrite it. Called by bootm, go, bootelf and bootvx.
+ */
+void arch_park_cpus(void);
+
 /* */
 phys_size_t initdram (int);
 
@@ -626,6 +632,14 @@ void	serial_setbrg (void);
 void	serial_putc   (const char);
 void	serial_putc_raw(const char);
 void	serial_puts   (const char *);
+/* serial-uclass.c is only built with DM_SERIAL, which SPL may not have */
+#if defined(CONFIG_SERIAL_TX_BUFFER) && defined(CONFIG_DM_SERIAL)
+int	serial_poll_tx(void);
+void	serial_flush(void);
+#else
+static inline int serial_poll_tx(void) { return 0; }
+static inline void serial_flush(void) {}
+#endif
 int	serial_getc   (void);
 int	serial_tstc   (void);
 
@@ -793,6 +807,36 @@ int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
 
+/**
+ * gunzip_read_func - supply the next chunk of compressed data
+ *
+ * @param	priv		private data passed to gunzip_stream()
+ * @param	buf		buffer to fill
+ * @param	offset		offset in bytes of the chunk in the gzip file
+ * @param	size		maximum number of bytes to read
+ * @return number of bytes read, 0 at end of file, -ve on error
+ */
+typedef int gunzip_read_func(void *priv, void *buf, unsigned long offset,
+			     unsigned long size);
+
+/**
+ * gunzip_stream() - decompress gzip data which is read in chunks
+ *
+ * Only a buffer of 'bufsize' bytes holds compressed data at any time, so
+ * the compressed file never needs to be in memory as a whole.
+ *
+ * @param	dst		destination for uncompressed data
+ * @param	dstlen		maximum uncompressed size
+ * @param	read		function returning compressed data
+ * @param	priv		private data passed to 'read'
+ * @param	bufsize		size of the chunks to read; the first chunk
+ *				must contain the whole gzip header
+ * @param	lenp		returns the uncompressed size
+ * @return 0 if OK, -1 on error
+ */
+int gunzip_stream(void *dst, unsigned long dstlen, gunzip_read_func *read,
+		  void *priv, unsigned long bufsize, unsigned long *lenp);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
@@ -32,5 +32,8 @@
 #undef CONFIG_DM_SEQ_ALIAS
 #undef CONFIG_DM_STDIO
 
+/* SPL does not relocate, which is when console output is buffered */
+#undef CONFIG_SERIAL_TX_BUFFER
+
 #endif /* CONFIG_SPL_BUILD */
 #endif /* __CONFIG_UNCMD_SPL_H__ */
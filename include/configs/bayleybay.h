@@ -31,6 +31,7 @@
 #define CONFIG_SDHCI
 #define CONFIG_GENERIC_MMC
 #define CONFIG_MMC_SDMA
+#define CONFIG_MMC_SDHCI_ADMA
 #define CONFIG_CMD_MMC
 
 /* BayTrail IGD support */
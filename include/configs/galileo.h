@@ -41,6 +41,7 @@
 #define CONFIG_SDHCI
 #define CONFIG_GENERIC_MMC
 #define CONFIG_MMC_SDMA
+#define CONFIG_MMC_SDHCI_ADMA
 #define CONFIG_CMD_MMC
 
 /* 10/100M Ethernet support */
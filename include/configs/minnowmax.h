@@ -36,6 +36,7 @@
 #define CONFIG_SDHCI
 #define CONFIG_GENERIC_MMC
 #define CONFIG_MMC_SDMA
+#define CONFIG_MMC_SDHCI_ADMA
 #define CONFIG_CMD_MMC
 
 #undef CONFIG_USB_MAX_CONTROLLER_COUNT
@@ -55,6 +55,12 @@
 #define CONFIG_EFI_PARTITION
 #define CONFIG_DOS_PARTITION
 
+#define CONFIG_MMC
+#define CONFIG_GENERIC_MMC
+#define CONFIG_CMD_MMC
+#define CONFIG_MMC_UHS_SUPPORT
+#define CONFIG_MMC_HS200_SUPPORT
+
 /*
  * Size of malloc() pool, before and after relocation
  */
@@ -90,6 +96,19 @@
 #define CONFIG_SPI_FLASH_STMICRO
 #define CONFIG_SPI_FLASH_WINBOND
 
+/* NAND - a simulated chip for UBI */
+#ifdef CONFIG_NAND_SANDBOX
+#define CONFIG_SYS_MAX_NAND_DEVICE	1
+#define CONFIG_SYS_NAND_BASE		0
+#define CONFIG_MTD_DEVICE
+#define CONFIG_MTD_PARTITIONS
+#define CONFIG_CMD_MTDPARTS
+#define CONFIG_CMD_UBI
+#define CONFIG_RBTREE
+#define MTDIDS_DEFAULT			"nand0=nand0"
+#define MTDPARTS_DEFAULT		"mtdparts=nand0:-(ubi)"
+#endif
+
 #define CONFIG_CMD_I2C
 #define CONFIG_I2C_EDID
 #define CONFIG_I2C_EEPROM
@@ -128,6 +147,7 @@
 
 #define CONFIG_KEEP_SERVERADDR
 #define CONFIG_UDP_CHECKSUM
+#define CONFIG_TFTP_TSIZE
 #define CONFIG_CMD_LINK_LOCAL
 #define CONFIG_CMD_CDP
 #define CONFIG_CMD_DNS
@@ -82,6 +82,10 @@ struct driver_info;
  *		When CONFIG_DEVRES is enabled, devm_kmalloc() and friends will
  *		add to this list. Memory so-allocated will be freed
  *		automatically when the device is removed / unbound
+ * @bind_us: Time taken to bind this device in microseconds, including any
+ *		children bound by its bind method (CONFIG_DM_TIMING)
+ * @probe_us: Time taken by the last successful probe of this device in
+ *		microseconds, not counting its parents (CONFIG_DM_TIMING)
  */
 struct udevice {
 	const struct driver *driver;
@@ -105,6 +109,10 @@ struct udevice {
 #ifdef CONFIG_DEVRES
 	struct list_head devres_head;
 #endif
+#ifdef CONFIG_DM_TIMING
+	uint32_t bind_us;
+	uint32_t probe_us;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -44,6 +44,27 @@ struct uclass_driver *lists_uclass_lookup(enum uclass_id id);
  */
 int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 
+/**
+ * lists_driver_lookup_fdt() - find the driver for a device tree node
+ *
+ * This finds the first driver in the driver list which matches any of the
+ * node's compatible strings. After relocation this uses an index of all
+ * drivers' compatible strings, sorted so it can be searched quickly. It is
+ * built the first time it is needed.
+ *
+ * @blob: device tree blob
+ * @offset: offset of this device tree node
+ * @use_index: true to use the index where possible, false to check each
+ *	driver in turn (this is only useful for testing)
+ * @drvp: returns the driver found
+ * @idp: returns the matching entry in the driver's of_match table
+ * @return 0 if found, -ENOENT if no driver matches, -ENODEV if the node
+ * has no compatible string, -EINVAL if the device tree is invalid
+ */
+int lists_driver_lookup_fdt(const void *blob, int offset, bool use_index,
+			    struct driver **drvp,
+			    const struct udevice_id **idp);
+
 /**
  * lists_bind_fdt() - bind a device tree node
  *
@@ -30,6 +30,7 @@
 
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT_INIT_MAX_LEN		(1UL << 15) /* Longer means uninitialized */
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_INDIRECT_BLOCKS		12
@@ -133,6 +134,7 @@ int ext4_write_file(const char *filename, void *buf, loff_t offset, loff_t len,
 struct ext_filesystem *get_fs(void);
 int ext4fs_open(const char *filename, loff_t *len);
 int ext4fs_read(char *buf, loff_t len, loff_t *actread);
+int ext4fs_read_open(void *buf, loff_t offset, loff_t len, loff_t *actread);
 int ext4fs_mount(unsigned part_length);
 void ext4fs_close(void);
 void ext4fs_reinit_global(void);
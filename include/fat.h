@@ -33,6 +33,16 @@
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/*
+ * Number of FATBUFBLOCKS windows of the FAT kept by the read path. If the
+ * whole FAT fits, it is read in one go the first time it is needed.
+ */
+#ifndef CONFIG_FS_FAT_CACHE_WINDOWS
+#define CONFIG_FS_FAT_CACHE_WINDOWS	16
+#endif
+#define FATCACHE_WINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
+#define FATCACHESIZE	(FATBUFSIZE * FATCACHE_WINDOWS)
+
 
 /* Filesystem identifiers */
 #define FAT12_SIGN	"FAT12   "
@@ -165,7 +175,7 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* Current FAT buffer (write path) */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
@@ -173,7 +183,13 @@ typedef struct {
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufnum;	/* Used by get_fatent_value, init to -1 */
+	__u8	*fatcache;	/* FAT windows cached for reading */
+	int	fatcachenum[FATCACHE_WINDOWS];	/* Window in each slot or -1 */
+	__u32	fatcacheuse[FATCACHE_WINDOWS];	/* LRU stamp of each slot */
+	__u32	fatcachetick;	/* Last LRU stamp handed out */
+	__u32	clust_hint;	/* Cluster at clust_hint_pos in the file, or 0 */
+	loff_t	clust_hint_pos;	/* File offset of clust_hint */
 } fsdata;
 
 typedef int	(file_detectfs_func)(void);
@@ -210,5 +226,7 @@ int file_fat_write(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actwrite);
 int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread);
+int fat_open(const char *filename, loff_t *size);
+int fat_read_open(void *buf, loff_t offset, loff_t len, loff_t *actread);
 void fat_close(void);
 #endif /* _FAT_H_ */
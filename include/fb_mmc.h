@@ -7,3 +7,57 @@
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes, char *response);
 void fb_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fb_mmc_stream_start() - Write the next download straight to a partition
+ *
+ * The next download is written to the partition while it is received,
+ * instead of being held in the download buffer until a flash command.
+ * An empty partition name cancels this.
+ *
+ * @cmd:	Partition name
+ * @response:	Set to the fastboot response
+ */
+void fb_mmc_stream_start(const char *cmd, char *response);
+
+/**
+ * fb_mmc_stream_size() - Get the largest download that can be streamed
+ *
+ * @return maximum download size in bytes, or 0 if streaming is not armed
+ */
+unsigned int fb_mmc_stream_size(void);
+
+/**
+ * fb_mmc_stream_reset() - Drop what is left of an earlier streamed download
+ *
+ * This is used by the download command, so that the result of a streamed
+ * download which was not flashed, or the state of one which was not
+ * finished, is not taken for that of the new download. A partition armed
+ * by fb_mmc_stream_start() but not yet written to stays armed.
+ */
+void fb_mmc_stream_reset(void);
+
+/**
+ * fb_mmc_stream_write() - Write the next part of a streamed download
+ *
+ * @buf:	Data received
+ * @len:	Number of bytes received
+ */
+void fb_mmc_stream_write(const void *buf, unsigned int len);
+
+/**
+ * fb_mmc_stream_finish() - Finish writing a streamed download
+ */
+void fb_mmc_stream_finish(void);
+
+/**
+ * fb_mmc_stream_result() - Get the result of a streamed download
+ *
+ * This is used by the flash command which follows a streamed download.
+ *
+ * @cmd:	Partition name given to the flash command
+ * @response:	Set to the fastboot response
+ * @return true if a streamed download was waiting for this command, false
+ * if the download buffer should be flashed as normal
+ */
+bool fb_mmc_stream_result(const char *cmd, char *response);
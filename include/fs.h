@@ -96,6 +96,12 @@ int do_size(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
 int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
+/*
+ * Load a gzip-compressed file, decompressing it while it is read in chunks
+ * so that the compressed file is never held in memory as a whole.
+ */
+int do_gzload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+	      int fstype);
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
 int file_exists(const char *dev_type, const char *dev_part, const char *file,
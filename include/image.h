@@ -96,6 +96,19 @@ struct lmb;
 
 #endif /* CONFIG_FIT */
 
+/*
+ * Hash the images in a FIT on several CPUs at once. Jobs must not reset the
+ * watchdog or use hashing hardware, so not with either of those.
+ */
+#if defined(CONFIG_FIT) && defined(CONFIG_MP_JOBS) && \
+	!defined(USE_HOSTCC) && !defined(CONFIG_SPL_BUILD) && \
+	!defined(CONFIG_HW_WATCHDOG) && !defined(CONFIG_WATCHDOG) && \
+	!defined(CONFIG_SHA_HW_ACCEL)
+# define IMAGE_ENABLE_PARALLEL_HASH	1
+#else
+# define IMAGE_ENABLE_PARALLEL_HASH	0
+#endif
+
 #ifdef CONFIG_SYS_BOOT_RAMDISK_HIGH
 # define IMAGE_ENABLE_RAMDISK_HIGH	1
 #else
@@ -294,6 +307,26 @@ typedef struct image_info {
 	uint8_t		arch;			/* CPU architecture */
 } image_info_t;
 
+#if defined(CONFIG_FIT)
+/* Maximum number of FIT hash nodes calculated in one batch */
+#define FIT_HASH_BATCH_MAX	16
+
+/*
+ * Value of a FIT image hash node, calculated ahead of time so that the
+ * hashes of several images can be calculated in parallel
+ */
+struct fit_hash_result {
+	const void *fit;	/* FIT containing the hash node */
+	int noffset;		/* hash node offset */
+	const char *algo;	/* hash algorithm name */
+	const void *data;	/* image data that was hashed */
+	size_t size;		/* and its size in bytes */
+	int err;		/* calculate_hash() return value */
+	int value_len;
+	uint8_t value[HASH_MAX_DIGEST_SIZE];
+};
+#endif
+
 /*
  * Legacy and FIT format headers used by do_bootm() and do_bootm_<os>()
  * routines.
@@ -328,6 +361,12 @@ typedef struct bootm_headers {
 	int		fit_noffset_setup;/* x86 setup subimage node offset */
 #endif
 
+#if IMAGE_ENABLE_PARALLEL_HASH
+	/* Hashes of the images in the selected configuration */
+	struct fit_hash_result fit_hashes[FIT_HASH_BATCH_MAX];
+	int		fit_hash_count;
+#endif
+
 #ifndef USE_HOSTCC
 	image_info_t	os;		/* os image info */
 	ulong		ep;		/* entry point of OS */
@@ -535,6 +574,27 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp);
 
+/**
+ * fit_forget_hashes() - Drop hashes calculated ahead of time by bootm
+ *
+ * When fit_image_load() selects a configuration for the kernel it hashes
+ * all the images in that configuration at once. This must be called if
+ * memory is overwritten before the remaining images are verified, so that
+ * they are hashed again.
+ *
+ * @param images	Boot images structure
+ * @param start		Start address of the memory overwritten
+ * @param len		Number of bytes overwritten
+ */
+#if IMAGE_ENABLE_PARALLEL_HASH
+void fit_forget_hashes(bootm_headers_t *images, ulong start, ulong len);
+#else
+static inline void fit_forget_hashes(bootm_headers_t *images, ulong start,
+				     ulong len)
+{
+}
+#endif
+
 #ifndef USE_HOSTCC
 /**
  * fit_get_node_from_config() - Look up an image a FIT by type
@@ -0,0 +1,87 @@
+/*
+ * Fast memory test engine used by 'mtest'
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __MEMTEST_H
+#define __MEMTEST_H
+
+enum memtest_pattern {
+	MEMTEST_ZEROS,
+	MEMTEST_ONES,
+	MEMTEST_CHECKER,	/* 0xaaaa... */
+	MEMTEST_INV_CHECKER,	/* 0x5555... */
+	MEMTEST_ADDRESS,	/* each word holds its own address */
+	MEMTEST_INV_ADDRESS,
+	MEMTEST_RANDOM,		/* pseudo-random, from the seed */
+
+	MEMTEST_PATTERN_COUNT,
+};
+
+/**
+ * struct memtest_run - a region to test, and the results so far
+ *
+ * The caller fills in @addr, @buf, @size and @seed. The region is split
+ * into chunks which are filled and checked on all available CPUs (see
+ * mp_run_jobs()), so it must not hold anything those CPUs are using.
+ *
+ * @addr:	Address of the region, as reported in errors
+ * @buf:	Region as mapped for access, aligned to sizeof(ulong)
+ * @size:	Size of the region in bytes; any trailing partial word is
+ *		not tested
+ * @seed:	Seed for MEMTEST_RANDOM
+ * @errors:	Number of words which read back wrongly in the last check
+ * @bad_addr:	Address of the first such word
+ * @found:	Value read from it
+ * @expected:	Value written to it
+ * @fill_us:	Time taken by the last fill in microseconds
+ * @check_us:	Time taken by the last check in microseconds
+ */
+struct memtest_run {
+	ulong addr;
+	void *buf;
+	ulong size;
+	ulong seed;
+
+	ulong errors;
+	ulong bad_addr;
+	ulong found;
+	ulong expected;
+	ulong fill_us;
+	ulong check_us;
+};
+
+/**
+ * memtest_pattern_name() - Get the name of a pattern
+ *
+ * @pattern:	Pattern to look up (enum memtest_pattern)
+ * @return name, or NULL if @pattern is not valid
+ */
+const char *memtest_pattern_name(int pattern);
+
+/**
+ * memtest_fill() - Write a pattern to the whole region
+ *
+ * Where the CPU can do so, the pattern is written with stores which
+ * bypass the cache, so that memtest_check() reads it back from memory.
+ *
+ * @run:	Region to fill; @run->fill_us is updated
+ * @pattern:	Pattern to write (enum memtest_pattern)
+ * @return 0 if OK, -EINVAL if @pattern is not valid, -ENOMEM if out of
+ * memory
+ */
+int memtest_fill(struct memtest_run *run, int pattern);
+
+/**
+ * memtest_check() - Check that the region still holds a pattern
+ *
+ * @run:	Region to check, last filled with @pattern. The error
+ *		information and @run->check_us are updated.
+ * @pattern:	Pattern which was written
+ * @return 0 if OK, -EIO if any word was wrong, -EINVAL if @pattern is not
+ * valid, -ENOMEM if out of memory
+ */
+int memtest_check(struct memtest_run *run, int pattern);
+
+#endif
@@ -56,6 +56,16 @@
 #define MMC_MODE_8BIT		(1 << 3)
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_DDR_52MHz	(1 << 5)
+#define MMC_MODE_HS200		(1 << 6)
+#define MMC_MODE_HS400		(1 << 7)
+#define MMC_MODE_UHS_SDR50	(1 << 8)
+#define MMC_MODE_UHS_SDR104	(1 << 9)
+
+#define MMC_MODE_UHS		(MMC_MODE_UHS_SDR50 | MMC_MODE_UHS_SDR104)
+
+#if defined(CONFIG_MMC_UHS_SUPPORT) || defined(CONFIG_MMC_HS200_SUPPORT)
+#define MMC_SUPPORTS_TUNING
+#endif
 
 #define SD_DATA_4BIT	0x00040000
 
@@ -86,6 +96,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -105,6 +116,7 @@
 #define SD_CMD_SWITCH_FUNC		6
 #define SD_CMD_SEND_IF_COND		8
 #define SD_CMD_SWITCH_UHS18V		11
+#define SD_CMD_SEND_TUNING_BLOCK	19
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
 #define SD_CMD_ERASE_WR_BLK_START	32
@@ -115,9 +127,17 @@
 /* SCR definitions in different words */
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
+#define SD_UHS_SDR50_SUPPORTED	0x00040000
+#define SD_UHS_SDR104_SUPPORTED	0x00080000
+
+/* Access mode (function group 1) values for SD_CMD_SWITCH_FUNC */
+#define SD_ACCESS_MODE_SDR25	1
+#define SD_ACCESS_MODE_SDR50	2
+#define SD_ACCESS_MODE_SDR104	3
 
 #define OCR_BUSY		0x80000000
 #define OCR_HCS			0x40000000
+#define OCR_S18R		0x01000000	/* 1.8V switching request/accepted */
 #define OCR_VOLTAGE_MASK	0x007FFF80
 #define OCR_ACCESS_MODE		0x60000000
 
@@ -201,6 +221,15 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)
+#define EXT_CSD_CARD_TYPE_HS400_1_8V	(1 << 6)
+#define EXT_CSD_CARD_TYPE_HS400_1_2V	(1 << 7)
+
+#define EXT_CSD_TIMING_LEGACY	0	/* Backwards compatible timing */
+#define EXT_CSD_TIMING_HS	1	/* High speed (26/52MHz) */
+#define EXT_CSD_TIMING_HS200	2	/* HS200, 8/4 bit SDR */
+#define EXT_CSD_TIMING_HS400	3	/* HS400, 8 bit DDR */
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -324,6 +353,41 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/*
+	 * Optional support for queued reads (see mmc_req_submit()). A host
+	 * providing start_cmd must also provide poll_cmd.
+	 *
+	 * start_cmd() issues a data command like send_cmd() but returns as
+	 * soon as the transfer is running. poll_cmd() then returns -EBUSY
+	 * until it has finished, after which it returns the result that
+	 * send_cmd() would have given. It must time out by itself.
+	 *
+	 * prepare_data() may be called for the next request while another
+	 * one is running, so that the host can set up its DMA descriptors
+	 * ahead of time. The same @data is later passed to start_cmd(). It
+	 * is called with a NULL @data when the queue is empty, to drop
+	 * anything prepared.
+	 */
+	int (*start_cmd)(struct mmc *mmc,
+			 struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*poll_cmd)(struct mmc *mmc,
+			struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*prepare_data)(struct mmc *mmc, struct mmc_data *data);
+	/*
+	 * Optional support for UHS-I and HS200/HS400. These modes are only
+	 * used if the host provides both hooks and sets the matching
+	 * MMC_MODE_... bits in host_caps.
+	 *
+	 * set_signal_voltage() switches the I/O lines to one of the
+	 * MMC_SIGNAL_VOLTAGE_... levels, including the SD clock handling
+	 * needed after CMD11. It returns 0 on success.
+	 *
+	 * execute_tuning() finds a sampling point for the clock and timing
+	 * just selected (see mmc->timing), sending @opcode as many times as
+	 * it needs. Hosts without tuning hardware can use mmc_send_tuning().
+	 */
+	int (*set_signal_voltage)(struct mmc *mmc, uint voltage);
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
 };
 
 struct mmc_config {
@@ -377,6 +441,60 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	uint timing;		/* MMC_TIMING_..., for use by set_ios() */
+	uint signal_voltage;	/* MMC_SIGNAL_VOLTAGE_... */
+	struct mmc_req *req_head;	/* queued reads, oldest first */
+	struct mmc_req *req_tail;
+};
+
+enum mmc_timing {
+	MMC_TIMING_LEGACY,
+	MMC_TIMING_MMC_HS,
+	MMC_TIMING_SD_HS,
+	MMC_TIMING_UHS_SDR50,
+	MMC_TIMING_UHS_SDR104,
+	MMC_TIMING_MMC_HS200,
+	MMC_TIMING_MMC_HS400,
+};
+
+enum mmc_signal_voltage {
+	MMC_SIGNAL_VOLTAGE_330,
+	MMC_SIGNAL_VOLTAGE_180,
+};
+
+enum mmc_req_state {
+	MMC_REQ_IDLE,		/* never submitted */
+	MMC_REQ_QUEUED,		/* waiting for earlier requests */
+	MMC_REQ_ACTIVE,		/* transfer running */
+	MMC_REQ_DONE,		/* finished, see @ret */
+};
+
+/**
+ * struct mmc_req - a queued block read
+ *
+ * The caller fills in @start, @blkcnt and @dst and must leave the request
+ * alone until it is done. The remaining members belong to the MMC core.
+ *
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read, at most cfg->b_max
+ * @dst:	Buffer to read into
+ * @ret:	Number of blocks read, or -ve error, once the request is done
+ * @state:	Progress of the request
+ * @prepared:	true if the host has been asked to prepare the transfer
+ * @next:	Next request in the queue
+ * @cmd:	Read command
+ * @data:	Data transfer for @cmd
+ */
+struct mmc_req {
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *dst;
+	int ret;
+	enum mmc_req_state state;
+	bool prepared;
+	struct mmc_req *next;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
 };
 
 struct mmc_hwpart_conf {
@@ -419,6 +537,23 @@ int board_mmc_getcd(struct mmc *mmc);
 int mmc_getwp(struct mmc *mmc);
 int board_mmc_getwp(struct mmc *mmc);
 int mmc_set_dsr(struct mmc *mmc, u16 val);
+
+/* Tuning block patterns returned by CMD19/CMD21 on a 4-bit and 8-bit bus */
+extern const u8 mmc_tuning_blk_pattern_4bit[64];
+extern const u8 mmc_tuning_blk_pattern_8bit[128];
+
+/**
+ * mmc_send_tuning() - Read the tuning block once and check it
+ *
+ * This is for hosts which tune in software: they try each sampling point
+ * in turn, calling this to see whether the card can be read reliably.
+ *
+ * @mmc:	MMC device
+ * @opcode:	Tuning command, as passed to execute_tuning()
+ * @return 0 if the block was read correctly, -EIO if it was corrupted,
+ * other -ve on error
+ */
+int mmc_send_tuning(struct mmc *mmc, uint opcode);
 /* Function to change the size of boot partition and rpmb partitions */
 int mmc_boot_partition_size_change(struct mmc *mmc, unsigned long bootsize,
 					unsigned long rpmbsize);
@@ -460,6 +595,55 @@ int mmc_start_init(struct mmc *mmc);
  */
 void mmc_set_preinit(struct mmc *mmc, int preinit);
 
+/**
+ * mmc_req_submit() - Queue a block read
+ *
+ * The request is started straight away if the queue is empty, otherwise
+ * once the requests before it are done. Hosts which cannot run transfers
+ * in the background complete the request before this returns. The
+ * partition cache is not used.
+ *
+ * While requests are outstanding no other commands may be sent to the
+ * card; use mmc_req_flush() first.
+ *
+ * @mmc:	MMC device, which must have been initialised
+ * @req:	Request to queue
+ * @return 0 if queued, -ve on error (the request is then not queued)
+ */
+int mmc_req_submit(struct mmc *mmc, struct mmc_req *req);
+
+/**
+ * mmc_req_poll() - Make progress on queued reads without blocking
+ *
+ * This completes the running request if its transfer has finished and
+ * starts the next one.
+ *
+ * @mmc:	MMC device
+ * @return true if requests are still outstanding
+ */
+bool mmc_req_poll(struct mmc *mmc);
+
+/**
+ * mmc_req_wait() - Wait for a queued read to finish
+ *
+ * @mmc:	MMC device
+ * @req:	Request to wait for
+ * @return number of blocks read, or -ve on error
+ */
+int mmc_req_wait(struct mmc *mmc, struct mmc_req *req);
+
+/**
+ * mmc_req_flush() - Wait for all queued reads to finish
+ *
+ * @mmc:	MMC device
+ */
+void mmc_req_flush(struct mmc *mmc);
+
+static inline bool mmc_req_done(struct mmc_req *req)
+{
+	return req->state == MMC_REQ_DONE;
+}
+
 #ifdef CONFIG_GENERIC_MMC
 #ifdef CONFIG_MMC_SPI
 #define mmc_host_is_spi(mmc)	((mmc)->cfg->host_caps & MMC_MODE_SPI)
@@ -0,0 +1,64 @@
+/*
+ * Running independent pieces of work on secondary CPUs
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __MP_JOB_H
+#define __MP_JOB_H
+
+/**
+ * struct mp_job - a unit of work for mp_run_jobs()
+ *
+ * A job may run on any CPU, so it must only touch the memory it is given.
+ * In particular it must not use malloc(), the console, driver model,
+ * WATCHDOG_RESET() or hardware accelerators, none of which are safe to call
+ * from more than one CPU. Secondary CPUs also have small stacks
+ * (CONFIG_AP_STACK_SIZE on x86).
+ *
+ * @func:	Function to call
+ * @arg:	Argument to pass to @func
+ * @ret:	Set to the return value of @func once the job has run
+ */
+struct mp_job {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+};
+
+/**
+ * mp_run_jobs_serial() - Run a list of jobs one after the other
+ *
+ * @jobs:	Jobs to run
+ * @count:	Number of jobs
+ */
+static inline void mp_run_jobs_serial(struct mp_job *jobs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		jobs[i].ret = jobs[i].func(jobs[i].arg);
+}
+
+#if defined(CONFIG_MP_JOBS) && !defined(USE_HOSTCC) && \
+	!defined(CONFIG_SPL_BUILD)
+/**
+ * mp_run_jobs() - Run a list of independent jobs, in parallel if possible
+ *
+ * The jobs are shared out between the calling CPU and any secondary CPUs
+ * which were started by mp_init() and are now idle. Jobs can run in any
+ * order. This returns once every job has finished. Without secondary
+ * CPUs the jobs are run in turn on the calling CPU.
+ *
+ * @jobs:	Jobs to run; the @ret member of each is updated
+ * @count:	Number of jobs
+ */
+void mp_run_jobs(struct mp_job *jobs, int count);
+#else
+static inline void mp_run_jobs(struct mp_job *jobs, int count)
+{
+	mp_run_jobs_serial(jobs, count);
+}
+#endif
+
+#endif
@@ -370,6 +370,11 @@ struct ip_udp_hdr {
 #define IP_UDP_HDR_SIZE		(sizeof(struct ip_udp_hdr))
 #define UDP_HDR_SIZE		(IP_UDP_HDR_SIZE - IP_HDR_SIZE)
 
+/* Largest UDP payload that is reassembled from IP fragments */
+#ifndef CONFIG_NET_MAXDEFRAG
+#define CONFIG_NET_MAXDEFRAG 16384
+#endif
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -501,6 +506,76 @@ extern uchar		*net_tx_packet;		/* THE transmit packet */
 extern uchar		*net_rx_packets[PKTBUFSRX]; /* Receive packets */
 extern uchar		*net_rx_packet;		/* Current receive packet */
 extern int		net_rx_packet_len;	/* Current rx packet length */
+
+/**
+ * struct net_rx_target - where a protocol wants its next payload
+ *
+ * A protocol which knows where the data in the next packet it expects
+ * will end up (such as TFTP) can describe it here. A driver which is able
+ * to split a packet as it receives it may then put the headers in its
+ * packet buffer as usual and the following @len bytes straight into @buf,
+ * setting @placed to the number of bytes written there. It must still
+ * leave room for the whole packet in its packet buffer.
+ *
+ * Before the packet is processed, @match is called to check that it is
+ * the one expected. If not, the payload is copied back into the packet
+ * buffer so that nothing else sees the difference. The protocol then
+ * uses net_rx_placed() to find out whether there is anything to copy.
+ * @match must only accept a packet whose whole payload was placed, since
+ * a UDP checksum is checked over the headers and then the data at @buf.
+ * That also needs an even number of UDP header bytes before the payload.
+ *
+ * @buf:	Destination for the payload, or NULL if none is expected
+ * @hdr_len:	Number of bytes of headers (from the Ethernet header on)
+ *		before the payload
+ * @len:	Maximum number of bytes to put at @buf
+ * @match:	Returns non-zero if the packet is the one expected
+ * @placed:	Set by the driver to the number of bytes put at @buf
+ */
+struct net_rx_target {
+	void *buf;
+	int hdr_len;
+	int len;
+	int (*match)(uchar *pkt, int len);
+	int placed;
+};
+
+#ifdef CONFIG_NET_RX_PLACE
+extern struct net_rx_target net_rx_target;
+
+/**
+ * net_set_rx_target() - Say where the payload of the next packet goes
+ *
+ * @buf:	Destination, or NULL to stop placing payloads
+ * @hdr_len:	Bytes of headers before the payload
+ * @len:	Maximum payload size
+ * @match:	Function to check that a packet is the one expected
+ */
+void net_set_rx_target(void *buf, int hdr_len, int len,
+		       int (*match)(uchar *pkt, int len));
+
+/**
+ * net_rx_placed() - Check if the current packet's payload is in place
+ *
+ * @dst:	Where the caller is about to copy the payload
+ * @len:	Length of the payload
+ * @return true if the driver has already put exactly this payload at @dst
+ */
+static inline bool net_rx_placed(const void *dst, int len)
+{
+	return net_rx_target.placed == len && net_rx_target.buf == dst;
+}
+#else
+static inline void net_set_rx_target(void *buf, int hdr_len, int len,
+				     int (*match)(uchar *pkt, int len))
+{
+}
+
+static inline bool net_rx_placed(const void *dst, int len)
+{
+	return false;
+}
+#endif
 extern const u8		net_bcast_ethaddr[6];	/* Ethernet broadcast address */
 extern const u8		net_null_ethaddr[6];
 
@@ -51,11 +51,13 @@
  * @base:		Base register address
  * @reg_shift:		Shift size of registers (0=byte, 1=16bit, 2=32bit...)
  * @clock:		UART base clock speed in Hz
+ * @fifo_size:		Transmit FIFO depth in bytes (0 or 1 if none)
  */
 struct ns16550_platdata {
 	unsigned long base;
 	int reg_shift;
 	int clock;
+	int fifo_size;
 };
 
 struct udevice;
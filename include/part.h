@@ -95,6 +95,81 @@ typedef struct disk_partition {
 #endif
 } disk_partition_t;
 
+#ifdef CONFIG_BLOCK_CACHE
+/**
+ * blkcache_read() - attempt to read a set of blocks from cache
+ *
+ * @param if_type - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param blksz - size in bytes of each block
+ * @param buffer - buffer to contain cached data
+ *
+ * @return - '1' if block returned from cache, '0' otherwise.
+ */
+int blkcache_read(int if_type, int dev, lbaint_t start, lbaint_t blkcnt,
+		  unsigned long blksz, void *buffer);
+
+/**
+ * blkcache_fill() - make data read from a block device available
+ * to the block cache
+ *
+ * @param if_type - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks available
+ * @param blksz - size in bytes of each block
+ * @param buffer - buffer containing data to cache
+ */
+void blkcache_fill(int if_type, int dev, lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer);
+
+/**
+ * blkcache_invalidate() - discard the cache for a set of blocks
+ * because of a write or device (re)initialization.
+ *
+ * @param if_type - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ */
+void blkcache_invalidate(int if_type, int dev);
+
+/**
+ * blkcache_configure() - configure block cache
+ *
+ * @param blocks - maximum blocks per entry
+ * @param entries - maximum entries in cache
+ */
+void blkcache_configure(unsigned blocks, unsigned entries);
+
+/*
+ * statistics of the block cache
+ */
+struct block_cache_stats {
+	unsigned hits;
+	unsigned misses;
+	unsigned entries; /* current entry count */
+	unsigned max_blocks_per_entry;
+	unsigned max_entries;
+};
+
+/**
+ * blkcache_stats() - return statistics and reset
+ *
+ * @param stats - statistics are copied here
+ */
+void blkcache_stats(struct block_cache_stats *stats);
+#else
+static inline int blkcache_read(int if_type, int dev, lbaint_t start,
+				lbaint_t blkcnt, unsigned long blksz,
+				void *buffer)
+{ return 0; }
+static inline void blkcache_fill(int if_type, int dev, lbaint_t start,
+				 lbaint_t blkcnt, unsigned long blksz,
+				 const void *buffer) {}
+static inline void blkcache_invalidate(int if_type, int dev) {}
+#endif
+
 /* Misc _get_dev functions */
 #ifdef CONFIG_PARTITIONS
 block_dev_desc_t *get_dev(const char *ifname, int dev);
@@ -64,6 +64,7 @@
 #define  SDHCI_CARD_STATE_STABLE	0x00020000
 #define  SDHCI_CARD_DETECT_PIN_LEVEL	0x00040000
 #define  SDHCI_WRITE_PROTECT	0x00080000
+#define  SDHCI_DATA_LVL_MASK	0x00F00000
 
 #define SDHCI_HOST_CONTROL	0x28
 #define  SDHCI_CTRL_LED		0x01
@@ -144,7 +145,17 @@
 
 #define SDHCI_ACMD12_ERR	0x3C
 
-/* 3E-3F reserved */
+#define SDHCI_HOST_CONTROL2	0x3E
+#define  SDHCI_CTRL_UHS_MASK	0x0007
+#define   SDHCI_CTRL_UHS_SDR12	0x0000
+#define   SDHCI_CTRL_UHS_SDR25	0x0001
+#define   SDHCI_CTRL_UHS_SDR50	0x0002
+#define   SDHCI_CTRL_UHS_SDR104	0x0003
+#define   SDHCI_CTRL_UHS_DDR50	0x0004
+#define   SDHCI_CTRL_HS400	0x0005	/* Non-standard */
+#define  SDHCI_CTRL_VDD_180	0x0008
+#define  SDHCI_CTRL_EXEC_TUNING	0x0040
+#define  SDHCI_CTRL_TUNED_CLK	0x0080
 
 #define SDHCI_CAPABILITIES	0x40
 #define  SDHCI_TIMEOUT_CLK_MASK	0x0000003F
@@ -166,6 +177,11 @@
 #define  SDHCI_CAN_64BIT	0x10000000
 
 #define SDHCI_CAPABILITIES_1	0x44
+#define  SDHCI_SUPPORT_SDR50	0x00000001
+#define  SDHCI_SUPPORT_SDR104	0x00000002
+#define  SDHCI_SUPPORT_DDR50	0x00000004
+#define  SDHCI_USE_SDR50_TUNING	0x00002000
+#define  SDHCI_SUPPORT_HS400	0x80000000	/* Non-standard */
 
 #define SDHCI_MAX_CURRENT	0x48
 
@@ -179,6 +195,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -214,6 +231,7 @@
 #define SDHCI_QUIRK_WAIT_SEND_CMD	(1 << 6)
 #define SDHCI_QUIRK_NO_SIMULT_VDD_AND_POWER (1 << 7)
 #define SDHCI_QUIRK_USE_WIDE8		(1 << 8)
+#define SDHCI_QUIRK_NO_1_8_V		(1 << 9)
 
 /* to make gcc happy */
 struct sdhci_host;
@@ -223,6 +241,40 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/* Number of tuning commands the controller may need to find a sample point */
+#define SDHCI_TUNING_LOOPS		40
+
+/*
+ * ADMA2 descriptors. Each one moves up to SDHCI_ADMA_MAX_LEN bytes; the
+ * 64-bit format adds the upper half of the address.
+ */
+#define SDHCI_ADMA_VALID	0x01
+#define SDHCI_ADMA_END		0x02
+#define SDHCI_ADMA_INT		0x04
+#define SDHCI_ADMA_ACT_TRAN	0x20
+#define SDHCI_ADMA_ACT_LINK	0x30
+
+#define SDHCI_ADMA_MAX_LEN	65532
+#define SDHCI_ADMA32_DESC_SIZE	8
+#define SDHCI_ADMA64_DESC_SIZE	12
+
+struct sdhci_adma_desc {
+	u8 attr;
+	u8 reserved;
+	__le16 len;
+	__le32 addr_lo;
+	__le32 addr_hi;
+} __packed;
+
+/* The transfer an ADMA2 descriptor table was built for */
+struct sdhci_adma_prep {
+	struct mmc_data *data;		/* transfer, or NULL if none */
+	const void *buf;		/* its buffer */
+	uint blocks;
+	uint blocksize;
+};
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32             (*read_l)(struct sdhci_host *host, int reg);
@@ -254,6 +306,15 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	void *adma_table[2];		/* ADMA2 descriptor tables, or NULL */
+	struct sdhci_adma_prep adma_data[2]; /* transfer each table is for */
+	int adma_cur;			/* table in use, or -1 */
+	bool adma64;			/* use 64-bit descriptors */
+	bool async_busy;		/* queued transfer running */
+	int async_ret;			/* result of a queued command */
+	ulong async_start;		/* time the queued transfer started */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
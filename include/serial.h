@@ -112,6 +112,24 @@ struct dm_serial_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*putc)(struct udevice *dev, const char ch);
+	/**
+	 * puts() - Write as many characters as the UART will take now
+	 *
+	 * This writes characters from @s until the transmit FIFO is full,
+	 * without waiting. It lets buffered console output fill the whole
+	 * FIFO in one go where putc() would only know that the holding
+	 * register is empty.
+	 *
+	 * This method is optional. Without it, putc() is called for each
+	 * character until it returns -EAGAIN.
+	 *
+	 * @dev: Device pointer
+	 * @s: Characters to write
+	 * @len: Number of characters in @s (at least 1)
+	 * @return number of characters written, -EAGAIN if none could be
+	 * written yet, other -ve on error
+	 */
+	int (*puts)(struct udevice *dev, const char *s, int len);
 	/**
 	 * pending() - Check if input/output characters are waiting
 	 *
@@ -156,9 +174,19 @@ struct dm_serial_ops {
  * struct serial_dev_priv - information about a device used by the uclass
  *
  * @sdev: stdio device attached to this uart
+ * @txbuf: Ring buffer for console output (CONFIG_SERIAL_TX_BUFFER), or NULL
+ * @tx_head: Count of characters put into @txbuf
+ * @tx_tail: Count of characters sent from @txbuf to the UART
+ * @tx_busy: true while @txbuf is being drained
  */
 struct serial_dev_priv {
 	struct stdio_dev *sdev;
+#ifdef CONFIG_SERIAL_TX_BUFFER
+	char *txbuf;
+	uint tx_head;
+	uint tx_tail;
+	bool tx_busy;
+#endif
 };
 
 /* Access the serial operations for a device */
@@ -8,8 +8,14 @@
 #ifndef __TEST_SUITES_H__
 #define __TEST_SUITES_H__
 
+int do_ut_bootstage(cmd_tbl_t *cmdtp, int flag, int argc,
+		    char * const argv[]);
+int do_ut_crc32(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 int do_ut_dm(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 int do_ut_env(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_memtest(cmd_tbl_t *cmdtp, int flag, int argc,
+		  char * const argv[]);
 int do_ut_time(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
+int do_ut_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 
 #endif /* __TEST_SUITES_H__ */
@@ -104,6 +104,20 @@ void sha1_hmac(const unsigned char *key, int keylen,
 		const unsigned char *input, unsigned int ilen,
 		unsigned char *output);
 
+/**
+ * \brief	   Hash whole blocks using CPU instructions, if available
+ *
+ * Architectures with SHA-1 instructions implement this to speed up
+ * sha1_update(). The default implementation returns -ENOSYS.
+ *
+ * \param state    intermediate digest state, updated in place
+ * \param data     input data, blocks * 64 bytes
+ * \param blocks   number of 64-byte blocks to hash
+ * \return	   0 if successful, -ENOSYS if not supported on this CPU
+ */
+int sha1_arch_process(uint32_t state[5], const uint8_t *data,
+		      unsigned int blocks);
+
 /**
  * \brief	   Checkup routine
  *
@@ -16,6 +16,20 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/**
+ * sha256_arch_process() - Hash whole blocks using CPU instructions
+ *
+ * Architectures with SHA-256 instructions implement this to speed up
+ * sha256_update(). The default implementation returns -ENOSYS.
+ *
+ * @state:	Intermediate digest state, updated in place
+ * @data:	Input data, @blocks * 64 bytes
+ * @blocks:	Number of 64-byte blocks to hash
+ * @return 0 if OK, -ENOSYS if not supported on this CPU
+ */
+int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			unsigned int blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
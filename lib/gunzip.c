@@ -8,8 +8,10 @@
 #include <common.h>
 #include <watchdog.h>
 #include <command.h>
+#include <errno.h>
 #include <image.h>
 #include <malloc.h>
+#include <mp_job.h>
 #include <u-boot/zlib.h>
 #include <div64.h>
 
@@ -40,7 +42,11 @@ void gzfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Return the size of the gzip header at 'src', of which 'len' bytes are
+ * available, or -1 if it is invalid or not complete.
+ */
+static int gzip_parse_header(const unsigned char *src, unsigned long len)
 {
 	int i, flags;
 
@@ -54,21 +60,326 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 	if ((flags & EXTRA_FIELD) != 0)
 		i = 12 + src[10] + (src[11] << 8);
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
+	if (i >= len) {
 		puts ("Error: gunzip out of data in header\n");
 		return (-1);
 	}
 
+	return i;
+}
+
+#ifdef CONFIG_GZIP_BGZF
+/*
+ * BGZF, as used by samtools and friends, is a series of gzip members of
+ * up to 64KiB each. The header of each member holds a 'BC' extra field
+ * with the member's size, and the trailer holds its uncompressed size,
+ * so the output offset of every member is known before any of them is
+ * inflated. That lets the members be inflated on all CPUs at once.
+ */
+#define BGZF_HEADER_SIZE	18	/* with the 'BC' extra field */
+#define BGZF_TRAILER_SIZE	8	/* CRC32 and uncompressed size */
+#define BGZF_MAX_JOBS		8
+/* Room for zlib's inflate state and a 32KiB window */
+#define BGZF_ARENA_SIZE		(64 << 10)
+
+/*
+ * inflate() resets the watchdog, which only the boot CPU may do, so with a
+ * watchdog the members are inflated there in turn
+ */
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+#define BGZF_SERIAL		1
+#else
+#define BGZF_SERIAL		0
+#endif
+
+struct bgzf_member {
+	const unsigned char *in;
+	unsigned int in_len;
+	unsigned char *out;
+	unsigned int out_len;
+};
+
+/**
+ * struct bgzf_job - a run of members inflated by one job
+ *
+ * Jobs must not call malloc(), so each has its own small arena which
+ * the inflate state and window are carved from.
+ *
+ * @members:	First member to inflate
+ * @count:	Number of members
+ * @arena:	Memory for zlib
+ * @arena_used:	Bytes of @arena handed out so far
+ */
+struct bgzf_job {
+	struct bgzf_member *members;
+	int count;
+	char *arena;
+	unsigned int arena_used;
+};
+
+/*
+ * Return the total size of the BGZF member at @src, of which @len bytes
+ * are available, or 0 if it is not a BGZF member
+ */
+static unsigned int bgzf_member_size(const unsigned char *src,
+				     unsigned long len)
+{
+	unsigned int size;
+
+	if (len < BGZF_HEADER_SIZE + BGZF_TRAILER_SIZE ||
+	    src[0] != (u8)HEADER0 || src[1] != (u8)HEADER1 ||
+	    src[2] != DEFLATED || src[3] != EXTRA_FIELD ||
+	    src[10] != 6 || src[11] != 0 || src[12] != 'B' || src[13] != 'C' ||
+	    src[14] != 2 || src[15] != 0)
+		return 0;
+	size = (src[16] | src[17] << 8) + 1;
+	if (size < BGZF_HEADER_SIZE + BGZF_TRAILER_SIZE || size > len)
+		return 0;
+
+	return size;
+}
+
+static void *bgzf_zalloc(void *x, unsigned items, unsigned size)
+{
+	struct bgzf_job *job = x;
+	void *p;
+
+	size *= items;
+	size = (size + ZALLOC_ALIGNMENT - 1) & ~(ZALLOC_ALIGNMENT - 1);
+	if (job->arena_used + size > BGZF_ARENA_SIZE)
+		return NULL;
+	p = job->arena + job->arena_used;
+	job->arena_used += size;
+
+	return p;
+}
+
+static void bgzf_zfree(void *x, void *addr, unsigned nb)
+{
+}
+
+static int bgzf_job(void *arg)
+{
+	struct bgzf_job *job = arg;
+	z_stream s;
+	int i, r;
+
+	memset(&s, '\0', sizeof(s));
+	s.zalloc = bgzf_zalloc;
+	s.zfree = bgzf_zfree;
+	s.opaque = job;
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -ENOMEM;
+
+	for (i = 0; i < job->count; i++) {
+		struct bgzf_member *m = &job->members[i];
+
+		if (!m->out_len)
+			continue;
+		inflateReset(&s);
+		s.next_in = (unsigned char *)m->in;
+		s.avail_in = m->in_len;
+		s.next_out = m->out;
+		s.avail_out = m->out_len;
+		r = inflate(&s, Z_FINISH);
+		if (r != Z_STREAM_END || s.avail_out)
+			return -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Inflate all the BGZF members at @src, which must start with one. The
+ * arguments and return value are as for gunzip(). Anything after the
+ * last BGZF member is ignored.
+ */
+static int bgzf_unzip(void *dst, int dstlen, unsigned char *src,
+		      unsigned long *lenp)
+{
+	struct bgzf_job jobs[BGZF_MAX_JOBS];
+	struct mp_job mp_jobs[BGZF_MAX_JOBS];
+	struct bgzf_member *members;
+	unsigned long offset, total;
+	unsigned int size;
+	char *arenas;
+	int count, njobs, per_job, i, ret;
+
+	/* Find the members and where each one's output goes */
+	count = 0;
+	for (offset = 0; bgzf_member_size(src + offset, *lenp - offset);
+	     offset += bgzf_member_size(src + offset, *lenp - offset))
+		count++;
+	members = malloc(count * sizeof(*members));
+	if (!members) {
+		puts("Error: gunzip out of memory\n");
+		return -1;
+	}
+	for (i = 0, offset = 0, total = 0; i < count; i++) {
+		struct bgzf_member *m = &members[i];
+		const unsigned char *trailer;
+
+		size = bgzf_member_size(src + offset, *lenp - offset);
+		trailer = src + offset + size - 4;
+		m->in = src + offset + BGZF_HEADER_SIZE;
+		m->in_len = size - BGZF_HEADER_SIZE - BGZF_TRAILER_SIZE;
+		m->out = dst + total;
+		m->out_len = trailer[0] | trailer[1] << 8 | trailer[2] << 16 |
+			trailer[3] << 24;
+		/* Check each member, so that the total cannot wrap */
+		if (m->out_len > (unsigned long)dstlen - total) {
+			printf("Error: uncompressed data is larger than %d\n",
+			       dstlen);
+			free(members);
+			return -1;
+		}
+		total += m->out_len;
+		offset += size;
+	}
+
+	/* Share the members out between a few jobs, each with an arena */
+	njobs = min(count, BGZF_MAX_JOBS);
+	arenas = malloc(njobs * BGZF_ARENA_SIZE);
+	if (!arenas && njobs > 1) {
+		njobs = 1;
+		arenas = malloc(BGZF_ARENA_SIZE);
+	}
+	if (!arenas) {
+		puts("Error: gunzip out of memory\n");
+		free(members);
+		return -1;
+	}
+	per_job = DIV_ROUND_UP(count, njobs);
+	for (i = 0; i < njobs; i++) {
+		jobs[i].members = members + i * per_job;
+		jobs[i].count = min(per_job, count - i * per_job);
+		jobs[i].arena = arenas + i * BGZF_ARENA_SIZE;
+		jobs[i].arena_used = 0;
+		mp_jobs[i].func = bgzf_job;
+		mp_jobs[i].arg = &jobs[i];
+	}
+
+	/*
+	 * When decompressing in place a member may overwrite ones which
+	 * come later in the input, so they must be done in order.
+	 */
+	if (BGZF_SERIAL ||
+	    ((void *)src < dst + total && dst < (void *)src + *lenp))
+		mp_run_jobs_serial(mp_jobs, njobs);
+	else
+		mp_run_jobs(mp_jobs, njobs);
+
+	ret = 0;
+	for (i = 0; i < njobs; i++) {
+		if (mp_jobs[i].ret) {
+			printf("Error: BGZF member could not be inflated (err=%d)\n",
+			       mp_jobs[i].ret);
+			ret = -1;
+			break;
+		}
+	}
+	free(arenas);
+	free(members);
+	*lenp = total;
+
+	return ret;
+}
+#endif
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int i;
+
+#ifdef CONFIG_GZIP_BGZF
+	if (bgzf_member_size(src, *lenp))
+		return bgzf_unzip(dst, dstlen, src, lenp);
+#endif
+	i = gzip_parse_header(src, *lenp);
+	if (i < 0)
+		return (-1);
+
 	return zunzip(dst, dstlen, src, lenp, 1, i);
 }
 
+int gunzip_stream(void *dst, unsigned long dstlen, gunzip_read_func *read,
+		  void *priv, unsigned long bufsize, unsigned long *lenp)
+{
+	unsigned char *buf;
+	unsigned long offset;
+	z_stream s;
+	int avail, i, r;
+	int err = 0;
+
+	buf = malloc(bufsize);
+	if (!buf) {
+		puts("Error: out of memory\n");
+		return -1;
+	}
+
+	/* The first chunk must hold the complete header */
+	avail = read(priv, buf, 0, bufsize);
+	i = avail > 10 ? gzip_parse_header(buf, avail) : -1;
+	if (i < 0) {
+		free(buf);
+		return -1;
+	}
+	offset = avail;
+
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(buf);
+		return -1;
+	}
+	s.next_in = buf + i;
+	s.avail_in = avail - i;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+
+	/* Refill the input buffer each time inflate() has consumed it */
+	do {
+		if (s.avail_in == 0) {
+			avail = read(priv, buf, offset, bufsize);
+			if (avail <= 0) {
+				puts("Error: gunzip out of data\n");
+				err = -1;
+				break;
+			}
+			offset += avail;
+			s.next_in = buf;
+			s.avail_in = avail;
+		}
+		WATCHDOG_RESET();
+		r = inflate(&s, Z_NO_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			printf("Error: inflate() returned %d\n", r);
+			err = -1;
+			break;
+		}
+		if (r == Z_OK && s.avail_out == 0) {
+			puts("Error: uncompressed data too large\n");
+			err = -1;
+			break;
+		}
+	} while (r != Z_STREAM_END);
+
+	*lenp = s.next_out - (unsigned char *)dst;
+	inflateEnd(&s);
+	free(buf);
+
+	return err;
+}
+
 __weak
 void gzwrite_progress_init(u64 expectedsize)
 {
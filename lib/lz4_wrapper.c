@@ -6,6 +6,9 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <errno.h>
+#include <malloc.h>
+#include <mp_job.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -63,14 +66,131 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
+#ifdef CONFIG_LZ4_PARALLEL
+/**
+ * struct lz4_block_job - one block of a frame, for lz4_block_job()
+ *
+ * @in:		Block data
+ * @size:	Size of block data in bytes
+ * @not_compressed: true if the block is stored rather than compressed
+ * @out:	Where the block's data goes
+ * @out_max:	Space available at @out
+ */
+struct lz4_block_job {
+	const void *in;
+	u32 size;
+	bool not_compressed;
+	void *out;
+	size_t out_max;
+};
+
+/* Decode one block, returning its decompressed size or -ve error */
+static int lz4_block_job(void *arg)
+{
+	struct lz4_block_job *blk = arg;
+	int ret;
+
+	if (blk->not_compressed) {
+		if (blk->size > blk->out_max)
+			return -ENOBUFS;
+		memcpy(blk->out, blk->in, blk->size);
+		return blk->size;
+	}
+
+	ret = LZ4_decompress_generic(blk->in, blk->out, blk->size,
+			blk->out_max, endOnInputSize,
+			full, 0, noDict, blk->out, NULL, 0);
+
+	return ret < 0 ? -EPROTO : ret;
+}
+
+/*
+ * Decode the blocks of a frame at the same time, on all available CPUs.
+ *
+ * A block's decompressed size is only known once it has been decoded,
+ * but every block except the last one normally fills the maximum block
+ * size, so block n is written at n times the maximum block size. If
+ * this turns out to be wrong, or anything else fails, this returns
+ * -EAGAIN and the caller decodes the frame again one block at a time
+ * to get the same result and error as before. That is only possible if
+ * the input is still intact, so in-place decompression (input and
+ * output overlapping) is never done in parallel.
+ */
+static int ulz4fn_parallel(const void *src, size_t srcn, const void *in,
+			   void *dst, size_t *dstn, size_t block_max,
+			   int has_block_checksum)
+{
+	struct lz4_block_job *blks;
+	struct mp_job *jobs;
+	const void *pos;
+	int count, i, ret;
+
+	if (dst < src + srcn && src < dst + *dstn)
+		return -EAGAIN;
+
+	/* Count the blocks, checking that they are all there */
+	for (count = 0, pos = in; ; count++) {
+		struct lz4_block_header b = { .raw = le32_to_cpu(*(u32 *)pos) };
+
+		pos += sizeof(struct lz4_block_header);
+		if (pos - src + b.size > srcn)
+			return -EAGAIN;
+		if (!b.size)
+			break;
+		pos += b.size;
+		if (has_block_checksum)
+			pos += sizeof(u32);
+	}
+	if (count < 2 || (count - 1) * block_max >= *dstn)
+		return -EAGAIN;
+
+	jobs = malloc(count * (sizeof(*jobs) + sizeof(*blks)));
+	if (!jobs)
+		return -EAGAIN;
+	blks = (struct lz4_block_job *)(jobs + count);
+
+	for (i = 0, pos = in; i < count; i++) {
+		struct lz4_block_header b = { .raw = le32_to_cpu(*(u32 *)pos) };
+		struct lz4_block_job *blk = &blks[i];
+
+		pos += sizeof(struct lz4_block_header);
+		blk->in = pos;
+		blk->size = b.size;
+		blk->not_compressed = b.not_compressed;
+		blk->out = dst + i * block_max;
+		blk->out_max = min(block_max, *dstn - i * block_max);
+		jobs[i].func = lz4_block_job;
+		jobs[i].arg = blk;
+		pos += b.size;
+		if (has_block_checksum)
+			pos += sizeof(u32);
+	}
+
+	mp_run_jobs(jobs, count);
+
+	ret = 0;
+	for (i = 0; i < count - 1; i++) {
+		if (jobs[i].ret != block_max)
+			ret = -EAGAIN;
+	}
+	if (jobs[count - 1].ret < 0)
+		ret = -EAGAIN;
+	if (!ret)
+		*dstn = (count - 1) * block_max + jobs[count - 1].ret;
+	free(jobs);
+
+	return ret;
+}
+#endif
+
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
 	int has_block_checksum;
+	size_t block_max __maybe_unused;
 	int ret;
-	*dstn = 0;
 
 	{ /* With in-place decompression the header may become invalid later. */
 		const struct lz4_frame_header *h = in;
@@ -86,6 +206,8 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		if (!h->independent_blocks)
 			return -EPROTONOSUPPORT; /* we can't support this yet */
 		has_block_checksum = h->has_block_checksum;
+		/* 64KiB, 256KiB, 1MiB or 4MiB */
+		block_max = 1 << (2 * h->max_block_size + 8);
 
 		in += sizeof(*h);
 		if (h->has_content_size)
@@ -93,6 +215,14 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		in += sizeof(u8);
 	}
 
+#ifdef CONFIG_LZ4_PARALLEL
+	ret = ulz4fn_parallel(src, srcn, in, dst, dstn, block_max,
+			      has_block_checksum);
+	if (ret != -EAGAIN)
+		return ret;
+#endif
+	*dstn = 0;
+
 	while (1) {
 		struct lz4_block_header b = { .raw = le32_to_cpu(*(u32 *)in) };
 		in += sizeof(struct lz4_block_header);
@@ -0,0 +1,368 @@
+/*
+ * Fast memory test engine
+ *
+ * The region is split into chunks which are filled, and then checked, as
+ * independent jobs on all available CPUs. Filling and checking are
+ * separate passes so that a store which lands in the wrong place (a faulty
+ * address line, say) is seen whichever chunk it hits.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <memtest.h>
+#include <mp_job.h>
+#ifdef CONFIG_X86
+#include <asm/cpu.h>
+#endif
+
+/* Size of the piece of the region handled by one job */
+#define MEMTEST_CHUNK_SIZE	(16 << 20)
+
+/* Words handled per step of the unrolled loops */
+#define MEMTEST_UNROLL		8
+
+enum memtest_kind {
+	MEMTEST_KIND_CONST,
+	MEMTEST_KIND_ADDRESS,
+	MEMTEST_KIND_RANDOM,
+};
+
+static const struct {
+	const char *name;
+	enum memtest_kind kind;
+	ulong val;		/* value, or XOR mask for addresses */
+} memtest_patterns[MEMTEST_PATTERN_COUNT] = {
+	[MEMTEST_ZEROS]		= { "zeros", MEMTEST_KIND_CONST, 0 },
+	[MEMTEST_ONES]		= { "ones", MEMTEST_KIND_CONST, ~0UL },
+	[MEMTEST_CHECKER]	= { "checkerboard", MEMTEST_KIND_CONST,
+				    (ulong)0xaaaaaaaaaaaaaaaaULL },
+	[MEMTEST_INV_CHECKER]	= { "inv-checkerboard", MEMTEST_KIND_CONST,
+				    (ulong)0x5555555555555555ULL },
+	[MEMTEST_ADDRESS]	= { "address", MEMTEST_KIND_ADDRESS, 0 },
+	[MEMTEST_INV_ADDRESS]	= { "inv-address", MEMTEST_KIND_ADDRESS, ~0UL },
+	[MEMTEST_RANDOM]	= { "random", MEMTEST_KIND_RANDOM, 0 },
+};
+
+/**
+ * struct memtest_chunk - one job's share of the region
+ *
+ * @buf:	Start of the chunk
+ * @addr:	Address of @buf as reported to the user
+ * @words:	Number of words in the chunk
+ * @kind:	Kind of pattern
+ * @val:	Pattern value or mask
+ * @seed:	Starting state for MEMTEST_KIND_RANDOM, never 0
+ * @nt:		Use non-temporal (cache-bypassing) stores
+ * @errors:	Number of bad words found
+ * @bad:	First bad word
+ * @found:	Value read from @bad
+ * @expected:	Value expected at @bad
+ */
+struct memtest_chunk {
+	ulong *buf;
+	ulong addr;
+	ulong words;
+	enum memtest_kind kind;
+	ulong val;
+	ulong seed;
+	bool nt;
+
+	ulong errors;
+	ulong *bad;
+	ulong found;
+	ulong expected;
+};
+
+/* One step of a xorshift generator the width of a ulong */
+static inline ulong memtest_next_random(ulong x)
+{
+#if BITS_PER_LONG == 64
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+#else
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+#endif
+	return x;
+}
+
+#ifdef CONFIG_X86
+/*
+ * The stores use movnti from a general register rather than XMM stores.
+ * SSE itself is fine here (the APs get the boot CPU's CR4.OSFXSR from
+ * mp_init() and nothing needs to save XMM state, as U-Boot never switches
+ * tasks), but a word-wide non-temporal store already runs at the speed of
+ * memory, and movnti only needs CPUID.SSE2, not CR4.OSFXSR, so it also
+ * works where whoever set up the CPU left SSE disabled.
+ */
+static bool memtest_nt_usable(void)
+{
+	return cpuid_edx(1) & (1 << 26);
+}
+
+static inline void memtest_store(ulong *p, ulong val, bool nt)
+{
+	if (nt)
+		asm volatile("movnti %1, %0" : "=m" (*p) : "r" (val));
+	else
+		*p = val;
+}
+
+static inline void memtest_store_done(bool nt)
+{
+	if (nt)
+		asm volatile("sfence" : : : "memory");
+}
+
+static void memtest_fill_const(ulong *buf, ulong words, ulong val, bool nt)
+{
+	/* Fast string stores avoid reading each line in before writing it */
+#ifdef __x86_64__
+	asm volatile("rep stosq" : "+D" (buf), "+c" (words) : "a" (val)
+		     : "memory");
+#else
+	asm volatile("rep stosl" : "+D" (buf), "+c" (words) : "a" (val)
+		     : "memory");
+#endif
+}
+#else
+static bool memtest_nt_usable(void)
+{
+	return false;
+}
+
+static inline void memtest_store(ulong *p, ulong val, bool nt)
+{
+	*p = val;
+}
+
+static inline void memtest_store_done(bool nt)
+{
+}
+
+static void memtest_fill_const(ulong *buf, ulong words, ulong val, bool nt)
+{
+	vu_long *p = buf;
+	ulong i;
+
+	for (i = 0; i + MEMTEST_UNROLL <= words; i += MEMTEST_UNROLL) {
+		p[i] = val;
+		p[i + 1] = val;
+		p[i + 2] = val;
+		p[i + 3] = val;
+		p[i + 4] = val;
+		p[i + 5] = val;
+		p[i + 6] = val;
+		p[i + 7] = val;
+	}
+	for (; i < words; i++)
+		p[i] = val;
+}
+#endif
+
+static int memtest_fill_job(void *arg)
+{
+	struct memtest_chunk *chunk = arg;
+	ulong *p = chunk->buf;
+	bool nt = chunk->nt;
+	ulong val, i;
+
+	switch (chunk->kind) {
+	case MEMTEST_KIND_CONST:
+		memtest_fill_const(p, chunk->words, chunk->val, nt);
+		break;
+	case MEMTEST_KIND_ADDRESS:
+		val = chunk->addr;
+		for (i = 0; i < chunk->words; i++) {
+			memtest_store(&p[i], val ^ chunk->val, nt);
+			val += sizeof(ulong);
+		}
+		break;
+	case MEMTEST_KIND_RANDOM:
+		val = chunk->seed;
+		for (i = 0; i < chunk->words; i++) {
+			val = memtest_next_random(val);
+			memtest_store(&p[i], val, nt);
+		}
+		break;
+	}
+	memtest_store_done(nt);
+
+	return 0;
+}
+
+static void memtest_bad_word(struct memtest_chunk *chunk, ulong *p,
+			     ulong expected)
+{
+	if (!chunk->errors++) {
+		chunk->bad = p;
+		chunk->found = *(vu_long *)p;
+		chunk->expected = expected;
+	}
+}
+
+static int memtest_check_job(void *arg)
+{
+	struct memtest_chunk *chunk = arg;
+	const vu_long *p = chunk->buf;
+	ulong words = chunk->words;
+	ulong val, diff, i, j;
+
+	switch (chunk->kind) {
+	case MEMTEST_KIND_CONST:
+		val = chunk->val;
+		for (i = 0; i + MEMTEST_UNROLL <= words; i += MEMTEST_UNROLL) {
+			diff = (p[i] ^ val) | (p[i + 1] ^ val) |
+				(p[i + 2] ^ val) | (p[i + 3] ^ val) |
+				(p[i + 4] ^ val) | (p[i + 5] ^ val) |
+				(p[i + 6] ^ val) | (p[i + 7] ^ val);
+			if (!diff)
+				continue;
+			for (j = i; j < i + MEMTEST_UNROLL; j++) {
+				if (p[j] != val)
+					memtest_bad_word(chunk,
+							 (ulong *)&p[j], val);
+			}
+		}
+		for (; i < words; i++) {
+			if (p[i] != val)
+				memtest_bad_word(chunk, (ulong *)&p[i], val);
+		}
+		break;
+	case MEMTEST_KIND_ADDRESS:
+		val = chunk->addr;
+		for (i = 0; i < words; i++) {
+			if (p[i] != (val ^ chunk->val))
+				memtest_bad_word(chunk, (ulong *)&p[i],
+						 val ^ chunk->val);
+			val += sizeof(ulong);
+		}
+		break;
+	case MEMTEST_KIND_RANDOM:
+		val = chunk->seed;
+		for (i = 0; i < words; i++) {
+			val = memtest_next_random(val);
+			if (p[i] != val)
+				memtest_bad_word(chunk, (ulong *)&p[i], val);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+const char *memtest_pattern_name(int pattern)
+{
+	if (pattern < 0 || pattern >= MEMTEST_PATTERN_COUNT)
+		return NULL;
+
+	return memtest_patterns[pattern].name;
+}
+
+/*
+ * Split the region into chunks and run @func on each of them, returning
+ * the time taken in microseconds. The chunks are left in *chunksp so that
+ * the caller can collect the results; it must free them.
+ */
+static int memtest_run_jobs(struct memtest_run *run, int pattern,
+			    int (*func)(void *arg),
+			    struct memtest_chunk **chunksp, int *countp,
+			    ulong *usp)
+{
+	ulong words = run->size / sizeof(ulong);
+	ulong chunk_words = MEMTEST_CHUNK_SIZE / sizeof(ulong);
+	struct memtest_chunk *chunks;
+	struct mp_job *jobs;
+	bool nt = memtest_nt_usable();
+	ulong start;
+	int count, i;
+
+	if (pattern < 0 || pattern >= MEMTEST_PATTERN_COUNT)
+		return -EINVAL;
+
+	count = DIV_ROUND_UP(words, chunk_words);
+	if (!count)
+		count = 1;
+	chunks = calloc(count, sizeof(*chunks));
+	jobs = calloc(count, sizeof(*jobs));
+	if (!chunks || !jobs) {
+		free(chunks);
+		free(jobs);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct memtest_chunk *chunk = &chunks[i];
+		ulong offset = i * chunk_words;
+
+		chunk->buf = (ulong *)run->buf + offset;
+		chunk->addr = run->addr + offset * sizeof(ulong);
+		chunk->words = min(chunk_words, words - offset);
+		chunk->kind = memtest_patterns[pattern].kind;
+		chunk->val = memtest_patterns[pattern].val;
+		chunk->seed = run->seed ^ (offset * 0x9e3779b9UL);
+		if (!chunk->seed)
+			chunk->seed = 1;
+		chunk->nt = nt;
+		jobs[i].func = func;
+		jobs[i].arg = chunk;
+	}
+
+	start = timer_get_us();
+	mp_run_jobs(jobs, count);
+	*usp = timer_get_us() - start;
+	free(jobs);
+
+	*chunksp = chunks;
+	*countp = count;
+
+	return 0;
+}
+
+int memtest_fill(struct memtest_run *run, int pattern)
+{
+	struct memtest_chunk *chunks;
+	int count, ret;
+
+	ret = memtest_run_jobs(run, pattern, memtest_fill_job, &chunks,
+			       &count, &run->fill_us);
+	if (ret)
+		return ret;
+	free(chunks);
+
+	return 0;
+}
+
+int memtest_check(struct memtest_run *run, int pattern)
+{
+	struct memtest_chunk *chunks;
+	int count, ret, i;
+
+	ret = memtest_run_jobs(run, pattern, memtest_check_job, &chunks,
+			       &count, &run->check_us);
+	if (ret)
+		return ret;
+
+	run->errors = 0;
+	for (i = 0; i < count; i++) {
+		struct memtest_chunk *chunk = &chunks[i];
+
+		if (!chunk->errors)
+			continue;
+		if (!run->errors) {
+			run->bad_addr = chunk->addr + (chunk->bad - chunk->buf) *
+				sizeof(ulong);
+			run->found = chunk->found;
+			run->expected = chunk->expected;
+		}
+		run->errors += chunk->errors;
+	}
+	free(chunks);
+
+	return run->errors ? -EIO : 0;
+}
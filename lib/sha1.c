@@ -31,6 +31,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <errno.h>
 #include <linux/string.h>
 #else
 #include <string.h>
@@ -227,6 +228,45 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	ctx->state[4] += E;
 }
 
+#ifndef USE_HOSTCC
+__weak int sha1_arch_process(uint32_t state[5], const uint8_t *data,
+			     unsigned int blocks)
+{
+	return -ENOSYS;
+}
+
+/* The context keeps the state in unsigned longs, which may be 64-bit */
+static int sha1_arch_blocks(sha1_context *ctx, const unsigned char *data,
+			    unsigned int blocks)
+{
+	uint32_t state[5];
+	int i, ret;
+
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	ret = sha1_arch_process(state, data, blocks);
+	if (ret)
+		return ret;
+	for (i = 0; i < 5; i++)
+		ctx->state[i] = state[i];
+
+	return 0;
+}
+#endif
+
+static void sha1_process_blocks(sha1_context *ctx, const unsigned char *data,
+				unsigned int blocks)
+{
+#ifndef USE_HOSTCC
+	if (!sha1_arch_blocks(ctx, data, blocks))
+		return;
+#endif
+	while (blocks--) {
+		sha1_process(ctx, data);
+		data += 64;
+	}
+}
+
 /*
  * SHA-1 process buffer
  */
@@ -250,16 +290,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		sha1_process_blocks(ctx, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		sha1_process_blocks(ctx, input, ilen / 64);
+		input += ilen & ~0x3F;
+		ilen &= 0x3F;
 	}
 
 	if (ilen > 0) {
@@ -8,6 +8,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <errno.h>
 #include <linux/string.h>
 #else
 #include <string.h>
@@ -181,6 +182,27 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	ctx->state[7] += H;
 }
 
+#ifndef USE_HOSTCC
+__weak int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+			       unsigned int blocks)
+{
+	return -ENOSYS;
+}
+#endif
+
+static void sha256_process_blocks(sha256_context *ctx, const uint8_t *data,
+				  unsigned int blocks)
+{
+#ifndef USE_HOSTCC
+	if (!sha256_arch_process(ctx->state, data, blocks))
+		return;
+#endif
+	while (blocks--) {
+		sha256_process(ctx, data);
+		data += 64;
+	}
+}
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -199,16 +221,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		sha256_process_blocks(ctx, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		sha256_process_blocks(ctx, input, length / 64);
+		input += length & ~0x3F;
+		length &= 0x3F;
 	}
 
 	if (length)
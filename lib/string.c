@@ -539,12 +539,29 @@ void * memmove(void * dest,const void *src,size_t count)
 	if (dest <= src) {
 		tmp = (char *) dest;
 		s = (char *) src;
+		/* when both are aligned, move a word at a time */
+		if ((((ulong)tmp | (ulong)s) & (sizeof(ulong) - 1)) == 0) {
+			while (count >= sizeof(ulong)) {
+				*(ulong *)tmp = *(ulong *)s;
+				tmp += sizeof(ulong);
+				s += sizeof(ulong);
+				count -= sizeof(ulong);
+			}
+		}
 		while (count--)
 			*tmp++ = *s++;
 		}
 	else {
 		tmp = (char *) dest + count;
 		s = (char *) src + count;
+		if ((((ulong)tmp | (ulong)s) & (sizeof(ulong) - 1)) == 0) {
+			while (count >= sizeof(ulong)) {
+				tmp -= sizeof(ulong);
+				s -= sizeof(ulong);
+				*(ulong *)tmp = *(ulong *)s;
+				count -= sizeof(ulong);
+			}
+		}
 		while (count--)
 			*--tmp = *--s;
 		}
@@ -150,6 +150,9 @@ void udelay(unsigned long usec)
 	do {
 		WATCHDOG_RESET();
 		kv = usec > CONFIG_WD_PERIOD ? CONFIG_WD_PERIOD : usec;
+		/* Keep the UART busy while waiting if output is buffered */
+		if (serial_poll_tx() && kv > 100)
+			kv = 100;
 		__udelay (kv);
 		usec -= kv;
 	} while(usec);
@@ -866,6 +866,7 @@ static void panic_finish(void) __attribute__ ((noreturn));
 static void panic_finish(void)
 {
 	putc('\n');
+	serial_flush();
 #if defined(CONFIG_PANIC_HANG)
 	hang();
 #else
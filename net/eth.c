@@ -427,6 +427,41 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+#ifdef CONFIG_NET_RX_PLACE
+struct net_rx_target net_rx_target;
+
+void net_set_rx_target(void *buf, int hdr_len, int len,
+		       int (*match)(uchar *pkt, int len))
+{
+	net_rx_target.buf = buf;
+	net_rx_target.hdr_len = hdr_len;
+	net_rx_target.len = len;
+	net_rx_target.match = match;
+	net_rx_target.placed = 0;
+}
+
+/*
+ * If the driver put the payload of a packet straight into the target but
+ * it is not the packet the protocol expects, put the payload back where
+ * everything else will look for it
+ */
+static void eth_rx_check_placed(uchar *packet, int length)
+{
+	struct net_rx_target *target = &net_rx_target;
+
+	if (!target->placed)
+		return;
+	if (target->match && target->match(packet, length))
+		return;
+	memcpy(packet + target->hdr_len, target->buf, target->placed);
+	target->placed = 0;
+}
+#else
+static inline void eth_rx_check_placed(uchar *packet, int length)
+{
+}
+#endif
+
 int eth_rx(void)
 {
 	struct udevice *current;
@@ -445,10 +480,15 @@ int eth_rx(void)
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < 32; i++) {
+#ifdef CONFIG_NET_RX_PLACE
+		net_rx_target.placed = 0;
+#endif
 		ret = eth_get_ops(current)->recv(current, flags, &packet);
 		flags = 0;
-		if (ret > 0)
+		if (ret > 0) {
+			eth_rx_check_placed(packet, ret);
 			net_process_received_packet(packet, ret);
+		}
 		if (ret >= 0 && eth_get_ops(current)->free_pkt)
 			eth_get_ops(current)->free_pkt(current, packet, ret);
 		if (ret <= 0)
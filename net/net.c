@@ -352,6 +352,7 @@ static void net_clear_handlers(void)
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
 	net_set_timeout_handler(0, NULL);
+	net_set_rx_target(NULL, 0, 0, NULL);
 }
 
 static void net_cleanup_loop(void)
@@ -400,6 +401,7 @@ int net_loop(enum proto_t protocol)
 	debug_cond(DEBUG_INT_STATE, "--- net_loop Entry\n");
 
 	bootstage_mark_name(BOOTSTAGE_ID_ETH_START, "eth_start");
+	bootstage_start(BOOTSTAGE_ID_ACCUM_NET, "net");
 	net_init();
 	if (eth_is_on_demand_init() || protocol != NETCONS) {
 		eth_halt();
@@ -407,7 +409,7 @@ int net_loop(enum proto_t protocol)
 		ret = eth_init();
 		if (ret < 0) {
 			eth_halt();
-			return ret;
+			goto done;
 		}
 	} else {
 		eth_init_state_only();
@@ -430,7 +432,8 @@ restart:
 	case 1:
 		/* network not configured */
 		eth_halt();
-		return -ENODEV;
+		ret = -ENODEV;
+		goto done;
 
 	case 2:
 		/* network device not configured */
@@ -625,6 +628,8 @@ restart:
 			eth_set_last_protocol(protocol);
 
 			ret = net_boot_file_size;
+			bootstage_add_bytes(BOOTSTAGE_ID_ACCUM_NET,
+					    net_boot_file_size);
 			debug_cond(DEBUG_INT_STATE, "--- net_loop Success!\n");
 			goto done;
 
@@ -641,6 +646,7 @@ restart:
 	}
 
 done:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_NET);
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
@@ -831,11 +837,8 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
  * to the algorithm in RFC815. It returns NULL or the pointer to
  * a complete packet, in static storage
  */
-#ifndef CONFIG_NET_MAXDEFRAG
-#define CONFIG_NET_MAXDEFRAG 16384
-#endif
 /*
- * MAXDEFRAG, above, is chosen in the config file and  is real data
+ * CONFIG_NET_MAXDEFRAG is chosen in the config file and is real data
  * so we need to add the NFS overhead, which is more than TFTP.
  * To use sizeof in the internal unnamed structures, we need a real
  * instance (can't do "sizeof(struct rpc_t.u.reply))", unfortunately).
@@ -1032,6 +1035,22 @@ static void receive_icmp(struct ip_udp_hdr *ip, int len,
 	}
 }
 
+#ifdef CONFIG_UDP_CHECKSUM
+/*
+ * Add @sumlen bytes at @sumptr to a UDP checksum, as big-endian 16-bit
+ * words. A placed payload may not be aligned, so read it a byte at a time.
+ */
+static ulong udp_xsum_add(ulong xsum, const uchar *sumptr, ushort sumlen)
+{
+	for (; sumlen > 1; sumptr += 2, sumlen -= 2)
+		xsum += sumptr[0] << 8 | sumptr[1];
+	if (sumlen > 0)
+		xsum += sumptr[0] << 8;
+
+	return xsum;
+}
+#endif
+
 void net_process_received_packet(uchar *in_packet, int len)
 {
 	struct ethernet_hdr *et;
@@ -1225,7 +1244,7 @@ void net_process_received_packet(uchar *in_packet, int len)
 #ifdef CONFIG_UDP_CHECKSUM
 		if (ip->udp_xsum != 0) {
 			ulong   xsum;
-			ushort *sumptr;
+			uchar  *sumptr;
 			ushort  sumlen;
 
 			xsum  = ip->ip_p;
@@ -1236,22 +1255,26 @@ void net_process_received_packet(uchar *in_packet, int len)
 			xsum += (ntohl(ip->ip_dst.s_addr) >>  0) & 0x0000ffff;
 
 			sumlen = ntohs(ip->udp_len);
-			sumptr = (ushort *)&(ip->udp_src);
-
-			while (sumlen > 1) {
-				ushort sumdata;
-
-				sumdata = *sumptr++;
-				xsum += ntohs(sumdata);
-				sumlen -= 2;
-			}
-			if (sumlen > 0) {
-				ushort sumdata;
+			sumptr = (uchar *)&(ip->udp_src);
 
-				sumdata = *(unsigned char *)sumptr;
-				sumdata = (sumdata << 8) & 0xff00;
-				xsum += sumdata;
+#ifdef CONFIG_NET_RX_PLACE
+			/*
+			 * The driver put the payload straight into place. Sum
+			 * the headers left in the packet, then the payload.
+			 */
+			if (net_rx_target.placed) {
+				ushort hdrlen = (uchar *)et +
+					net_rx_target.hdr_len - sumptr;
+
+				if (sumlen != hdrlen + net_rx_target.placed ||
+				    hdrlen & 1)
+					return;
+				xsum = udp_xsum_add(xsum, sumptr, hdrlen);
+				sumptr = net_rx_target.buf;
+				sumlen -= hdrlen;
 			}
+#endif
+			xsum = udp_xsum_add(xsum, sumptr, sumlen);
 			while ((xsum >> 16) != 0) {
 				xsum = (xsum & 0x0000ffff) +
 				       ((xsum >> 16) & 0x0000ffff);
@@ -38,17 +38,48 @@
 # define NFS_TIMEOUT CONFIG_NFS_TIMEOUT
 #endif
 
+#ifndef CONFIG_NFS_READ_WINDOW
+# define NFS_READ_WINDOW 4
+#else
+# define NFS_READ_WINDOW CONFIG_NFS_READ_WINDOW
+#endif
+
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+#define NFS_SIZE_UNKNOWN	(~0ULL)
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
+static int nfs_version;
 
-static char dirfh[NFS_FHSIZE];	/* file handle of directory */
-static char filefh[NFS_FHSIZE]; /* file handle of kernel image */
+static char dirfh[NFS3_FHSIZE];	/* file handle of directory */
+static int dirfh_len;
+static char filefh[NFS3_FHSIZE]; /* file handle of kernel image */
+static int filefh_len;
+
+/**
+ * struct nfs_read_slot - a READ request which has been sent to the server
+ *
+ * @busy:	true if we are waiting for a reply to this request
+ * @xid:	RPC transaction ID of the request, used to match the reply
+ * @offset:	File offset requested
+ * @len:	Number of bytes requested
+ */
+struct nfs_read_slot {
+	bool busy;
+	uint32_t xid;
+	u64 offset;
+	uint len;
+};
+
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW];
+static u64 nfs_read_next;	/* offset of the next READ request */
+static u64 nfs_file_size;	/* file size, or NFS_SIZE_UNKNOWN */
+static uint nfs_rsize;		/* bytes to ask for in each READ request */
+static ulong nfs_progress;	/* bytes received since the last hash */
+static int nfs_hashes;		/* hashes printed on this line */
 
 static enum net_loop_state nfs_download_state;
 static struct in_addr nfs_server_ip;
@@ -64,13 +95,14 @@ static int nfs_state;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char default_filename[64];
 static char *nfs_filename;
 static char *nfs_path;
 static char nfs_path_buff[2048];
 
-static inline int store_block(uchar *src, unsigned offset, unsigned len)
+static inline int store_block(uchar *src, ulong offset, unsigned len)
 {
 	ulong newsize = offset + len;
 #ifdef CONFIG_SYS_DIRECT_FLASH_NFS
@@ -132,7 +164,7 @@ static char *dirname(char *path)
 /**************************************************************************
 RPC_ADD_CREDENTIALS - Add RPC authentication/verifier entries
 **************************************************************************/
-static long *rpc_add_credentials(long *p)
+static uint32_t *rpc_add_credentials(uint32_t *p)
 {
 	int hl;
 	int hostnamelen;
@@ -173,22 +205,39 @@ static long *rpc_add_credentials(long *p)
 }
 
 /**************************************************************************
-RPC_LOOKUP - Lookup RPC Port numbers
+RPC_ADD_FH - Add a file handle in the format used by this NFS version
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static uint32_t *rpc_add_fh(uint32_t *p, const char *fh, int fhlen)
+{
+	if (nfs_version == 3)
+		*p++ = htonl(fhlen);
+	if (fhlen & 3)
+		*(p + fhlen / 4) = 0;
+	memcpy(p, fh, fhlen);
+
+	return p + (fhlen + 3) / 4;
+}
+
+/**************************************************************************
+RPC_SEND - Send an RPC call with a given transaction ID
+**************************************************************************/
+static void rpc_send(uint32_t id, int rpc_prog, int rpc_proc, uint32_t *data,
+		     int datalen)
 {
 	struct rpc_t pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	pkt.u.call.id = htonl(id);
 	pkt.u.call.type = htonl(MSG_CALL);
 	pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
 	pkt.u.call.prog = htonl(rpc_prog);
-	pkt.u.call.vers = htonl(2);	/* portmapper is version 2 */
+	/* portmapper is version 2, mount and NFS follow the NFS version */
+	if (rpc_prog == PROG_PORTMAP || nfs_version == 2)
+		pkt.u.call.vers = htonl(2);
+	else
+		pkt.u.call.vers = htonl(3);
 	pkt.u.call.proc = htonl(rpc_proc);
 	p = (uint32_t *)&(pkt.u.call.data);
 
@@ -211,6 +260,14 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+/**************************************************************************
+RPC_REQ - Send an RPC call with a new transaction ID
+**************************************************************************/
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_send(++rpc_id, rpc_prog, rpc_proc, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -241,7 +298,7 @@ static void nfs_mount_req(char *path)
 	pathlen = strlen(path);
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
 	*p++ = htonl(pathlen);
 	if (pathlen & 3)
@@ -268,7 +325,7 @@ static void nfs_umountall_req(void)
 		return;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
@@ -289,14 +346,14 @@ static void nfs_readlink_req(void)
 	int len;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, filefh, filefh_len);
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READLINK, data, len);
+	rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_READLINK : NFS_READLINK,
+		data, len);
 }
 
 /**************************************************************************
@@ -312,10 +369,9 @@ static void nfs_lookup_req(char *fname)
 	fnamelen = strlen(fname);
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, dirfh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
+	p = rpc_add_fh(p, dirfh, dirfh_len);
 	*p++ = htonl(fnamelen);
 	if (fnamelen & 3)
 		*(p + fnamelen / 4) = 0;
@@ -324,30 +380,122 @@ static void nfs_lookup_req(char *fname)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_LOOKUP, data, len);
+	rpc_req(PROG_NFS, nfs_version == 3 ? NFS3PROC_LOOKUP : NFS_LOOKUP,
+		data, len);
+}
+
+/**************************************************************************
+NFS_FSINFO - Ask an NFSv3 server for its preferred transfer sizes
+**************************************************************************/
+static void nfs_fsinfo_req(void)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = rpc_add_fh(p, dirfh, dirfh_len);
+
+	len = (uint32_t *)p - (uint32_t *)&(data[0]);
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
 }
 
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read_slot *slot)
 {
 	uint32_t data[1024];
 	uint32_t *p;
 	int len;
 
 	p = &(data[0]);
-	p = (uint32_t *)rpc_add_credentials((long *)p);
+	p = rpc_add_credentials(p);
 
-	memcpy(p, filefh, NFS_FHSIZE);
-	p += (NFS_FHSIZE / 4);
-	*p++ = htonl(offset);
-	*p++ = htonl(readlen);
-	*p++ = 0;
+	p = rpc_add_fh(p, filefh, filefh_len);
+	if (nfs_version == 3) {
+		*p++ = htonl(upper_32_bits(slot->offset));
+		*p++ = htonl(lower_32_bits(slot->offset));
+		*p++ = htonl(slot->len);
+	} else {
+		*p++ = htonl(slot->offset);
+		*p++ = htonl(slot->len);
+		*p++ = 0;
+	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	rpc_send(slot->xid, PROG_NFS,
+		 nfs_version == 3 ? NFS3PROC_READ : NFS_READ, data, len);
+}
+
+/*
+ * Send READ requests for the next parts of the file until the window is
+ * full. Until we know how big the file is, only one request is sent.
+ */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+	int busy = 0;
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++)
+		busy += nfs_read_slots[i].busy;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		slot = &nfs_read_slots[i];
+		if (slot->busy)
+			continue;
+		if (nfs_read_next >= nfs_file_size)
+			break;
+		if (nfs_file_size == NFS_SIZE_UNKNOWN && busy)
+			break;
+		slot->busy = true;
+		slot->xid = ++rpc_id;
+		slot->offset = nfs_read_next;
+		slot->len = min_t(u64, nfs_rsize, nfs_file_size - nfs_read_next);
+		nfs_read_next += slot->len;
+		busy++;
+		nfs_read_req(slot);
+	}
+}
+
+/* Send all outstanding READ requests again, with the same IDs */
+static void nfs_read_retransmit(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (nfs_read_slots[i].busy)
+			nfs_read_req(&nfs_read_slots[i]);
+	}
+}
+
+static void nfs_read_start(void)
+{
+	memset(nfs_read_slots, '\0', sizeof(nfs_read_slots));
+	nfs_read_next = 0;
+	nfs_progress = 0;
+	nfs_hashes = 0;
+	/* Always send one request, so that we see the end of an empty file */
+	if (!nfs_file_size)
+		nfs_file_size = NFS_SIZE_UNKNOWN;
+	nfs_read_fill();
+}
+
+static bool nfs_read_done(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (nfs_read_slots[i].busy)
+			return false;
+	}
+
+	return nfs_read_next >= nfs_file_size;
 }
 
 /**************************************************************************
@@ -359,10 +507,10 @@ static void nfs_send(void)
 
 	switch (nfs_state) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
-		rpc_lookup_req(PROG_MOUNT, 1);
+		rpc_lookup_req(PROG_MOUNT, nfs_version == 3 ? 3 : 1);
 		break;
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
-		rpc_lookup_req(PROG_NFS, 2);
+		rpc_lookup_req(PROG_NFS, nfs_version);
 		break;
 	case STATE_MOUNT_REQ:
 		nfs_mount_req(nfs_path);
@@ -374,11 +522,14 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_retransmit();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
 		break;
+	case STATE_FSINFO_REQ:
+		nfs_fsinfo_req();
+		break;
 	}
 }
 
@@ -386,24 +537,84 @@ static void nfs_send(void)
 Handlers for the reply from server
 **************************************************************************/
 
-static int rpc_lookup_reply(int prog, uchar *pkt, unsigned len)
+/*
+ * Copy a reply into @rpc_pkt and check that it answers our last request and
+ * that the RPC call was accepted.
+ */
+static int rpc_check_reply(struct rpc_t *rpc_pkt, uchar *pkt, unsigned len)
 {
-	struct rpc_t rpc_pkt;
+	memcpy((unsigned char *)rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt->u.data)));
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
-
-	debug("%s\n", __func__);
-
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
+	if (ntohl(rpc_pkt->u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	else if (ntohl(rpc_pkt->u.reply.id) < rpc_id)
 		return -NFS_RPC_DROP;
 
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus)
+	if (rpc_pkt->u.reply.rstatus  ||
+	    rpc_pkt->u.reply.verifier ||
+	    rpc_pkt->u.reply.astatus)
 		return -1;
 
+	return 0;
+}
+
+/* Return the end of the part of a @len byte reply held in @rpc_pkt */
+static uchar *rpc_reply_end(struct rpc_t *rpc_pkt, unsigned len)
+{
+	return rpc_pkt->u.data + min_t(unsigned, len, sizeof(rpc_pkt->u.data));
+}
+
+/*
+ * Read a file handle from a reply ending at @end, returning a pointer to the
+ * next word, or NULL if the handle is too long or runs past @end
+ */
+static uint32_t *nfs_get_fh(uint32_t *p, const uchar *end, char *fh,
+			    int *fhlen)
+{
+	u32 len = NFS_FHSIZE;
+
+	if (nfs_version == 3) {
+		if ((uchar *)(p + 1) > end)
+			return NULL;
+		len = ntohl(*p++);
+		if (len > NFS3_FHSIZE)
+			return NULL;
+	}
+	if ((uchar *)p > end || end - (uchar *)p < len)
+		return NULL;
+	memcpy(fh, p, len);
+	*fhlen = len;
+
+	return p + (len + 3) / 4;
+}
+
+/* Read the file size from a v2 fattr or a v3 post_op_attr, if present */
+static uint32_t *nfs_get_attr_size(uint32_t *p, u64 *sizep)
+{
+	if (nfs_version == 2) {
+		*sizep = ntohl(p[5]);
+		return p + NFS_FATTR_WORDS;
+	}
+
+	if (!ntohl(*p++))
+		return p;
+	*sizep = (u64)ntohl(p[5]) << 32 | ntohl(p[6]);
+
+	return p + NFS3_FATTR_WORDS;
+}
+
+static int rpc_lookup_reply(int prog, uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	int ret;
+
+	debug("%s\n", __func__);
+
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
+
 	switch (prog) {
 	case PROG_MOUNT:
 		nfs_server_mount_port = ntohl(rpc_pkt.u.reply.data[0]);
@@ -419,24 +630,20 @@ static int rpc_lookup_reply(int prog, uchar *pkt, unsigned len)
 static int nfs_mount_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	int ret;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
-
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
-
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus  ||
-	    rpc_pkt.u.reply.data[0])
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
+	if (rpc_pkt.u.reply.data[0])
 		return -1;
 
+	if (!nfs_get_fh(rpc_pkt.u.reply.data + 1, rpc_reply_end(&rpc_pkt, len),
+			dirfh, &dirfh_len))
+		return -1;
 	fs_mounted = 1;
-	memcpy(dirfh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
 
 	return 0;
 }
@@ -444,20 +651,13 @@ static int nfs_mount_reply(uchar *pkt, unsigned len)
 static int nfs_umountall_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	int ret;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
-
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
-
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus)
-		return -1;
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
 
 	fs_mounted = 0;
 	memset(dirfh, 0, sizeof(dirfh));
@@ -465,26 +665,57 @@ static int nfs_umountall_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_lookup_reply(uchar *pkt, unsigned len)
+static int nfs_fsinfo_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint rtmax, rtpref;
+	uint32_t *p;
+	u64 size;
+	int ret;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
+	if (rpc_pkt.u.reply.data[0])
+		return -1;
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
+	p = nfs_get_attr_size(rpc_pkt.u.reply.data + 1, &size);
+	rtmax = ntohl(p[0]);
+	rtpref = ntohl(p[1]);
 
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus  ||
-	    rpc_pkt.u.reply.data[0])
+	nfs_rsize = min_t(uint, rtmax, NFS3_READ_MAX);
+	if (rtpref && rtpref < nfs_rsize)
+		nfs_rsize = rtpref;
+	if (!nfs_rsize)
+		nfs_rsize = NFS_READ_SIZE;
+	debug("NFS read size %u (server max %u, preferred %u)\n", nfs_rsize,
+	      rtmax, rtpref);
+
+	return 0;
+}
+
+static int nfs_lookup_reply(uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	uint32_t *p;
+	int ret;
+
+	debug("%s\n", __func__);
+
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
+	if (rpc_pkt.u.reply.data[0])
 		return -1;
 
-	memcpy(filefh, rpc_pkt.u.reply.data + 1, NFS_FHSIZE);
+	p = nfs_get_fh(rpc_pkt.u.reply.data + 1, rpc_reply_end(&rpc_pkt, len),
+		       filefh, &filefh_len);
+	if (!p)
+		return -1;
+	nfs_file_size = NFS_SIZE_UNKNOWN;
+	nfs_get_attr_size(p, &nfs_file_size);
 
 	return 0;
 }
@@ -492,51 +723,83 @@ static int nfs_lookup_reply(uchar *pkt, unsigned len)
 static int nfs_readlink_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
+	uint32_t *p;
+	u64 size;
 	int rlen;
+	int ret;
 
 	debug("%s\n", __func__);
 
-	memcpy((unsigned char *)&rpc_pkt, pkt, len);
-
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
-
-	if (rpc_pkt.u.reply.rstatus  ||
-	    rpc_pkt.u.reply.verifier ||
-	    rpc_pkt.u.reply.astatus  ||
-	    rpc_pkt.u.reply.data[0])
+	ret = rpc_check_reply(&rpc_pkt, pkt, len);
+	if (ret)
+		return ret;
+	if (rpc_pkt.u.reply.data[0])
 		return -1;
 
-	rlen = ntohl(rpc_pkt.u.reply.data[1]); /* new path length */
+	p = rpc_pkt.u.reply.data + 1;
+	if (nfs_version == 3)
+		p = nfs_get_attr_size(p, &size);
+	rlen = ntohl(*p++); /* new path length */
+	if ((uchar *)p + rlen > rpc_pkt.u.data + sizeof(rpc_pkt.u.data) ||
+	    strlen(nfs_path) + rlen + 2 > sizeof(nfs_path_buff))
+		return -1;
 
-	if (*((char *)&(rpc_pkt.u.reply.data[2])) != '/') {
+	if (*((char *)p) != '/') {
 		int pathlen;
 		strcat(nfs_path, "/");
 		pathlen = strlen(nfs_path);
-		memcpy(nfs_path + pathlen, (uchar *)&(rpc_pkt.u.reply.data[2]),
-		       rlen);
+		memcpy(nfs_path + pathlen, (uchar *)p, rlen);
 		nfs_path[pathlen + rlen] = 0;
 	} else {
-		memcpy(nfs_path, (uchar *)&(rpc_pkt.u.reply.data[2]), rlen);
+		memcpy(nfs_path, (uchar *)p, rlen);
 		nfs_path[rlen] = 0;
 	}
 	return 0;
 }
 
+static void nfs_show_progress(uint len)
+{
+	ulong step = nfs_rsize / 2 * 10;
+
+	for (nfs_progress += len; nfs_progress >= step; nfs_progress -= step) {
+		if (nfs_hashes == HASHES_PER_LINE) {
+			puts("\n\t ");
+			nfs_hashes = 0;
+		}
+		putc('#');
+		nfs_hashes++;
+	}
+}
+
+/*
+ * Handle the reply to one of the outstanding READ requests. The data is
+ * stored at its place in the file, so replies can arrive in any order. A
+ * short read which is not at the end of the file is asked for again.
+ */
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
+	struct nfs_read_slot *slot = NULL;
 	struct rpc_t rpc_pkt;
+	uint32_t *p;
+	uchar *data;
+	uint32_t xid;
+	bool eof;
 	int rlen;
+	int i;
 
 	debug("%s\n", __func__);
 
-	memcpy((uchar *)&rpc_pkt, pkt, sizeof(rpc_pkt.u.reply));
+	memcpy((uchar *)&rpc_pkt, pkt,
+	       min_t(unsigned, len, sizeof(rpc_pkt.u.reply)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	xid = ntohl(rpc_pkt.u.reply.id);
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (nfs_read_slots[i].busy && nfs_read_slots[i].xid == xid) {
+			slot = &nfs_read_slots[i];
+			break;
+		}
+	}
+	if (!slot)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -550,16 +813,32 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
+	p = nfs_get_attr_size(rpc_pkt.u.reply.data + 1, &nfs_file_size);
+	if (nfs_version == 3) {
+		p++;			/* count */
+		eof = ntohl(*p++);
+	} else {
+		eof = false;
+	}
+	rlen = ntohl(*p++);
+	data = pkt + ((uchar *)p - (uchar *)&rpc_pkt);
+	if (rlen > slot->len || data + rlen > pkt + len)
+		return -NFS_RPC_DROP;	/* truncated, wait for a retransmit */
 
-	rlen = ntohl(rpc_pkt.u.reply.data[18]);
-	if (store_block((uchar *)pkt + sizeof(rpc_pkt.u.reply),
-			nfs_offset, rlen))
+	if (store_block(data, slot->offset, rlen))
 		return -9999;
+	nfs_show_progress(rlen);
+
+	if (eof || !rlen)
+		nfs_file_size = min(nfs_file_size, slot->offset + rlen);
+	if (rlen < slot->len && slot->offset + rlen < nfs_file_size) {
+		slot->xid = ++rpc_id;
+		slot->offset += rlen;
+		slot->len -= rlen;
+		nfs_read_req(slot);
+	} else {
+		slot->busy = false;
+	}
 
 	return rlen;
 }
@@ -603,6 +882,15 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	case STATE_PRCLOOKUP_PROG_NFS_REQ:
 		if (rpc_lookup_reply(PROG_NFS, pkt, len) == -NFS_RPC_DROP)
 			break;
+		if (nfs_version == 3 &&
+		    (!nfs_server_mount_port || !nfs_server_port)) {
+			/* The portmapper knows no v3 service, so try v2 */
+			debug("NFSv3 not available, using NFSv2\n");
+			nfs_version = 2;
+			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+			nfs_send();
+			break;
+		}
 		nfs_state = STATE_MOUNT_REQ;
 		nfs_send();
 		break;
@@ -617,11 +905,23 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		} else {
-			nfs_state = STATE_LOOKUP_REQ;
+			nfs_rsize = NFS_READ_SIZE;
+			if (nfs_version == 3)
+				nfs_state = STATE_FSINFO_REQ;
+			else
+				nfs_state = STATE_LOOKUP_REQ;
 			nfs_send();
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		/* Without FSINFO we just keep the default read size */
+		if (nfs_fsinfo_reply(pkt, len) == -NFS_RPC_DROP)
+			break;
+		nfs_state = STATE_LOOKUP_REQ;
+		nfs_send();
+		break;
+
 	case STATE_UMOUNT_REQ:
 		reply = nfs_umountall_reply(pkt, len);
 		if (reply == -NFS_RPC_DROP) {
@@ -645,9 +945,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
 		}
 		break;
 
@@ -671,17 +969,23 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
+		nfs_timeout_count = 0;
+		if (rlen >= 0) {
+			if (!nfs_read_done()) {
+				nfs_read_fill();
+				break;
+			}
+			nfs_download_state = NETLOOP_SUCCESS;
+			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
@@ -762,6 +1066,13 @@ void nfs_start(void)
 
 	nfs_timeout_count = 0;
 	nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
+#ifdef CONFIG_NFS_V3
+	nfs_version = 3;
+#else
+	nfs_version = 2;
+#endif
+	dirfh_len = NFS_FHSIZE;
+	filefh_len = NFS_FHSIZE;
 
 	/*nfs_our_port = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
@@ -25,7 +25,17 @@
 #define NFS_READLINK    5
 #define NFS_READ        6
 
+#define NFS3PROC_LOOKUP		3
+#define NFS3PROC_READLINK	5
+#define NFS3PROC_READ		6
+#define NFS3PROC_FSINFO		19
+
 #define NFS_FHSIZE      32
+#define NFS3_FHSIZE     64
+
+/* Size of the fattr (v2) and fattr3 (v3) structures, in 32-bit words */
+#define NFS_FATTR_WORDS		17
+#define NFS3_FATTR_WORDS	21
 
 #define NFSERR_PERM     1
 #define NFSERR_NOENT    2
@@ -44,6 +54,17 @@
 #define NFS_READ_SIZE 1024 /* biggest power of two that fits Ether frame */
 #endif
 
+/*
+ * Largest NFSv3 read size we ask for. The server may lower this through
+ * FSINFO. Larger reads only help if the reply can be reassembled from IP
+ * fragments.
+ */
+#ifdef CONFIG_IP_DEFRAG
+#define NFS3_READ_MAX CONFIG_NET_MAXDEFRAG
+#else
+#define NFS3_READ_MAX NFS_READ_SIZE
+#endif
+
 #define NFS_MAXLINKDEPTH 16
 
 struct rpc_t {
@@ -65,7 +86,8 @@ struct rpc_t {
 			uint32_t verifier;
 			uint32_t v2;
 			uint32_t astatus;
-			uint32_t data[19];
+			/* large enough for the header of an NFSv3 READ reply */
+			uint32_t data[26];
 		} reply;
 	} u;
 };
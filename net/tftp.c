@@ -79,7 +79,15 @@ static ulong	tftp_prev_block;
 static ulong	tftp_block_wrap;
 /* memory offset due to wrapping */
 static ulong	tftp_block_wrap_offset;
+/* block number that completes the current window and must be ACKed */
+static ulong	tftp_next_ack;
+/* last in-order block we re-ACKed after a gap, to do so once per window */
+static ulong	tftp_last_nack;
 static int	tftp_state;
+#ifdef CONFIG_NET_RX_PLACE
+/* bytes the driver received straight into place, for the summary */
+static ulong	tftp_placed_bytes;
+#endif
 #ifdef CONFIG_TFTP_TSIZE
 /* The file size reported by the server */
 static int	tftp_tsize;
@@ -133,6 +141,20 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 window size: number of blocks the server sends before waiting
+ * for an ACK. 1 gives the classic lock-step protocol and means the option
+ * is not requested at all.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = TFTP_WINDOWSIZE;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -192,7 +214,14 @@ static inline void store_block(int block, uchar *src, unsigned len)
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
 
-		memcpy(ptr, src, len);
+		/* The driver may already have put the data there */
+		if (net_rx_placed(ptr, len)) {
+#ifdef CONFIG_NET_RX_PLACE
+			tftp_placed_bytes += len;
+#endif
+		} else {
+			memcpy(ptr, src, len);
+		}
 		unmap_sysmem(ptr);
 	}
 #ifdef CONFIG_MCAST_TFTP
@@ -204,12 +233,89 @@ static inline void store_block(int block, uchar *src, unsigned len)
 		net_boot_file_size = newsize;
 }
 
+/*
+ * Data written straight to flash still has to be copied there, and blocks
+ * are only placed when the file size is known
+ */
+#if defined(CONFIG_NET_RX_PLACE) && !defined(CONFIG_SYS_DIRECT_FLASH_TFTP) && \
+	defined(CONFIG_TFTP_TSIZE)
+/* Ethernet, IP and UDP headers, then the TFTP opcode and block number */
+#define TFTP_DATA_HDR_SIZE	(ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4)
+
+/*
+ * Check that a packet whose payload the driver put straight into place is
+ * the next data block of this transfer, with nothing else in it, so that
+ * the handler will store it where it already is
+ */
+static int tftp_rx_match(uchar *pkt, int len)
+{
+	struct ethernet_hdr *et = (struct ethernet_hdr *)pkt;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	__be16 *s = (__be16 *)(ip + 1);
+	ulong expected = (tftp_prev_block + 1) % TFTP_SEQUENCE_SIZE;
+
+	if (len < TFTP_DATA_HDR_SIZE || tftp_state != STATE_DATA)
+		return 0;
+	if (et->et_protlen != htons(PROT_IP) || ip->ip_hl_v != 0x45 ||
+	    ip->ip_p != IPPROTO_UDP ||
+	    (ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG)))
+		return 0;
+	if (ntohs(ip->udp_dst) != tftp_our_port ||
+	    ntohs(ip->udp_src) != tftp_remote_port)
+		return 0;
+	if (ntohs(s[0]) != TFTP_DATA || ntohs(s[1]) != expected)
+		return 0;
+
+	/* Anything else placed is Ethernet padding, not data */
+	return ntohs(ip->udp_len) - UDP_HDR_SIZE - 4 == net_rx_target.placed;
+}
+
+/*
+ * Check whether the next data block can be stored in place at all. A UDP
+ * checksum is still checked, over the headers and the placed payload.
+ */
+static bool tftp_can_place(void)
+{
+#ifdef CONFIG_MCAST_TFTP
+	if (tftp_mcast_active)
+		return false;
+#endif
+	return !tftp_put_active && net_eth_hdr_size() == ETHER_HDR_SIZE;
+}
+
+/*
+ * Tell the driver where the next data block goes, if it can be stored
+ * there directly. Any packet the driver receives is placed there before
+ * it is checked, so the target never reaches past the end of the file
+ * and is only set if the server told us the file size.
+ */
+static void tftp_set_rx_target(void)
+{
+	ulong offset = tftp_cur_block * tftp_block_size +
+		tftp_block_wrap_offset;
+	void *buf = NULL;
+	int len = 0;
+
+	if (tftp_can_place() && offset < tftp_tsize) {
+		len = min_t(ulong, tftp_block_size, tftp_tsize - offset);
+		buf = map_sysmem(load_addr + offset, len);
+	}
+	net_set_rx_target(buf, TFTP_DATA_HDR_SIZE, len, tftp_rx_match);
+}
+#else
+static inline void tftp_set_rx_target(void)
+{
+}
+#endif
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_next_ack = tftp_windowsize;
+	tftp_last_nack = TFTP_SEQUENCE_SIZE;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -302,6 +408,35 @@ static void update_block_number(void)
 	}
 }
 
+/*
+ * Check that a data block is the next one in sequence. When more than one
+ * block is in flight a gap means a packet was lost: ACK the last block
+ * received in order, once per window, so that the server resends the
+ * window starting at the missing block. Duplicates are dropped.
+ *
+ * @return 1 if the block is the expected one, 0 if it must be dropped
+ */
+static int check_block_sequence(void)
+{
+	ulong expected = (tftp_prev_block + 1) % TFTP_SEQUENCE_SIZE;
+	ulong ahead = (tftp_cur_block - tftp_prev_block) % TFTP_SEQUENCE_SIZE;
+
+	if (tftp_cur_block == expected)
+		return 1;
+
+	debug("Received block %lu, expected %lu\n", tftp_cur_block, expected);
+	tftp_cur_block = tftp_prev_block;
+	if (ahead > 1 && ahead <= tftp_windowsize &&
+	    tftp_last_nack != tftp_prev_block) {
+		tftp_last_nack = tftp_prev_block;
+		tftp_next_ack = (tftp_prev_block + tftp_windowsize) %
+				TFTP_SEQUENCE_SIZE;
+		tftp_send();
+	}
+
+	return 0;
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -320,7 +455,14 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+#ifdef CONFIG_NET_RX_PLACE
+	if (tftp_placed_bytes) {
+		puts("\n\t ");
+		print_size(tftp_placed_bytes, " received in place");
+	}
+#endif
 	puts("\ndone\n");
+	net_set_rx_target(NULL, 0, 0, NULL);
 	net_set_state(NETLOOP_SUCCESS);
 }
 
@@ -371,6 +513,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* and for several blocks in flight at once */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -539,6 +685,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -548,8 +701,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 #endif
 		}
+		if (!tftp_windowsize || tftp_windowsize > tftp_windowsize_option)
+			tftp_windowsize = 1;
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len - 1);
+		/* multicast tracks missing blocks itself, one at a time */
+		if (tftp_mcast_active)
+			tftp_windowsize = 1;
 		if ((tftp_mcast_active) && (!tftp_mcast_master_client))
 			tftp_state = STATE_DATA;	/* passive.. */
 		else
@@ -569,8 +727,6 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
@@ -586,7 +742,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				tftp_prev_block = tftp_cur_block - 1;
 			} else
 #endif
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* With a window, a lost block 1 shows up as a gap */
+			if (tftp_cur_block != 1 && tftp_windowsize == 1) {
 				puts("\nTFTP error: ");
 				printf("First block is not block 1 (%ld)\n",
 				       tftp_cur_block);
@@ -601,15 +758,26 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			break;
 		}
 
+#ifdef CONFIG_MCAST_TFTP
+		if (!tftp_mcast_active)
+#endif
+		if (!check_block_sequence())
+			break;
+
+		update_block_number();
+
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
 		store_block(tftp_cur_block - 1, pkt + 2, len);
+		if (len == tftp_block_size)
+			tftp_set_rx_target();
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	Acknowledge the last block of each window (every block
+		 *	unless a window size was negotiated) and the final block,
+		 *	which will prompt the remote for the next window.
 		 */
 #ifdef CONFIG_MCAST_TFTP
 		/* if I am the MasterClient, actively calculate what my next
@@ -637,7 +805,12 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 #endif
-		tftp_send();
+		if (tftp_windowsize == 1 || len < tftp_block_size ||
+		    tftp_cur_block == tftp_next_ack) {
+			tftp_send();
+			tftp_next_ack = (tftp_cur_block + tftp_windowsize) %
+					TFTP_SEQUENCE_SIZE;
+		}
 
 #ifdef CONFIG_MCAST_TFTP
 		if (tftp_mcast_active) {
@@ -689,6 +862,9 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		/* The server restarts the window after the block we ACK */
+		tftp_next_ack = (tftp_cur_block + tftp_windowsize) %
+				TFTP_SEQUENCE_SIZE;
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -709,6 +885,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = simple_strtol(ep, NULL, 10);
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -730,8 +910,11 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	if (tftp_windowsize_option < 1)
+		tftp_windowsize_option = 1;
+
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -806,6 +989,10 @@ void tftp_start(enum proto_t protocol)
 		tftp_state = STATE_SEND_RRQ;
 	}
 
+	net_set_rx_target(NULL, 0, 0, NULL);
+#ifdef CONFIG_NET_RX_PLACE
+	tftp_placed_bytes = 0;
+#endif
 	time_start = get_timer(0);
 	timeout_count_max = tftp_timeout_count_max;
 
@@ -831,8 +1018,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -860,10 +1048,15 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
+	net_set_rx_target(NULL, 0, 0, NULL);
+#ifdef CONFIG_NET_RX_PLACE
+	tftp_placed_bytes = 0;
+#endif
 
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
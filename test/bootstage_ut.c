@@ -0,0 +1,212 @@
+/*
+ * Tests for bootstage_export()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+
+#define EXPORT_SIZE	0x10000
+
+/* Fixed user ids, so that the test can be run more than once */
+#define UT_MARK_ID	(BOOTSTAGE_ID_USER + CONFIG_BOOTSTAGE_USER_COUNT - 1)
+#define UT_ACCUM_ID	(BOOTSTAGE_ID_USER + CONFIG_BOOTSTAGE_USER_COUNT - 2)
+
+#define UT_MARK_NAME	"ut \"mark\""
+#define UT_ACCUM_NAME	"ut_accum"
+#define UT_IV_NAME	"ut_interval"
+
+static int check_contains(const char *buf, const char *str)
+{
+	if (!strstr(buf, str)) {
+		printf("%s: '%s' missing from export\n", __func__, str);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Check the byte count after 'str', which grows by 1234 with each run */
+static int check_bytes(const char *buf, const char *str)
+{
+	const char *p = strstr(buf, str);
+	ulong bytes;
+
+	if (!p)
+		return check_contains(buf, str);
+	bytes = simple_strtoul(p + strlen(str), NULL, 10);
+	if (!bytes || bytes % 1234) {
+		printf("%s: bad byte count %lu\n", __func__, bytes);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Check that the brackets of a JSON document balance outside strings */
+static int check_json_nesting(const char *buf)
+{
+	char stack[8];
+	bool quoted = false;
+	int depth = 0;
+
+	for (; *buf; buf++) {
+		if (quoted) {
+			if (*buf == '\\' && buf[1])
+				buf++;
+			else if (*buf == '"')
+				quoted = false;
+		} else if (*buf == '"') {
+			quoted = true;
+		} else if (*buf == '{' || *buf == '[') {
+			if (depth == sizeof(stack))
+				break;
+			stack[depth++] = *buf == '{' ? '}' : ']';
+		} else if (*buf == '}' || *buf == ']') {
+			if (!depth || stack[--depth] != *buf)
+				break;
+		}
+	}
+	if (*buf || depth || quoted) {
+		printf("%s: JSON brackets or quotes do not balance\n", __func__);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * The interval table may already be full, in which case the new interval
+ * is only counted. Otherwise it must be in the export.
+ */
+static int check_interval(const char *buf, const char *str)
+{
+	if (strstr(buf, str) || strstr(buf, "dropped"))
+		return 0;
+
+	return check_contains(buf, str);
+}
+
+static int test_json(char *buf)
+{
+	const char *p;
+	int ret = 0;
+	int len;
+
+	len = bootstage_export(buf, EXPORT_SIZE, BOOTSTAGE_FORMAT_JSON);
+	if (len < 0 || len >= EXPORT_SIZE) {
+		printf("%s: export failed: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	buf[len] = '\0';
+
+	if (strncmp(buf, "{\"traceEvents\":[\n", 17) ||
+	    strcmp(buf + len - 3, "}}\n")) {
+		printf("%s: not a trace event document\n", __func__);
+		return -EINVAL;
+	}
+	ret |= check_json_nesting(buf);
+	ret |= check_contains(buf,
+		"{\"name\":\"ut \\\"mark\\\"\",\"cat\":\"mark\",\"ph\":\"i\"");
+	p = strstr(buf, "\"" UT_ACCUM_NAME "\":\"total_us=");
+	ret |= p ? check_bytes(p, "bytes=") :
+		check_contains(buf, "\"" UT_ACCUM_NAME "\":\"total_us=");
+	ret |= check_interval(buf,
+		"{\"name\":\"" UT_IV_NAME "\",\"cat\":\"interval\",\"ph\":\"X\"");
+
+	return ret;
+}
+
+static int test_csv(char *buf)
+{
+	const char *p;
+	char str[40];
+	int ret = 0;
+	int len;
+
+	len = bootstage_export(buf, EXPORT_SIZE, BOOTSTAGE_FORMAT_CSV);
+	if (len < 0 || len >= EXPORT_SIZE) {
+		printf("%s: export failed: %d\n", __func__, len);
+		return -EINVAL;
+	}
+	buf[len] = '\0';
+
+	if (strncmp(buf, "type,id,name,start_us,duration_us,count,bytes\n",
+		    46)) {
+		printf("%s: bad header line\n", __func__);
+		return -EINVAL;
+	}
+	snprintf(str, sizeof(str), "mark,%d,\"ut \"\"mark\"\"\",", UT_MARK_ID);
+	ret |= check_contains(buf, str);
+	snprintf(str, sizeof(str), "accum,%d,\"" UT_ACCUM_NAME "\",",
+		 UT_ACCUM_ID);
+	p = strstr(buf, str);
+	if (p) {
+		/* first_us,total_us,count,bytes */
+		p = strchr(p + strlen(str), ',');
+		p = p ? strchr(p + 1, ',') : NULL;
+		p = p ? strchr(p + 1, ',') : NULL;
+		ret |= p ? check_bytes(p, ",") : check_contains(buf, "bytes");
+	} else {
+		ret |= check_contains(buf, str);
+	}
+	ret |= check_interval(buf, "interval,,\"" UT_IV_NAME "\",");
+
+	return ret;
+}
+
+/* A short buffer must give -ENOSPC without writing past its end */
+static int test_no_space(char *buf)
+{
+	int size = 64;
+	int ret;
+
+	memset(buf, 0xa5, size + 16);
+	ret = bootstage_export(buf, size, BOOTSTAGE_FORMAT_JSON);
+	if (ret != -ENOSPC) {
+		printf("%s: expected -ENOSPC, got %d\n", __func__, ret);
+		return -EINVAL;
+	}
+	for (ret = size; ret < size + 16; ret++) {
+		if ((uchar)buf[ret] != 0xa5) {
+			printf("%s: wrote past the end of the buffer\n",
+			       __func__);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+int do_ut_bootstage(cmd_tbl_t *cmdtp, int flag, int argc,
+		    char * const argv[])
+{
+	uint32_t start;
+	char *buf;
+	int ret = 0;
+
+	buf = malloc(EXPORT_SIZE);
+	if (!buf) {
+		printf("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+
+	bootstage_mark_name(UT_MARK_ID, UT_MARK_NAME);
+	bootstage_start(UT_ACCUM_ID, UT_ACCUM_NAME);
+	bootstage_accum(UT_ACCUM_ID);
+	bootstage_add_bytes(UT_ACCUM_ID, 1234);
+	start = timer_get_boot_us();
+	bootstage_add_interval(UT_IV_NAME, start);
+
+	ret |= test_json(buf);
+	ret |= test_csv(buf);
+	ret |= test_no_space(buf);
+	free(buf);
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
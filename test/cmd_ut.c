@@ -13,15 +13,28 @@ static int do_ut_all(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 
 static cmd_tbl_t cmd_ut_sub[] = {
 	U_BOOT_CMD_MKENT(all, CONFIG_SYS_MAXARGS, 1, do_ut_all, "", ""),
+#ifdef CONFIG_UT_BOOTSTAGE
+	U_BOOT_CMD_MKENT(bootstage, CONFIG_SYS_MAXARGS, 1, do_ut_bootstage, "",
+			 ""),
+#endif
+#ifdef CONFIG_UT_CRC32
+	U_BOOT_CMD_MKENT(crc32, CONFIG_SYS_MAXARGS, 1, do_ut_crc32, "", ""),
+#endif
 #if defined(CONFIG_UT_DM)
 	U_BOOT_CMD_MKENT(dm, CONFIG_SYS_MAXARGS, 1, do_ut_dm, "", ""),
 #endif
 #if defined(CONFIG_UT_ENV)
 	U_BOOT_CMD_MKENT(env, CONFIG_SYS_MAXARGS, 1, do_ut_env, "", ""),
 #endif
+#ifdef CONFIG_UT_MEMTEST
+	U_BOOT_CMD_MKENT(memtest, CONFIG_SYS_MAXARGS, 1, do_ut_memtest, "", ""),
+#endif
 #ifdef CONFIG_UT_TIME
 	U_BOOT_CMD_MKENT(time, CONFIG_SYS_MAXARGS, 1, do_ut_time, "", ""),
 #endif
+#ifdef CONFIG_UT_UBI
+	U_BOOT_CMD_MKENT(ubi, CONFIG_SYS_MAXARGS, 1, do_ut_ubi, "", ""),
+#endif
 };
 
 static int do_ut_all(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -62,14 +75,26 @@ static int do_ut(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 #ifdef CONFIG_SYS_LONGHELP
 static char ut_help_text[] =
 	"all - execute all enabled tests\n"
+#ifdef CONFIG_UT_BOOTSTAGE
+	"ut bootstage - Test bootstage export\n"
+#endif
+#ifdef CONFIG_UT_CRC32
+	"ut crc32 - Test and benchmark crc32()\n"
+#endif
 #ifdef CONFIG_UT_DM
 	"ut dm [test-name]\n"
 #endif
 #ifdef CONFIG_UT_ENV
 	"ut env [test-name]\n"
 #endif
+#ifdef CONFIG_UT_MEMTEST
+	"ut memtest - Test the fast memory test engine\n"
+#endif
 #ifdef CONFIG_UT_TIME
 	"ut time - Very basic test of time functions\n"
+#endif
+#ifdef CONFIG_UT_UBI
+	"ut ubi - Test attaching UBI on the NAND simulator\n"
 #endif
 	;
 #endif
@@ -9,9 +9,12 @@
 #include <common.h>
 #include <bootm.h>
 #include <command.h>
+#include <errno.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -151,6 +154,53 @@ static int uncompress_using_gzip(void *in, unsigned long in_size,
 	return ret;
 }
 
+#ifdef CONFIG_GZIP_BGZF
+/*
+ * Make two BGZF members, one for each half of the input, by giving the
+ * output of gzip() a header with the 'BC' extra field
+ */
+static int compress_using_bgzf(void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	unsigned char member[TEST_BUFFER_SIZE];
+	unsigned long done = 0, offset = 0, len, gz_len, size;
+	unsigned char *p = out;
+	int i, ret;
+
+	for (i = 0; i < 2; i++) {
+		len = i ? in_size - offset : in_size / 2;
+		gz_len = sizeof(member);
+		ret = gzip(member, &gz_len, in + offset, len);
+		if (ret)
+			return ret;
+		size = gz_len + 8;
+		if (done + size > out_max)
+			return -1;
+
+		memcpy(p, member, 10);
+		p[3] = 4;			/* FEXTRA */
+		p[10] = 6;			/* XLEN */
+		p[11] = 0;
+		p[12] = 'B';
+		p[13] = 'C';
+		p[14] = 2;
+		p[15] = 0;
+		p[16] = (size - 1) & 0xff;	/* BSIZE */
+		p[17] = (size - 1) >> 8;
+		memcpy(p + 18, member + 10, gz_len - 10);
+
+		p += size;
+		done += size;
+		offset += len;
+	}
+	if (out_size)
+		*out_size = done;
+
+	return 0;
+}
+#endif
+
 static int compress_using_bzip2(void *in, unsigned long in_size,
 				void *out, unsigned long out_max,
 				unsigned long *out_size)
@@ -371,16 +421,123 @@ out:
 	return ret;
 }
 
+#define LZ4_TEST_BLOCK_MAX	SZ_64K
+#define LZ4_TEST_BUFFER_SIZE	(4 * LZ4_TEST_BLOCK_MAX)
+
+/*
+ * Write an LZ4 frame of 64KiB independent blocks to @frame, holding the
+ * blocks of @data with the sizes in @sizes. The blocks are stored rather
+ * than compressed, since there is no LZ4 compressor in U-Boot.
+ */
+static ulong make_lz4_frame(u8 *frame, const u8 *data, const uint *sizes,
+			    int count)
+{
+	static const u8 header[] = {
+		0x04, 0x22, 0x4d, 0x18,	/* magic */
+		0x60,			/* version 1, independent blocks */
+		0x40,			/* 64KiB maximum block size */
+		0x82,			/* header checksum */
+	};
+	u8 *p = frame;
+	int i;
+
+	memcpy(p, header, sizeof(header));
+	p += sizeof(header);
+	for (i = 0; i < count; i++) {
+		put_unaligned_le32(sizes[i] | 0x80000000, p);
+		memcpy(p + 4, data, sizes[i]);
+		p += 4 + sizes[i];
+		data += sizes[i];
+	}
+	put_unaligned_le32(0, p);
+
+	return p + 4 - frame;
+}
+
+/*
+ * Decode frames of several blocks, which CONFIG_LZ4_PARALLEL decodes one
+ * block per job. Every block but the last fills the first frame, so the
+ * blocks land where they belong. The first block of the second frame is
+ * short, so the blocks after it are put in the wrong place and the frame
+ * must be decoded again one block at a time.
+ */
+static int run_lz4_blocks_test(void)
+{
+	static const uint full_sizes[] = { SZ_64K, SZ_64K, 1000 };
+	static const uint short_sizes[] = { 1000, SZ_64K, 500 };
+	u8 *data = NULL, *frame = NULL, *out = NULL;
+	ulong frame_size, total;
+	size_t out_size;
+	int ret, i;
+
+	printf(" testing lz4 blocks ...\n");
+
+	data = malloc(3 * LZ4_TEST_BLOCK_MAX);
+	errcheck(data != NULL);
+	frame = malloc(3 * LZ4_TEST_BLOCK_MAX + 64);
+	errcheck(frame != NULL);
+	out = malloc(LZ4_TEST_BUFFER_SIZE);
+	errcheck(out != NULL);
+	for (i = 0; i < 3 * LZ4_TEST_BLOCK_MAX; i++)
+		data[i] = i ^ (i >> 9);
+
+	/* Full blocks */
+	total = 2 * SZ_64K + 1000;
+	frame_size = make_lz4_frame(frame, data, full_sizes, 3);
+	memset(out, 'A', LZ4_TEST_BUFFER_SIZE);
+	out_size = LZ4_TEST_BUFFER_SIZE;
+	errcheck(ulz4fn(frame, frame_size, out, &out_size) == 0);
+	errcheck(out_size == total);
+	errcheck(memcmp(data, out, total) == 0);
+	errcheck(out[total] == 'A');
+
+	/* The last block does not fit */
+	memset(out, 'A', LZ4_TEST_BUFFER_SIZE);
+	out_size = total - 1;
+	errcheck(ulz4fn(frame, frame_size, out, &out_size) == -ENOBUFS);
+	errcheck(out[total - 1] == 'A');
+
+	/* A short block which is not the last one */
+	total = 1000 + SZ_64K + 500;
+	frame_size = make_lz4_frame(frame, data, short_sizes, 3);
+	memset(out, 'A', LZ4_TEST_BUFFER_SIZE);
+	out_size = LZ4_TEST_BUFFER_SIZE;
+	errcheck(ulz4fn(frame, frame_size, out, &out_size) == 0);
+	errcheck(out_size == total);
+	errcheck(memcmp(data, out, total) == 0);
+#ifdef CONFIG_LZ4_PARALLEL
+	/* The parallel attempt put the last block at 128KiB */
+	errcheck(memcmp(data + 1000 + SZ_64K, out + 2 * SZ_64K, 500) == 0);
+#else
+	errcheck(out[total] == 'A');
+#endif
+
+	ret = 0;
+
+out:
+	printf(" lz4 blocks: %s\n", ret == 0 ? "ok" : "FAILED");
+
+	free(out);
+	free(frame);
+	free(data);
+
+	return ret;
+}
+
 static int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc,
 			     char *const argv[])
 {
 	int err = 0;
 
 	err += run_test("gzip", compress_using_gzip, uncompress_using_gzip);
+#ifdef CONFIG_GZIP_BGZF
+	err += run_test("bgzf", compress_using_bgzf, uncompress_using_gzip);
+#endif
 	err += run_test("bzip2", compress_using_bzip2, uncompress_using_bzip2);
 	err += run_test("lzma", compress_using_lzma, uncompress_using_lzma);
 	err += run_test("lzo", compress_using_lzo, uncompress_using_lzo);
 	err += run_test("lz4", compress_using_lz4, uncompress_using_lz4);
+	err += run_lz4_blocks_test();
 
 	printf("ut_compression %s\n", err == 0 ? "ok" : "FAILED");
 
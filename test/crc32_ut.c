@@ -0,0 +1,137 @@
+/*
+ * Tests and throughput benchmark for lib/crc32.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+
+#define CRC32_TEST_SIZE		4096
+#define CRC32_BENCH_SIZE	(1 << 20)
+#define CRC32_BENCH_MS		1000
+
+static uint32_t ref_table[256];
+
+/* Build the byte-wise table bit by bit, without relying on lib/crc32.c */
+static void make_ref_table(void)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		ref_table[n] = c;
+	}
+}
+
+static uint32_t ref_crc32_no_comp(uint32_t crc, const uint8_t *p, uint len)
+{
+	while (len--)
+		crc = ref_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static int test_check_value(void)
+{
+	const unsigned char check[] = "123456789";
+	uint32_t crc;
+
+	crc = crc32(0, check, sizeof(check) - 1);
+	if (crc != 0xcbf43926) {
+		printf("%s: crc32 of \"%s\" is %08x, expected cbf43926\n",
+		       __func__, check, crc);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int test_against_table(const uint8_t *buf)
+{
+	uint32_t crc, expect;
+	uint off, len;
+
+	/* Cover every alignment and every tail length of the fast paths */
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len < CRC32_TEST_SIZE; len += len < 300 ? 1 : 61) {
+			crc = crc32_no_comp(0x12345678, buf + off, len);
+			expect = ref_crc32_no_comp(0x12345678, buf + off, len);
+			if (crc != expect) {
+				printf("%s: offset %u, length %u: got %08x, expected %08x\n",
+				       __func__, off, len, crc, expect);
+				return -EINVAL;
+			}
+		}
+	}
+
+	/* Splitting a buffer must give the same result */
+	expect = crc32(0, buf, CRC32_TEST_SIZE);
+	for (len = 1; len < CRC32_TEST_SIZE; len += 97) {
+		crc = crc32(0, buf, len);
+		crc = crc32(crc, buf + len, CRC32_TEST_SIZE - len);
+		if (crc != expect) {
+			printf("%s: split at %u: got %08x, expected %08x\n",
+			       __func__, len, crc, expect);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void bench_one(const char *name, const uint8_t *buf,
+		      uint32_t (*func)(uint32_t, const uint8_t *, uint))
+{
+	ulong start, elapsed, kib = 0;
+	uint32_t crc = 0;
+
+	start = get_timer(0);
+	do {
+		crc = func(crc, buf, CRC32_BENCH_SIZE);
+		kib += CRC32_BENCH_SIZE >> 10;
+		elapsed = get_timer(start);
+	} while (elapsed < CRC32_BENCH_MS);
+
+	printf("%s: %s: %lu KiB in %lu ms, %lu KiB/s\n", __func__, name,
+	       kib, elapsed, kib / elapsed * 1000);
+}
+
+static uint32_t bench_crc32(uint32_t crc, const uint8_t *p, uint len)
+{
+	return crc32_no_comp(crc, p, len);
+}
+
+int do_ut_crc32(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	uint8_t *buf;
+	int ret = 0;
+	int i;
+
+	buf = malloc(CRC32_BENCH_SIZE);
+	if (!buf) {
+		printf("Out of memory\n");
+		return CMD_RET_FAILURE;
+	}
+	for (i = 0; i < CRC32_BENCH_SIZE; i++)
+		buf[i] = i * 251 + (i >> 9);
+
+	make_ref_table();
+	ret |= test_check_value();
+	ret |= test_against_table(buf);
+	if (!ret) {
+		bench_one("byte-wise", buf, ref_crc32_no_comp);
+		bench_one("crc32", buf, bench_crc32);
+	}
+	free(buf);
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
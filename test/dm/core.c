@@ -796,3 +796,24 @@ static int dm_test_device_get_uclass_id(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_device_get_uclass_id, DM_TESTF_SCAN_PDATA);
+
+#ifdef CONFIG_DM_TIMING
+/* Test that probe time is only recorded once a device is probed */
+static int dm_test_probe_timing(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+
+	ut_assertok(uclass_find_device(UCLASS_TEST, 0, &dev));
+	ut_assert(!device_active(dev));
+	ut_asserteq(0, dev->probe_us);
+
+	/* Sandbox is not slow enough to take a whole second */
+	ut_assertok(uclass_get_device(UCLASS_TEST, 0, &dev));
+	ut_assert(device_active(dev));
+	ut_assert(dev->bind_us < 1000000);
+	ut_assert(dev->probe_us < 1000000);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_timing, DM_TESTF_SCAN_PDATA);
+#endif
@@ -11,6 +11,7 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -259,3 +260,51 @@ static int dm_test_net_retry(struct unit_test_state *uts)
 	return retval;
 }
 DM_TEST(dm_test_net_retry, DM_TESTF_SCAN_FDT);
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_tftp_place(struct unit_test_state *uts)
+{
+	/* Enough blocks for the 16-bit block number to wrap, then a short one */
+	const ulong blocks = 0x10000 + 16;
+	const ulong size = (blocks - 1) * 8 + 3;
+	u8 *buf;
+	ulong i;
+
+	/* A bad block after the wrap must be dropped and fetched again */
+	sandbox_eth_tftp_serve(size, 0x10000 + 5);
+	net_server_ip = string_to_ip("1.1.2.2");
+	setenv("ethact", "eth@10002000");
+	setenv("tftpblocksize", "8");
+	ut_assertok(run_command("tftpboot 1000000 sandbox.bin", 0));
+	ut_asserteq(size, getenv_hex("filesize", 0));
+
+	buf = map_sysmem(0x1000000, size);
+	for (i = 0; i < size; i++) {
+		if (buf[i] != sandbox_eth_tftp_byte(i))
+			break;
+	}
+	unmap_sysmem(buf);
+	ut_asserteq(size, i);
+
+#ifdef CONFIG_NET_RX_PLACE
+	/* All blocks after the first are placed, the bad one twice */
+	ut_asserteq(blocks, sandbox_eth_tftp_placed());
+#endif
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_place(struct unit_test_state *uts)
+{
+	int retval;
+
+	retval = _dm_test_eth_tftp_place(uts);
+
+	/* Restore the env */
+	setenv("tftpblocksize", NULL);
+	net_server_ip.s_addr = 0;
+	sandbox_eth_tftp_serve(-1, 0);
+
+	return retval;
+}
+DM_TEST(dm_test_eth_tftp_place, DM_TESTF_SCAN_FDT);
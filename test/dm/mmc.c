@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -25,3 +26,154 @@ static int dm_test_mmc_base(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_base, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test queued reads, and that block reads use the queue */
+static int dm_test_mmc_queue(struct unit_test_state *uts)
+{
+	struct mmc_req reqs[3];
+	struct udevice *dev;
+	struct mmc *mmc;
+	int started, prepared, base_started, base_prepared;
+	u8 buf[64 * 512], out[sizeof(buf)];
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertnonnull(mmc);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(2048, mmc->block_dev.lba);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i ^ (i >> 9);
+	ut_asserteq(64, mmc->block_dev.block_write(mmc->block_dev.dev, 100,
+						   64, buf));
+	sandbox_mmc_get_stats(dev, &base_started, &base_prepared);
+
+	/* Queue three reads; the later ones wait for the first */
+	memset(out, '\0', sizeof(out));
+	memset(reqs, '\0', sizeof(reqs));
+	for (i = 0; i < 3; i++) {
+		reqs[i].start = 100 + i * 16;
+		reqs[i].blkcnt = i == 2 ? 1 : 16;
+		reqs[i].dst = out + i * 16 * 512;
+		ut_assertok(mmc_req_submit(mmc, &reqs[i]));
+	}
+	ut_asserteq(MMC_REQ_ACTIVE, reqs[0].state);
+	ut_asserteq(MMC_REQ_QUEUED, reqs[1].state);
+	ut_asserteq(true, reqs[1].prepared);
+	ut_asserteq(false, reqs[2].prepared);
+
+	/* Nothing completes until the host says so */
+	ut_asserteq(true, mmc_req_poll(mmc));
+	ut_asserteq(false, mmc_req_done(&reqs[0]));
+
+	ut_asserteq(1, mmc_req_wait(mmc, &reqs[2]));
+	ut_asserteq(16, reqs[0].ret);
+	ut_asserteq(16, reqs[1].ret);
+	ut_asserteq(false, mmc_req_poll(mmc));
+	ut_assertok(memcmp(buf, out, 33 * 512));
+
+	sandbox_mmc_get_stats(dev, &started, &prepared);
+	ut_asserteq(3, started - base_started);
+	ut_asserteq(2, prepared - base_prepared);
+
+	/* Requests which cannot be satisfied are refused */
+	reqs[0].start = mmc->block_dev.lba - 1;
+	reqs[0].blkcnt = 2;
+	ut_asserteq(-EINVAL, mmc_req_submit(mmc, &reqs[0]));
+	reqs[0].start = 0;
+	reqs[0].blkcnt = mmc->cfg->b_max + 1;
+	ut_asserteq(-EINVAL, mmc_req_submit(mmc, &reqs[0]));
+
+	/* A block read is split into requests of b_max blocks */
+	memset(out, '\0', sizeof(out));
+	ut_asserteq(64, mmc->block_dev.block_read(mmc->block_dev.dev, 100, 64,
+						  out));
+	ut_assertok(memcmp(buf, out, sizeof(buf)));
+	sandbox_mmc_get_stats(dev, &started, &prepared);
+	ut_asserteq(3 + 4, started - base_started);
+	ut_asserteq(2 + 3, prepared - base_prepared);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_queue, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test UHS-I SDR104 on an SD card, and falling back when tuning fails */
+static int dm_test_mmc_uhs(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 buf[4 * 512], out[sizeof(buf)];
+	int tap;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_180, mmc->signal_voltage);
+	ut_asserteq(MMC_TIMING_UHS_SDR104, mmc->timing);
+	ut_asserteq(208000000, mmc->clock);
+	ut_asserteq(4, mmc->bus_width);
+	ut_asserteq(1, sandbox_mmc_get_tuning(dev, &tap));
+	ut_asserteq(8, tap);
+
+	memset(buf, 0xa5, sizeof(buf));
+	ut_asserteq(4, mmc->block_dev.block_write(mmc->block_dev.dev, 0, 4,
+						  buf));
+	ut_asserteq(4, mmc->block_dev.block_read(mmc->block_dev.dev, 0, 4,
+						 out));
+	ut_assertok(memcmp(buf, out, sizeof(buf)));
+
+	/* With no working sampling point the card drops back to SDR25 */
+	sandbox_mmc_set_tap_window(dev, 1, 0);
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_TIMING_SD_HS, mmc->timing);
+	ut_asserteq(50000000, mmc->clock);
+	ut_asserteq(2, sandbox_mmc_get_tuning(dev, &tap));
+	ut_asserteq(4, mmc->block_dev.block_read(mmc->block_dev.dev, 0, 4,
+						 out));
+	ut_assertok(memcmp(buf, out, sizeof(buf)));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_uhs, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test HS400 on an eMMC, and falling back when tuning fails */
+static int dm_test_mmc_hs400(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 buf[4 * 512], out[sizeof(buf)];
+	int tap;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 1, &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_TIMING_MMC_HS400, mmc->timing);
+	ut_asserteq(200000000, mmc->clock);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(1, mmc->ddr_mode);
+	ut_asserteq(1, sandbox_mmc_get_tuning(dev, &tap));
+	ut_asserteq(8, tap);
+
+	memset(buf, 0x5a, sizeof(buf));
+	ut_asserteq(4, mmc->block_dev.block_write(mmc->block_dev.dev, 0, 4,
+						  buf));
+	ut_asserteq(4, mmc->block_dev.block_read(mmc->block_dev.dev, 0, 4,
+						 out));
+	ut_assertok(memcmp(buf, out, sizeof(buf)));
+
+	/* Without HS200 the usual DDR52 set-up is used */
+	sandbox_mmc_set_tap_window(dev, 1, 0);
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(MMC_TIMING_MMC_HS, mmc->timing);
+	ut_asserteq(52000000, mmc->clock);
+	ut_asserteq(MMC_SIGNAL_VOLTAGE_330, mmc->signal_voltage);
+	ut_asserteq(4, mmc->block_dev.block_read(mmc->block_dev.dev, 0, 4,
+						 out));
+	ut_assertok(memcmp(buf, out, sizeof(buf)));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_hs400, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -11,6 +11,7 @@
 #include <malloc.h>
 #include <asm/io.h>
 #include <dm/test.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -266,3 +267,30 @@ static int dm_test_fdt_offset(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Check that the compatible-string index finds the same drivers */
+static int dm_test_fdt_compat_index(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	const struct udevice_id *id, *linear_id;
+	struct driver *drv, *linear_drv;
+	int offset, depth, ret;
+	int found = 0;
+
+	for (depth = 0, offset = fdt_next_node(blob, -1, &depth);
+	     offset >= 0;
+	     offset = fdt_next_node(blob, offset, &depth)) {
+		ret = lists_driver_lookup_fdt(blob, offset, true, &drv, &id);
+		ut_asserteq(ret, lists_driver_lookup_fdt(blob, offset, false,
+							  &linear_drv,
+							  &linear_id));
+		ut_asserteq_ptr(linear_drv, drv);
+		ut_asserteq_ptr(linear_id, id);
+		if (!ret)
+			found++;
+	}
+	ut_assert(found > 0);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_compat_index, DM_TESTF_SCAN_FDT);
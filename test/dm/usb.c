@@ -48,3 +48,46 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_usb_flash, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Count the USB devices below @parent, leaving out the emulators */
+static int count_usb_devices(struct udevice *parent)
+{
+	struct udevice *dev;
+	int count = 0;
+
+	for (device_find_first_child(parent, &dev);
+	     dev;
+	     device_find_next_child(&dev)) {
+		if (device_get_uclass_id(dev) != UCLASS_USB_EMUL)
+			count += 1 + count_usb_devices(dev);
+	}
+
+	return count;
+}
+
+/*
+ * Time a full scan of the emulated buses. The ports of all the hubs are
+ * polled together, so this should take little more than the connection
+ * timeout of the deepest hub (its power-on delay plus one second) rather
+ * than a second or more per hub and port. Scanning the hub and flash stick
+ * on usb@1 one port at a time took over two seconds.
+ */
+static int dm_test_usb_scan_timing(struct unit_test_state *uts)
+{
+	struct udevice *bus, *dev;
+	ulong start, taken;
+
+	start = get_timer(0);
+	ut_assertok(usb_init());
+	taken = get_timer(start);
+	ut_assert(taken < 2000);
+
+	/* usb@1 has a hub with a flash stick behind it */
+	ut_assertok(uclass_get_device_by_seq(UCLASS_USB, 1, &bus));
+	ut_asserteq(2, count_usb_devices(bus));
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 0, &dev));
+	ut_asserteq(-ENODEV, uclass_get_device(UCLASS_MASS_STORAGE, 1, &dev));
+
+	return 0;
+}
+DM_TEST(dm_test_usb_scan_timing, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
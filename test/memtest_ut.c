@@ -0,0 +1,122 @@
+/*
+ * Tests for the fast memory test engine
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+#include <memtest.h>
+
+/*
+ * A little over one 16MB job so that the region is split, with a trailing
+ * partial word which must be left alone
+ */
+#define UT_WORDS	((16 << 20) / sizeof(ulong) + 1024)
+#define UT_SIZE		(UT_WORDS * sizeof(ulong) + 3)
+
+/* Region address as reported in errors, unrelated to the buffer */
+#define UT_ADDR		0x10000000
+
+static int ut_fail(const char *what, int pattern)
+{
+	printf("%s: %s: %s\n", __func__, memtest_pattern_name(pattern), what);
+
+	return -EINVAL;
+}
+
+/* Every pattern written to good memory must read back without errors */
+static int ut_memtest_good(struct memtest_run *run)
+{
+	u8 *tail = (u8 *)run->buf + UT_WORDS * sizeof(ulong);
+	int pattern, ret;
+
+	for (pattern = 0; pattern < MEMTEST_PATTERN_COUNT; pattern++) {
+		memset(tail, 0xa5, 3);
+		ret = memtest_fill(run, pattern);
+		if (ret)
+			return ut_fail("fill failed", pattern);
+		ret = memtest_check(run, pattern);
+		if (ret || run->errors)
+			return ut_fail("check failed", pattern);
+		if (tail[0] != 0xa5 || tail[1] != 0xa5 || tail[2] != 0xa5)
+			return ut_fail("wrote past the last word", pattern);
+	}
+
+	return 0;
+}
+
+/*
+ * Corrupt a word in each job's chunk; both must be counted and the first
+ * one reported
+ */
+static int ut_memtest_bad(struct memtest_run *run, int pattern)
+{
+	ulong *words = run->buf;
+	ulong first = 1000, second = UT_WORDS - 10;
+	ulong expected;
+	int ret;
+
+	ret = memtest_fill(run, pattern);
+	if (ret)
+		return ut_fail("fill failed", pattern);
+	expected = words[first];
+	words[first] ^= 1UL << 5;
+	words[second] = ~words[second];
+
+	ret = memtest_check(run, pattern);
+	if (ret != -EIO)
+		return ut_fail("corruption not found", pattern);
+	if (run->errors != 2)
+		return ut_fail("wrong error count", pattern);
+	if (run->bad_addr != UT_ADDR + first * sizeof(ulong))
+		return ut_fail("wrong bad address", pattern);
+	if (run->expected != expected ||
+	    run->found != (expected ^ (1UL << 5)))
+		return ut_fail("wrong values reported", pattern);
+
+	/* A different pattern to the one written is wrong everywhere */
+	ret = memtest_fill(run, MEMTEST_ZEROS);
+	ret = ret ? ret : memtest_check(run, MEMTEST_ONES);
+	if (ret != -EIO || run->errors != UT_WORDS)
+		return ut_fail("pattern mismatch not found", MEMTEST_ONES);
+
+	return 0;
+}
+
+int do_ut_memtest(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct memtest_run run;
+	void *buf;
+	int ret;
+
+	buf = malloc(UT_SIZE);
+	if (!buf) {
+		printf("Out of memory\n");
+		printf("Test failed\n");
+		return CMD_RET_FAILURE;
+	}
+
+	memset(&run, '\0', sizeof(run));
+	run.addr = UT_ADDR;
+	run.buf = buf;
+	run.size = UT_SIZE;
+	run.seed = 0x12345678;
+
+	ret = ut_memtest_good(&run);
+	ret = ret ? ret : ut_memtest_bad(&run, MEMTEST_CHECKER);
+	ret = ret ? ret : ut_memtest_bad(&run, MEMTEST_ADDRESS);
+	ret = ret ? ret : ut_memtest_bad(&run, MEMTEST_RANDOM);
+	if (!ret && (memtest_fill(&run, MEMTEST_PATTERN_COUNT) != -EINVAL ||
+		     memtest_check(&run, -1) != -EINVAL)) {
+		printf("%s: invalid pattern accepted\n", __func__);
+		ret = -EINVAL;
+	}
+
+	free(buf);
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
@@ -0,0 +1,97 @@
+/*
+ * Tests for attaching UBI on the sandbox NAND simulator
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <malloc.h>
+
+#define UT_VOL_NAME	"ut_vol"
+#define UT_VOL_SIZE	0x40000
+
+static int ut_run(const char *cmd)
+{
+	if (run_command(cmd, 0)) {
+		printf("%s: '%s' failed\n", __func__, cmd);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Run a command taking the address of @buf and the volume size. The ubi
+ * command uses its address as a pointer, without map_sysmem().
+ */
+static int ut_run_buf(const char *fmt, void *buf)
+{
+	char cmd[80];
+
+	snprintf(cmd, sizeof(cmd), fmt, (ulong)buf, UT_VOL_SIZE);
+
+	return ut_run(cmd);
+}
+
+static int ut_create_vol(void)
+{
+	char cmd[80];
+
+	snprintf(cmd, sizeof(cmd), "ubi create " UT_VOL_NAME " %x",
+		 UT_VOL_SIZE);
+
+	return ut_run(cmd);
+}
+
+static void fill_pattern(u8 *buf)
+{
+	int i;
+
+	for (i = 0; i < UT_VOL_SIZE; i++)
+		buf[i] = i * 7 + (i >> 11);
+}
+
+int do_ut_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	u8 *expect, *buf;
+	int ret;
+
+	expect = malloc(UT_VOL_SIZE);
+	buf = malloc(UT_VOL_SIZE);
+	if (!expect || !buf) {
+		printf("Out of memory\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+	fill_pattern(expect);
+
+	/* First attach, which formats the flash if it is empty */
+	ret = ut_run("mtdparts default");
+	ret = ret ? ret : ut_run("ubi part ubi");
+	if (!ret && run_command("ubi check " UT_VOL_NAME, 0))
+		ret = ut_create_vol();
+	ret = ret ? ret : ut_run_buf("ubi write %lx " UT_VOL_NAME " %x",
+				     expect);
+	if (ret)
+		goto out;
+
+	/* Attach again, so that the volume comes from the headers on flash */
+	ret = ut_run("ubi part ubi");
+	ret = ret ? ret : ut_run("ubi check " UT_VOL_NAME);
+	memset(buf, 0, UT_VOL_SIZE);
+	ret = ret ? ret : ut_run_buf("ubi read %lx " UT_VOL_NAME " %x", buf);
+	if (!ret && memcmp(buf, expect, UT_VOL_SIZE)) {
+		printf("%s: volume contents differ after re-attach\n",
+		       __func__);
+		ret = -EINVAL;
+	}
+
+out:
+	free(buf);
+	free(expect);
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}